@@ -1,10 +1,14 @@
+#the compiled reducer, bin/richards_reduce.exe, writes the same table much faster
+
 import sys
 from os import listdir
-from os.path import join
+from os.path import join, isfile
 from numpy import *
 import pandas as pd
 from scipy.integrate import trapz, simps
 from multiprocessing import Pool
+from store import Store
+from compress import readcmp
 
 #-------------------------------------------------------------------------------
 #INPUT
@@ -21,6 +25,9 @@ cpus = int(sys.argv[3])
 #name of trials table
 fntrials = 'trials.csv'
 
+#name of the output store, used instead of separate files if present
+fnstore = 'output.store'
+
 #-------------------------------------------------------------------------------
 #FUNCTIONS
 
@@ -35,15 +42,28 @@ def isint(x):
         return(False)
 
 def mean_qbot(batdir, num):
-    qbot = fromfile(join(batdir, str(num) + '_qbot'), dtype='float32')
-    t = fromfile(join(batdir, str(num) + '_t'), dtype='float32')
+    if isfile(join(batdir, fnstore)):
+        #each process maps the store itself
+        store = Store(join(batdir, fnstore))
+        qbot = store[str(num) + '_qbot']
+        t = store[str(num) + '_t']
+    elif isfile(join(batdir, str(num) + '_qbot.cmp')):
+        qbot = readcmp(join(batdir, str(num) + '_qbot.cmp'))
+        t = readcmp(join(batdir, str(num) + '_t.cmp'))
+    else:
+        qbot = fromfile(join(batdir, str(num) + '_qbot'), dtype='float32')
+        t = fromfile(join(batdir, str(num) + '_t'), dtype='float32')
     return( trapz(qbot, t)/(t.max() - t.min()) )
 
 #-------------------------------------------------------------------------------
 #MAIN
 
-#get filenames with integer prefixes
-fns = [fn for fn in listdir(batdir) if isint(fn.split('_')[0])]
+#get filenames or store keys with integer prefixes
+if isfile(join(batdir, fnstore)):
+    fns = Store(join(batdir, fnstore)).keys()
+else:
+    fns = listdir(batdir)
+fns = [fn for fn in fns if isint(fn.split('_')[0])]
 #take only qbot files
 fns = [fn for fn in fns if ('qbot' in fn)]
 #sort by prefix
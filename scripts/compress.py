@@ -0,0 +1,41 @@
+import sys
+from os.path import join, dirname, abspath
+from numpy import *
+
+#blocks are decoded by the compiled decoder in src/compress.cc, through the
+#python module built into bin/ by `make python`
+sys.path.insert(0, join(dirname(abspath(__file__)), '..', 'bin'))
+import richards
+
+#-------------------------------------------------------------------------------
+#FUNCTIONS
+
+def decompress_block(buf, pos):
+    """Decompresses one block written by compress_series in src/compress.cc,
+    starting at byte offset pos of buf. Returns the number of columns in the
+    group, the column of the series, its values as float32, and the offset
+    after the block."""
+
+    ncol, j, x, pos = richards.decompress_block(buf, pos)
+    return(ncol, j, asarray(x, dtype='float32'), pos)
+
+def decompress(buf):
+    """Decompresses all the blocks of a compressed tracker output and returns
+    an array of shape (ncol, nt), with the values of each column in time
+    order, or a 1D array if there is a single column."""
+
+    cols = {}
+    pos = 0
+    ncol = 1
+    while pos < len(buf):
+        ncol, j, x, pos = decompress_block(buf, pos)
+        cols.setdefault(j, []).append(x)
+    a = array([concatenate(cols[j]) for j in range(ncol)])
+    if ncol == 1:
+        a = a[0]
+    return(a)
+
+def readcmp(fn):
+    """Reads and decompresses a compressed tracker output file."""
+    with open(fn, 'rb') as f:
+        return(decompress(f.read()))
@@ -1,8 +1,10 @@
-from os.path import join
+from os.path import join, isfile
 from numpy import *
 from scipy.integrate import simps, trapz
 import matplotlib.pyplot as plt
 from matplotlib.collections import LineCollection
+from store import Store
+from compress import readcmp
 
 #plt.style.use('dark_background')
 #plt.rc('font', family='serif')
@@ -26,7 +28,25 @@ meanq = -1
 #-------------------------------------------------------------------------------
 #FUNCTIONS
 
-readvar = lambda fn, dtype='float32': fromfile(join(resdir, fn), dtype=dtype)
+#output store, if the run wrote one
+fnstore = join(resdir, 'output.store')
+store = Store(fnstore) if isfile(fnstore) else None
+
+def readvar(fn, dtype='float32'):
+    if store is not None:
+        if fn not in store:
+            raise FileNotFoundError(fn)
+        return(array(store[fn]).ravel())
+    if isfile(join(resdir, fn + '.cmp')):
+        return(readcmp(join(resdir, fn + '.cmp')).ravel())
+    return(fromfile(join(resdir, fn), dtype=dtype))
+
+def readprof(fn, m, nt):
+    #profiles spilled to disk during a run are time-major
+    try:
+        return(readvar(fn + 't').reshape(nt, m).T.copy())
+    except FileNotFoundError:
+        return(readvar(fn).reshape(m, nt))
 
 #-------------------------------------------------------------------------------
 #FUNCTIONS
@@ -85,12 +105,11 @@ fig.tight_layout()
 
 if wall:
     try:
-        w = readvar('richards_wall')
+        w = readprof('richards_wall', len(zc), len(t))
     except FileNotFoundError:
         print("wall file not found, can't plot wall")
     else:
         fig, ax = plt.subplots(1,1)
-        w = w.reshape(len(zc), len(t))
         r = ax.contourf(th, -zc, w, cmap='Blues')
         cb = plt.colorbar(r, ax=ax)
         ax.set_xlabel('Time (hr)')
@@ -102,12 +121,11 @@ if wall:
 
 if qall:
     try:
-        q = readvar('richards_qall')
+        q = readprof('richards_qall', len(ze), len(t))
     except FileNotFoundError:
         print("qall file not found, can't plot qall")
     else:
         fig, ax = plt.subplots(1,1)
-        q = q.reshape(len(ze), len(t))
         for i in range(q.shape[0]):
             q[i,:] /= abs(q[i,:]).max()
         r = ax.contourf(th, -ze, q, cmap='coolwarm', vmin=-1, vmax=1)
@@ -121,12 +139,11 @@ if qall:
 
 if meanq:
     try:
-        q = readvar('richards_qall')
+        q = readprof('richards_qall', len(ze), len(t))
     except FileNotFoundError:
         print("qall file not found, can't plot mean fluxes")
     else:
         fig, ax = plt.subplots(1,1)
-        q = q.reshape(len(ze), len(t))
         mqs = array([simps(i,t) for i in q[:meanq]])/(t.max() - t.min())
         mqt = array([trapz(i,t) for i in q[:meanq]])/(t.max() - t.min())
         ax.plot(mqs, -ze[:meanq], label='simps')
@@ -0,0 +1,93 @@
+from numpy import *
+from compress import decompress
+
+#-------------------------------------------------------------------------------
+#INPUT
+
+#layout of the header and records, matching src/store.h
+header_dtype = dtype([
+    ('magic', 'S8'),
+    ('version', '<u8'),
+    ('index', '<u8'),
+    ('nrec', '<u8'),
+    ('pad', 'V32')
+])
+record_dtype = dtype([
+    ('key', 'S80'),
+    ('dtype', 'S8'),
+    ('nrow', '<i8'),
+    ('ncol', '<i8'),
+    ('offset', '<u8'),
+    ('nbytes', '<u8'),
+    ('pad', 'V8')
+])
+
+#alignment of records
+align = 64
+
+#-------------------------------------------------------------------------------
+#FUNCTIONS
+
+class Store:
+    """Reads an output store written with the store setting, mapping the data
+    of every record without copying it. Keys are the names the outputs would
+    have as separate files, like '12_qbot' or 'richards_w_3'."""
+
+    def __init__(self, fn):
+        self.fn = fn
+        self.mm = memmap(fn, dtype='u1', mode='r')
+        h = self.mm[:header_dtype.itemsize].view(header_dtype)[0]
+        if h['magic'] != b'RICHSTOR':
+            raise ValueError('%s is not a store' % fn)
+        if h['index'] > 0:
+            i = int(h['index'])
+            recs = self.mm[i:i + int(h['nrec'])*record_dtype.itemsize].view(record_dtype)
+        else:
+            recs = self._scan()
+        #all the records of each key, in the order they were written
+        self.records = {}
+        for r in recs:
+            self.records.setdefault(r['key'].decode(), []).append(r)
+
+    def _scan(self):
+        #an unclosed store has no index, so walk the records from the header
+        recs = []
+        i = header_dtype.itemsize
+        while i + record_dtype.itemsize <= len(self.mm):
+            r = self.mm[i:i + record_dtype.itemsize].view(record_dtype)[0]
+            end = int(r['offset'] + r['nbytes'])
+            if (r['key'][:1] == b'') or (end > len(self.mm)):
+                break
+            recs.append(r)
+            i = end + (-end % align)
+        return(recs)
+
+    def _bytes(self, r):
+        i = int(r['offset'])
+        return(self.mm[i:i + int(r['nbytes'])].tobytes())
+
+    def keys(self):
+        return(list(self.records.keys()))
+
+    def __contains__(self, key):
+        return(key in self.records)
+
+    def __getitem__(self, key):
+        """Maps a variable, concatenating chunks along their rows and
+        flattening single columns or rows. Raveling the result gives the array
+        that would have been read from the variable's own file."""
+        recs = self.records[key]
+        if recs[0]['dtype'] == b'|cmp':
+            #compressed trackers are decompressed into (ncol, nt) arrays
+            return(decompress(b''.join(self._bytes(r) for r in recs)))
+        parts = []
+        for r in recs:
+            i = int(r['offset'])
+            a = self.mm[i:i + int(r['nbytes'])].view(r['dtype'].decode())
+            parts.append(a.reshape(int(r['nrow']), int(r['ncol'])))
+        a = parts[0] if len(parts) == 1 else concatenate(parts, axis=0)
+        if a.shape[1] == 1:
+            a = a[:,0]
+        elif a.shape[0] == 1:
+            a = a[0,:]
+        return(a)
@@ -0,0 +1,100 @@
+//! \file checkpoint.cc
+
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <cinttypes>
+#include <sys/stat.h>
+
+#include "checkpoint.h"
+
+//!set by the signal handler
+static volatile sig_atomic_t terminated = 0;
+
+static void handle_terminate (int sig) {
+    (void)sig;
+    terminated = 1;
+}
+
+void install_checkpoint_handler () {
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = handle_terminate;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGTERM, &sa, NULL);
+}
+
+bool terminate_requested () {
+    return( terminated != 0 );
+}
+
+double wall_time () {
+    return( std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count() );
+}
+
+bool file_exists (const std::string &fn) {
+    struct stat st;
+    return( stat(fn.c_str(), &st) == 0 );
+}
+
+void put_string (FILE *f, const std::string &s) {
+    uint64_t m = s.size();
+    put_value(f, m);
+    fwrite(s.data(), 1, m, f);
+}
+
+void get_string (FILE *f, std::string &s) {
+    uint64_t m;
+    get_value(f, m);
+    s.resize(m);
+    if ( (m > 0) && (fread(&s[0], 1, m, f) != m) )
+        print_exit("checkpoint file ended unexpectedly");
+}
+
+//------------------------------------------------------------------------------
+//batch trials
+
+TrialLog::TrialLog (const std::string &fn, uint64_t hash) {
+
+    existed = file_exists(fn);
+    if ( existed ) {
+        //check the settings and read the finished trials
+        std::ifstream ifile(fn.c_str());
+        std::string line, row;
+        uint64_t h = 0;
+        if ( std::getline(ifile, line) )
+            sscanf(line.c_str(), "hash %" SCNx64, &h);
+        if ( h != hash ) {
+            printf("FAILURE: %s was written by a sweep with different settings, remove it to start over\n", fn.c_str());
+            exit(EXIT_FAILURE);
+        }
+        std::string::size_type idx;
+        while ( std::getline(ifile, line) ) {
+            if ( line.empty() )
+                continue;
+            idx = line.find(',');
+            row = (idx == std::string::npos) ? "" : line.substr(idx + 1);
+            rows[std::strtoul(line.c_str(), NULL, 10)] = row;
+        }
+        ofile = fopen(fn.c_str(), "a");
+    } else {
+        check_file_write(fn.c_str());
+        ofile = fopen(fn.c_str(), "w");
+        fprintf(ofile, "hash %016" PRIx64 "\n", hash);
+        fflush(ofile);
+    }
+}
+
+TrialLog::~TrialLog () {
+    fclose(ofile);
+}
+
+void TrialLog::add (unsigned long trial, const std::string &row) {
+    std::lock_guard<std::mutex> lock(mtx);
+    if ( row.empty() ) {
+        fprintf(ofile, "%lu\n", trial);
+    } else {
+        fprintf(ofile, "%lu,%s\n", trial, row.c_str());
+    }
+    fflush(ofile);
+}
@@ -0,0 +1,130 @@
+#ifndef CHECKPOINT_H_
+#define CHECKPOINT_H_
+
+//! \file checkpoint.h
+
+#include <map>
+#include <mutex>
+#include <cstdio>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "io.h"
+
+//!identifies checkpoint files
+#define CKPT_MAGIC "RICHCKPT"
+//!version of the checkpoint format
+#define CKPT_VERSION 2
+
+//!thrown out of an integration once its checkpoint has been written after a termination signal
+struct Terminated {};
+
+//!makes SIGTERM request a checkpoint from every integration that is checkpointing
+/*!
+The handler only sets a flag. Integrations check it between steps, write their checkpoints, and throw a Terminated, which the drivers catch.
+*/
+void install_checkpoint_handler ();
+
+//!checks whether a termination signal has arrived
+bool terminate_requested ();
+
+//!gets the wall clock time in seconds
+double wall_time ();
+
+//!checks whether a file exists
+bool file_exists (const std::string &fn);
+
+//------------------------------------------------------------------------------
+//binary values
+
+//!writes a plain value into a binary file
+template <class T>
+void put_value (FILE *f, const T &x) {
+    fwrite(&x, sizeof(T), 1, f);
+}
+
+//!reads a plain value from a binary file, quitting if the file ends
+template <class T>
+void get_value (FILE *f, T &x) {
+    if ( fread(&x, sizeof(T), 1, f) != 1 )
+        print_exit("checkpoint file ended unexpectedly");
+}
+
+//!writes a vector of plain values into a binary file, preceded by its length
+template <class T>
+void put_vector (FILE *f, const std::vector<T> &a) {
+    uint64_t m = a.size();
+    put_value(f, m);
+    fwrite(a.data(), sizeof(T), m, f);
+}
+
+//!reads a vector written by put_vector
+template <class T>
+void get_vector (FILE *f, std::vector<T> &a) {
+    uint64_t m;
+    get_value(f, m);
+    a.resize(m);
+    if ( fread(a.data(), sizeof(T), m, f) != m )
+        print_exit("checkpoint file ended unexpectedly");
+}
+
+//!writes a string into a binary file
+void put_string (FILE *f, const std::string &s);
+
+//!reads a string written by put_string
+void get_string (FILE *f, std::string &s);
+
+//------------------------------------------------------------------------------
+//batch trials
+
+//!append-only log of finished batch trials, so a restarted sweep can skip them
+/*!
+The first line of the file holds a hash of the sweep's settings. Every finished trial appends a line with its number, optionally followed by a comma and a row of text, like the trial's metrics. Lines are flushed as they're written, so the log survives a killed job.
+*/
+class TrialLog {
+
+public:
+
+    //!opens a log, reading any trials already finished
+    /*!
+    The program quits if an existing log was written with different settings.
+    \param[in] fn path to the log file
+    \param[in] hash hash of the sweep's settings
+    */
+    TrialLog (const std::string &fn, uint64_t hash);
+    //!closes the log file
+    ~TrialLog ();
+
+    //!checks whether the log existed before, so the sweep is being restarted
+    bool restarted () { return(existed); }
+
+    //!gets the number of trials finished before the log was opened
+    unsigned long get_ndone () { return(rows.size()); }
+
+    //!checks whether a trial was finished before the log was opened
+    bool is_done (unsigned long trial) { return( rows.count(trial) > 0 ); }
+
+    //!gets the row of text logged with a finished trial
+    std::string get_row (unsigned long trial) { return(rows[trial]); }
+
+    //!logs a finished trial
+    /*!
+    \param[in] trial trial number
+    \param[in] row text to log with the trial, without newlines
+    */
+    void add (unsigned long trial, const std::string &row="");
+
+private:
+
+    //!open log file
+    FILE *ofile;
+    //!whether the log existed before
+    bool existed;
+    //!rows of the trials finished before the log was opened
+    std::map<unsigned long, std::string> rows;
+    //!serializes appending
+    std::mutex mtx;
+};
+
+#endif
@@ -0,0 +1,166 @@
+//! \file compress.cc
+
+#include "compress.h"
+
+//!writes bits into a byte vector, most significant first
+class BitWriter {
+public:
+    BitWriter (std::vector<unsigned char> &out) : out (out), acc (0), nacc (0) {}
+    //!writes the lowest nb bits of v, for nb up to 56
+    void put (uint64_t v, int nb) {
+        if ( nb == 0 ) return;
+        acc = (acc << nb) | (v & ((uint64_t(1) << nb) - 1));
+        nacc += nb;
+        while ( nacc >= 8 ) {
+            nacc -= 8;
+            out.push_back( (unsigned char)(acc >> nacc) );
+        }
+    }
+    //!writes any remaining bits, padded with zeros
+    void finish () {
+        if ( nacc > 0 )
+            out.push_back( (unsigned char)(acc << (8 - nacc)) );
+        nacc = 0;
+    }
+private:
+    std::vector<unsigned char> &out;
+    uint64_t acc;
+    int nacc;
+};
+
+//!reads bits written by a BitWriter
+class BitReader {
+public:
+    BitReader (const unsigned char *in) : in (in), pos (0) {}
+    //!reads nb bits
+    uint64_t get (int nb) {
+        uint64_t v = 0;
+        for (int k=0; k<nb; k++) {
+            v = (v << 1) | ((in[pos >> 3] >> (7 - (pos & 7))) & 1);
+            pos++;
+        }
+        return(v);
+    }
+private:
+    const unsigned char *in;
+    uint64_t pos;
+};
+
+static void put_le (std::vector<unsigned char> &out, uint64_t v, int nbyte) {
+    for (int k=0; k<nbyte; k++) out.push_back( (unsigned char)(v >> (8*k)) );
+}
+
+static uint64_t get_le (const unsigned char *in, int nbyte) {
+    uint64_t v = 0;
+    for (int k=nbyte-1; k>=0; k--) v = (v << 8) | in[k];
+    return(v);
+}
+
+//!maps the bits of a float to an integer that increases with its value
+static int64_t to_ordered (uint32_t b, int drop) {
+    int64_t mag = (b & 0x7fffffff) >> drop;
+    return( (b >> 31) ? -mag - 1 : mag );
+}
+
+//!inverts to_ordered
+static uint32_t from_ordered (int64_t s, int drop) {
+    if ( s < 0 )
+        return( (uint32_t(-s - 1) << drop) | 0x80000000 );
+    return( uint32_t(s) << drop );
+}
+
+//!rounds the mantissa of a float's bits, leaving drop trailing zeros
+static uint32_t round_bits (uint32_t b, int drop) {
+    if ( drop == 0 )
+        return(b);
+    //a quiet NaN survives dropping bits
+    if ( ((b >> 23) & 0xff) == 0xff )
+        return( (b & 0x7fffff) ? 0x7fc00000 : b );
+    uint32_t mask = (uint32_t(1) << drop) - 1;
+    uint32_t r = (b + (uint32_t(1) << (drop - 1))) & ~mask;
+    //don't round up into an infinity
+    if ( ((r >> 23) & 0xff) == 0xff )
+        return(b & ~mask);
+    return(r);
+}
+
+void compress_series (const float *x, unsigned long m, long stride, uint32_t ncol, uint32_t j, double rtol, std::vector<unsigned char> &out) {
+
+    //mantissa bits that can be dropped within tolerance, keeping quiet NaNs
+    int drop = 0;
+    if ( rtol > 0 ) {
+        drop = 23 - int(ceil(-log2(rtol)));
+        if ( drop < 0 ) drop = 0;
+        if ( drop > 22 ) drop = 22;
+    }
+
+    //header, with the number of bytes filled in afterward
+    put_le(out, ncol, 4);
+    put_le(out, j, 4);
+    put_le(out, m, 8);
+    unsigned long h = out.size();
+    put_le(out, 0, 8);
+    put_le(out, drop, 4);
+    put_le(out, 0, 4);
+    unsigned long start = out.size();
+
+    BitWriter bw(out);
+    uint32_t b;
+    int64_t s, s1 = 0, s2 = 0, r;
+    uint64_t z;
+    int len;
+    for (unsigned long i=0; i<m; i++) {
+        memcpy(&b, x + i*stride, sizeof(b));
+        s = to_ordered(round_bits(b, drop), drop);
+        //residual of linear extrapolation, zigzagged to be positive
+        r = s - (i == 0 ? 0 : (i == 1 ? s1 : 2*s1 - s2));
+        z = (r < 0) ? ((uint64_t(-(r + 1)) << 1) | 1) : (uint64_t(r) << 1);
+        if ( z == 0 ) {
+            bw.put(0, 1);
+        } else {
+            len = 64 - __builtin_clzll(z);
+            bw.put(1, 1);
+            bw.put(len, 6);
+            bw.put(z, len - 1);
+        }
+        s2 = s1;
+        s1 = s;
+    }
+    bw.finish();
+
+    //number of encoded bytes
+    uint64_t nb = out.size() - start;
+    for (int k=0; k<8; k++) out[h+k] = (unsigned char)(nb >> (8*k));
+}
+
+unsigned long decompress_series (const unsigned char *in, unsigned long pos, std::vector<float> &x, uint32_t &ncol, uint32_t &j) {
+
+    ncol = uint32_t(get_le(in + pos, 4));
+    j = uint32_t(get_le(in + pos + 4, 4));
+    uint64_t m = get_le(in + pos + 8, 8);
+    uint64_t nb = get_le(in + pos + 16, 8);
+    int drop = int(get_le(in + pos + 24, 4));
+
+    BitReader br(in + pos + COMPRESS_HEADER);
+    int64_t s, s1 = 0, s2 = 0, r;
+    uint64_t z;
+    uint32_t b;
+    int len;
+    float f;
+    for (uint64_t i=0; i<m; i++) {
+        z = 0;
+        if ( br.get(1) ) {
+            len = int(br.get(6));
+            z = (uint64_t(1) << (len - 1)) | br.get(len - 1);
+        }
+        r = (z & 1) ? -int64_t(z >> 1) - 1 : int64_t(z >> 1);
+        s = r + (i == 0 ? 0 : (i == 1 ? s1 : 2*s1 - s2));
+        b = from_ordered(s, drop);
+        memcpy(&f, &b, sizeof(f));
+        x.push_back( f );
+        s2 = s1;
+        s1 = s;
+    }
+
+    return( pos + COMPRESS_HEADER + nb );
+}
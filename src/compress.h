@@ -0,0 +1,42 @@
+#ifndef COMPRESS_H_
+#define COMPRESS_H_
+
+//! \file compress.h
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+//!number of bytes in the header of a compressed block
+#define COMPRESS_HEADER 32
+
+//!compresses a series of floats into a block, appending it to a byte vector
+/*!
+The bits of each float are mapped to an integer that increases with the float's value, so a smooth series becomes a smooth integer sequence. Each integer is predicted by linear extrapolation of the previous two and only the residual is stored, like the delta-of-delta encoding of timestamps in Facebook's Gorilla time series database. A zero residual takes one bit and any other takes a one, a six bit length, and the residual's bits below its leading one. The encoding is lossless.
+
+Optionally, each value is first rounded to the fewest mantissa bits that keep its relative error under a tolerance, and the dropped bits are left out of the integers, which shrinks the residuals further. Infinities are kept, but in this case all NaNs become the same quiet NaN.
+
+A block starts with a 32 byte little-endian header: the number of columns in the group the series belongs to (uint32), the series' column in that group (uint32), the number of values (uint64), the number of bytes of encoded bits that follow (uint64), the number of dropped mantissa bits (uint32), and four unused bytes. The bits are packed most significant first.
+\param[in] x first value of the series
+\param[in] m number of values
+\param[in] stride distance between consecutive values in x
+\param[in] ncol number of columns in the group
+\param[in] j column of the series in the group
+\param[in] rtol relative rounding tolerance, or zero to compress losslessly
+\param[out] out byte vector the block is appended to
+*/
+void compress_series (const float *x, unsigned long m, long stride, uint32_t ncol, uint32_t j, double rtol, std::vector<unsigned char> &out);
+
+//!decompresses a block written by compress_series
+/*!
+\param[in] in compressed bytes
+\param[in] pos offset of the block in the compressed bytes
+\param[out] x decompressed values, appended
+\param[out] ncol number of columns in the group
+\param[out] j column of the series in the group
+\return offset of the byte after the block
+*/
+unsigned long decompress_series (const unsigned char *in, unsigned long pos, std::vector<float> &x, uint32_t &ncol, uint32_t &j);
+
+#endif
@@ -0,0 +1,180 @@
+#ifndef DUAL_H_
+#define DUAL_H_
+
+//! \file dual.h
+
+#include <cmath>
+
+//!forward-mode dual number carrying a value and N partial derivatives
+/*!
+Arithmetic on a Dual propagates first derivatives with respect to N independent parameters alongside the value, so a function templated on its scalar type can be differentiated exactly by evaluating it once with Dual arguments. Comparisons only look at the value.
+*/
+template <int N>
+class Dual {
+public:
+
+    //!value
+    double v;
+    //!partial derivatives
+    double d[N];
+
+    //!constructs a zero with zero derivatives
+    Dual () : v (0.0) { for (int k=0; k<N; k++) d[k] = 0.0; }
+
+    //!constructs a constant with zero derivatives
+    Dual (double x) : v (x) { for (int k=0; k<N; k++) d[k] = 0.0; }
+
+    //!constructs an independent variable, seeding its own partial derivative
+    /*!
+    \param[in] x value of the variable
+    \param[in] k index of the partial derivative set to one
+    */
+    Dual (double x, int k) : v (x) {
+        for (int j=0; j<N; j++) d[j] = 0.0;
+        d[k] = 1.0;
+    }
+
+    Dual& operator+= (const Dual &b) { v += b.v; for (int k=0; k<N; k++) d[k] += b.d[k]; return(*this); }
+    Dual& operator-= (const Dual &b) { v -= b.v; for (int k=0; k<N; k++) d[k] -= b.d[k]; return(*this); }
+    Dual& operator*= (double b) { v *= b; for (int k=0; k<N; k++) d[k] *= b; return(*this); }
+};
+
+//------------------------------------------------------------------------------
+//arithmetic
+
+template <int N>
+Dual<N> operator- (const Dual<N> &a) {
+    Dual<N> r;
+    r.v = -a.v;
+    for (int k=0; k<N; k++) r.d[k] = -a.d[k];
+    return(r);
+}
+
+template <int N>
+Dual<N> operator+ (const Dual<N> &a, const Dual<N> &b) {
+    Dual<N> r;
+    r.v = a.v + b.v;
+    for (int k=0; k<N; k++) r.d[k] = a.d[k] + b.d[k];
+    return(r);
+}
+
+template <int N>
+Dual<N> operator+ (const Dual<N> &a, double b) {
+    Dual<N> r(a);
+    r.v += b;
+    return(r);
+}
+
+template <int N>
+Dual<N> operator+ (double a, const Dual<N> &b) {
+    return( b + a );
+}
+
+template <int N>
+Dual<N> operator- (const Dual<N> &a, const Dual<N> &b) {
+    Dual<N> r;
+    r.v = a.v - b.v;
+    for (int k=0; k<N; k++) r.d[k] = a.d[k] - b.d[k];
+    return(r);
+}
+
+template <int N>
+Dual<N> operator- (const Dual<N> &a, double b) {
+    Dual<N> r(a);
+    r.v -= b;
+    return(r);
+}
+
+template <int N>
+Dual<N> operator- (double a, const Dual<N> &b) {
+    Dual<N> r(-b);
+    r.v += a;
+    return(r);
+}
+
+template <int N>
+Dual<N> operator* (const Dual<N> &a, const Dual<N> &b) {
+    Dual<N> r;
+    r.v = a.v*b.v;
+    for (int k=0; k<N; k++) r.d[k] = a.d[k]*b.v + a.v*b.d[k];
+    return(r);
+}
+
+template <int N>
+Dual<N> operator* (const Dual<N> &a, double b) {
+    Dual<N> r;
+    r.v = a.v*b;
+    for (int k=0; k<N; k++) r.d[k] = a.d[k]*b;
+    return(r);
+}
+
+template <int N>
+Dual<N> operator* (double a, const Dual<N> &b) {
+    return( b*a );
+}
+
+template <int N>
+Dual<N> operator/ (const Dual<N> &a, const Dual<N> &b) {
+    Dual<N> r;
+    r.v = a.v/b.v;
+    for (int k=0; k<N; k++) r.d[k] = (a.d[k] - r.v*b.d[k])/b.v;
+    return(r);
+}
+
+template <int N>
+Dual<N> operator/ (const Dual<N> &a, double b) {
+    Dual<N> r;
+    r.v = a.v/b;
+    for (int k=0; k<N; k++) r.d[k] = a.d[k]/b;
+    return(r);
+}
+
+template <int N>
+Dual<N> operator/ (double a, const Dual<N> &b) {
+    Dual<N> r;
+    r.v = a/b.v;
+    for (int k=0; k<N; k++) r.d[k] = -r.v*b.d[k]/b.v;
+    return(r);
+}
+
+//------------------------------------------------------------------------------
+//comparisons, which only consider the value
+
+template <int N> bool operator< (const Dual<N> &a, const Dual<N> &b) { return(a.v < b.v); }
+template <int N> bool operator< (const Dual<N> &a, double b) { return(a.v < b); }
+template <int N> bool operator< (double a, const Dual<N> &b) { return(a < b.v); }
+template <int N> bool operator> (const Dual<N> &a, const Dual<N> &b) { return(a.v > b.v); }
+template <int N> bool operator> (const Dual<N> &a, double b) { return(a.v > b); }
+template <int N> bool operator> (double a, const Dual<N> &b) { return(a > b.v); }
+
+//------------------------------------------------------------------------------
+//functions
+
+//!raises a dual number to a constant power
+template <int N>
+Dual<N> pow (const Dual<N> &a, double p) {
+    Dual<N> r;
+    r.v = std::pow(a.v, p);
+    double f = p*std::pow(a.v, p - 1.0);
+    for (int k=0; k<N; k++) r.d[k] = f*a.d[k];
+    return(r);
+}
+
+//!raises a dual number to a dual power
+template <int N>
+Dual<N> pow (const Dual<N> &a, const Dual<N> &p) {
+    Dual<N> r;
+    r.v = std::pow(a.v, p.v);
+    double la = std::log(a.v);
+    for (int k=0; k<N; k++) r.d[k] = r.v*(p.d[k]*la + p.v*a.d[k]/a.v);
+    return(r);
+}
+
+//!extracts the value of a plain double
+inline double val (double x) { return(x); }
+
+//!extracts the value of a dual number
+template <int N>
+double val (const Dual<N> &x) { return(x.v); }
+
+#endif
@@ -0,0 +1,181 @@
+//! \file forcing.cc
+
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+#include "forcing.h"
+
+Forcing::Forcing (const std::string &fn) : fn (fn) {
+
+    //errors are thrown rather than quitting, because the model may be embedded in another program
+    ifile = fopen(fn.c_str(), "rb");
+    if ( ifile == NULL )
+        throw std::runtime_error("cannot open the forcing series " + fn);
+    try {
+        //binary files are recognized by their first characters
+        char magic[8];
+        binary = (fread(magic, 1, 8, ifile) == 8) && (memcmp(magic, "RICHFORC", 8) == 0);
+        line0 = 0;
+        if ( binary ) {
+            data = 8;
+        } else {
+            //a first line that doesn't start with a number is a header
+            char s[1024];
+            fseek(ifile, 0, SEEK_SET);
+            data = 0;
+            while ( fgets(s, sizeof(s), ifile) != NULL ) {
+                char *p = s + strspn(s, " \t\r\n");
+                if ( (*p == '\0') || (*p == '#') ) {
+                    line0++;
+                    data = ftell(ifile);
+                    continue;
+                }
+                char *e;
+                strtod(p, &e);
+                if ( e == p ) {
+                    line0++;
+                    data = ftell(ifile);
+                }
+                break;
+            }
+        }
+        rewind();
+        if ( buf.empty() )
+            throw std::runtime_error("the forcing series " + fn + " has no records");
+    } catch ( ... ) {
+        //the destructor isn't called for a constructor that throws
+        fclose(ifile);
+        throw;
+    }
+}
+
+Forcing::~Forcing () {
+    fclose(ifile);
+}
+
+void Forcing::seek (double t) {
+
+    while ( true ) {
+        if ( t < buf[cur].t ) {
+            //back a record, or to the start of the file
+            if ( cur > 0 ) {
+                cur--;
+            } else if ( !head ) {
+                rewind();
+            } else {
+                //before the first record, which holds
+                break;
+            }
+        } else if ( cur + 1 < buf.size() ) {
+            //forward a record, unless this one holds
+            if ( t < buf[cur+1].t )
+                break;
+            cur++;
+        } else if ( eof ) {
+            //the last record holds forever
+            break;
+        } else {
+            fill();
+        }
+    }
+    //the cursor's record must end in memory to know when the forcing changes
+    if ( (cur + 1 == buf.size()) && !eof )
+        fill();
+    set_end();
+}
+
+void Forcing::fill () {
+
+    //keep the cursor's record and the one before it
+    unsigned long k = (cur > 0) ? cur - 1 : 0;
+    if ( k > 0 ) {
+        buf.erase(buf.begin(), buf.begin() + k);
+        cur -= k;
+        head = false;
+    }
+    //read records until a chunk of distinct ones is added
+    ForcingRecord r;
+    unsigned long m = 0;
+    while ( m < FORCING_CHUNK ) {
+        if ( !read(r) ) {
+            eof = true;
+            break;
+        }
+        if ( !buf.empty() && (r.wet == buf.back().wet) && (r.tauevap == buf.back().tauevap) && (r.Levap == buf.back().Levap) )
+            continue;
+        buf.push_back(r);
+        m++;
+    }
+}
+
+void Forcing::rewind () {
+
+    fseek(ifile, data, SEEK_SET);
+    line = line0;
+    tlast = -INFINITY;
+    buf.clear();
+    buf.reserve(FORCING_CHUNK + 2);
+    cur = 0;
+    head = true;
+    eof = false;
+    fill();
+    if ( !buf.empty() )
+        set_end();
+}
+
+bool Forcing::read (ForcingRecord &r) {
+
+    //time, precipitation, and evaporation scales
+    double v[4] = {0.0, 0.0, 0.0, 0.0};
+    std::string where;
+    if ( binary ) {
+        size_t m = fread(v, sizeof(double), 4, ifile);
+        if ( m == 0 )
+            return(false);
+        where = "record at time " + std::to_string(v[0]);
+        if ( m != 4 )
+            throw std::runtime_error("the forcing series " + fn + " ends in the middle of a record");
+    } else {
+        char s[1024];
+        char *p;
+        //skip blank and comment lines
+        do {
+            if ( fgets(s, sizeof(s), ifile) == NULL )
+                return(false);
+            line++;
+            p = s + strspn(s, " \t\r\n");
+        } while ( (*p == '\0') || (*p == '#') );
+        where = "line " + std::to_string(line);
+        //two or four comma separated numbers
+        int m = 0;
+        char *e;
+        while ( m < 4 ) {
+            v[m] = strtod(p, &e);
+            if ( e == p )
+                break;
+            m++;
+            p = e + strspn(e, " \t\r\n");
+            if ( *p != ',' )
+                break;
+            p++;
+        }
+        if ( ((m != 2) && (m != 4)) || (*p != '\0') )
+            throw std::runtime_error("line " + std::to_string(line) + " of the forcing series " + fn + " isn't two or four comma separated numbers");
+    }
+
+    //check the values
+    if ( !std::isfinite(v[0]) || !std::isfinite(v[1]) || !std::isfinite(v[2]) || !std::isfinite(v[3]) )
+        throw std::runtime_error("the forcing series " + fn + " has a value that isn't finite, at " + where);
+    if ( v[0] <= tlast )
+        throw std::runtime_error("the times of the forcing series " + fn + " don't increase, at " + where);
+    if ( (v[1] < 0) || (v[2] < 0) || (v[3] < 0) )
+        throw std::runtime_error("the forcing series " + fn + " has a negative precipitation or evaporation scale, at " + where);
+    tlast = v[0];
+
+    r.t = v[0];
+    r.wet = v[1] > 0;
+    r.tauevap = v[2];
+    r.Levap = v[3];
+    return(true);
+}
@@ -0,0 +1,111 @@
+#ifndef FORCING_H_
+#define FORCING_H_
+
+//! \file forcing.h
+
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+//!number of records read into memory at a time from a forcing series
+#define FORCING_CHUNK 4096
+
+//!one record of a surface forcing series, holding from its time until the next record's
+struct ForcingRecord {
+    //!time the record starts (s)
+    double t;
+    //!whether it's raining, saturating the surface, or else the surface is evaporating
+    bool wet;
+    //!evaporation time scale (s), or zero to keep the one in the settings
+    double tauevap;
+    //!evaporation length scale (m), or zero to keep the one in the settings
+    double Levap;
+};
+
+//!observed surface forcing, streamed from a file and looked up with a cursor
+/*!
+A series is a list of records, each with a time, a precipitation rate, and optionally evaporation time and length scales, in increasing order of time. The surface is saturated while the precipitation is positive and evaporates otherwise. Each record holds until the next one, the first also holds before it, and the last holds forever. Consecutive records that force the surface the same way are merged, so the boundaries between records are exactly the times the forcing changes.
+
+Series are read either from a csv file, with lines of `t,precip` or `t,precip,tauevap,Levap`, an optional header, and blank or `#` lines ignored, or from a binary file starting with the 8 characters `RICHFORC` followed by native doubles, four per record in the same order. Only FORCING_CHUNK records are in memory at a time, so years of records cost no more memory than a day of them. A file that can't be read, or a malformed record, throws a std::runtime_error naming the file and where in it, rather than quitting a program the model is embedded in.
+
+Lookups move a cursor, which integrations only ever move forward except within the step being taken, so each is amortized constant time. The records before the cursor's are dropped as new chunks are read, except the one just before it, so a step's stages can look back across the boundary it ends on. Looking further back reads the file again from the start.
+*/
+class Forcing {
+
+public:
+
+    //!opens a series and reads its first chunk
+    /*!
+    \param[in] fn path to the csv or binary file
+    */
+    Forcing (const std::string &fn);
+    //!closes the file
+    ~Forcing ();
+
+    //!gets the path to the series
+    const std::string &path () { return(fn); }
+
+    //!moves the cursor to the record holding at a time
+    /*!
+    \param[in] t time (s)
+    \return the record holding at t
+    */
+    const ForcingRecord &at (double t) {
+        //almost every lookup is in the same record as the last one
+        if ( (t >= buf[cur].t) && (t < tend) )
+            return(buf[cur]);
+        seek(t);
+        return(buf[cur]);
+    }
+
+    //!gets the time the cursor's record ends, when the forcing next changes, or infinity if it never does (s)
+    double next () { return(tend); }
+
+    //!gets the length of the cursor's record, or infinity if it's the first or last (s)
+    double span () { return( (head && (cur == 0)) ? INFINITY : tend - buf[cur].t ); }
+
+private:
+
+    //!moves the cursor to the record holding at a time, reading the file as needed
+    void seek (double t);
+
+    //!drops records before the cursor's previous one and reads the next chunk
+    void fill ();
+
+    //!starts reading the file again from its first record
+    void rewind ();
+
+    //!reads the next record of the file, returning false at its end
+    bool read (ForcingRecord &r);
+
+    //!sets the end of the cursor's record
+    void set_end () { tend = (cur + 1 < buf.size()) ? buf[cur+1].t : INFINITY; }
+
+    //!path to the series
+    std::string fn;
+    //!open file
+    FILE *ifile;
+    //!whether the file is binary, or else csv
+    bool binary;
+    //!offset of the first record in the file
+    long data;
+    //!line of the csv file before the first record
+    long line0;
+    //!line of the csv file last read, for errors
+    long line;
+    //!time of the last record read, to check the order
+    double tlast;
+    //!records in memory, the cursor's previous one first once the file has been read past the first chunk
+    std::vector<ForcingRecord> buf;
+    //!index of the cursor's record in buf
+    unsigned long cur;
+    //!time the cursor's record ends (s)
+    double tend;
+    //!whether the first record in buf is the first of the series
+    bool head;
+    //!whether the whole file has been read
+    bool eof;
+};
+
+#endif
@@ -47,6 +47,15 @@ void Grid::save (std::string dirout) {
     write_array(dirout + "/gefac", gefac);
 }
 
+void Grid::save (Store &store) {
+    store.append("zc", zc);
+    store.append("ze", ze);
+    store.append("delz", delz);
+    store.append("delze", delze);
+    store.append("vefac", vefac);
+    store.append("gefac", gefac);
+}
+
 void Grid::grid_edges(double depth, double delz0, double delzfrac,
                       double delzmax, std::vector<double> &ze) {
 
@@ -9,6 +9,7 @@
 #include <cstdio>
 
 #include "io.h"
+#include "store.h"
 
 //!class for constructing and containing grid information
 /*!
@@ -27,25 +28,28 @@ public:
     Grid (double depth, double delz0, double delzfrac, double delzmax);
 
     //!gets number of cells
-    long get_n () { return(n); }
+    long get_n () const { return(n); }
     //!gets length/depth of the domain (m)
-    double get_dep () { return(dep); }
+    double get_dep () const { return(dep); }
     //!gets vector of cell edge coordinates (m)
-    const std::vector<double> get_ze () const { return(ze); }
+    const std::vector<double> &get_ze () const { return(ze); }
     //!gets arravectory of cell center coordinates (m)
-    const std::vector<double> get_zc () const { return(zc); }
+    const std::vector<double> &get_zc () const { return(zc); }
     //!gets arrayvector of  cell width (m)
-    const std::vector<double> get_delz () const { return(delz); }
+    const std::vector<double> &get_delz () const { return(delz); }
     //!gets arrayvector of  cell widths used for stability calculations (m)
-    const std::vector<double> get_delze () const { return(delze); }
+    const std::vector<double> &get_delze () const { return(delze); }
     //!gets arrayvector of factors for cell edge values
-    const std::vector<double> get_vefac () const { return(vefac); }
+    const std::vector<double> &get_vefac () const { return(vefac); }
     //!gets arrayvector of factors for cell edge gradients
-    const std::vector<double> get_gefac () const { return(gefac); }
+    const std::vector<double> &get_gefac () const { return(gefac); }
 
     //!writes grid arrays into a directory as binary files
     void save (std::string dirout);
 
+    //!writes grid arrays into a store
+    void save (Store &store);
+
 private:
 
     //!number of cells
@@ -50,7 +50,7 @@ void check_file_write (const char *fn);
 \param[in] size length of array
 */
 template <class T>
-void write_array (const char *fn, T *a, long size) {
+void write_array (const char *fn, const T *a, long size) {
     FILE* ofile;
     check_file_write(fn);
     ofile = fopen(fn, "wb");
@@ -65,7 +65,7 @@ void write_array (const char *fn, T *a, long size) {
 \param[in] size length of array
 */
 template <class T>
-void write_array (const std::string &fn, T *a, long size) {
+void write_array (const std::string &fn, const T *a, long size) {
     write_array(fn.c_str(), a, size);
 }
 
@@ -75,7 +75,7 @@ void write_array (const std::string &fn, T *a, long size) {
 \param[in] a vector of numbers to write
 */
 template <class T>
-void write_array (const char *fn, std::vector<T> a) {
+void write_array (const char *fn, const std::vector<T> &a) {
     write_array(fn, a.data(), long(a.size()));
 }
 
@@ -85,7 +85,7 @@ void write_array (const char *fn, std::vector<T> a) {
 \param[in] a vector of numbers to write
 */
 template <class T>
-void write_array (const std::string &fn, std::vector<T> a) {
+void write_array (const std::string &fn, const std::vector<T> &a) {
     write_array(fn.c_str(), a.data(), long(a.size()));
 }
 
@@ -8,6 +8,7 @@
 #include "grid.h"
 #include "settings.h"
 #include "richards.h"
+#include "profile.h"
 
 //! driver function compiled into `richards.exe`
 int main (int argc, char **argv) {
@@ -29,16 +30,47 @@ int main (int argc, char **argv) {
     printf("  %g meter grid created with %li cells\n", grid.get_dep(), grid.get_n());
     printf("    surface cell depth: %g cm\n", grid.get_delze()[n-1]*100);
     printf("    bottom cell depth: %g cm\n", grid.get_delze()[0]*100);
-    if ( stg.save_grid )
-        grid.save(dirout);
+    //single output file, if requested
+    Store *store = stg.store ? new Store(dirout + "/output.store") : NULL;
+    if ( stg.save_grid ) {
+        if ( store ) {
+            grid.save(*store);
+        } else {
+            grid.save(dirout);
+        }
+    }
 
-    //create system
-    Richards rich(grid, stg);
+    //create system, which throws if its forcing series can't be read
+    Richards *rich = NULL;
+    try {
+        rich = new Richards(grid, stg);
+    } catch ( std::exception &e ) {
+        print_exit(e.what());
+    }
+    if ( store )
+        rich->set_store(store);
 
     //integrate
     double tint = stg.tint*stg.tunit;
-    rich.solve_adaptive(tint, tint/1e9, stg.nsnap, dirout.c_str());
+    try {
+        rich->solve_adaptive(tint, tint/1e9, stg.nsnap, dirout.c_str());
+    } catch ( Abandoned &e ) {
+        printf("  %s\n", e.what());
+        delete rich;
+        delete store;
+        return(EXIT_FAILURE);
+    } catch ( std::exception &e ) {
+        //a malformed record further into the forcing series
+        print_exit(e.what());
+    }
+    printf("  %lu steps\n", rich->get_nstep());
+    rich->print_limits();
     printf("  done\n");
+    //only written if profiling is compiled in
+    profile_report(dirout + "/profile.json");
+
+    delete rich;
+    delete store;
 
     return(0);
 }
@@ -0,0 +1,223 @@
+//! \file main_bench.cc
+
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include "io.h"
+#include "grid.h"
+#include "settings.h"
+#include "checkpoint.h"
+#include "richards.h"
+
+//!keeps the compiler from discarding benchmarked work
+volatile double sink;
+
+//!one timed kernel on one grid and saturation regime
+struct BenchResult {
+    //!kernel name
+    std::string kernel;
+    //!grid depth (m)
+    double depth;
+    //!number of cells
+    long n;
+    //!saturation regime
+    std::string regime;
+    //!fastest time per call (ns)
+    double ns;
+    //!number of edges or cells handled per call
+    long m;
+    //!nominal bytes streamed per call
+    double bytes;
+};
+
+//!times a kernel, calibrating the number of calls to about 20 ms and keeping the fastest of five repetitions
+/*!
+\param[in] f kernel
+\return time per call (ns)
+*/
+template <class F>
+double time_kernel (F f) {
+
+    unsigned long m = 1, k;
+    double t;
+    //calibrate, which also warms the caches
+    while ( true ) {
+        t = wall_time();
+        for (k=0; k<m; k++) f();
+        t = wall_time() - t;
+        if ( t > 0.02 )
+            break;
+        m *= 2;
+    }
+    double best = t;
+    for (int r=0; r<5; r++) {
+        t = wall_time();
+        for (k=0; k<m; k++) f();
+        t = wall_time() - t;
+        if ( t < best )
+            best = t;
+    }
+    return( 1e9*best/m );
+}
+
+//! driver function compiled into `richards_bench.exe`
+int main (int argc, char **argv) {
+
+    if ( (argc != 2) && (argc != 3) )
+        print_exit("the benchmarks must be given one or two command line arguments\n  1. path to settings file\n  2. (optional) path to a csv file of results");
+
+    //depths of the benchmarked grids (m)
+    std::vector<double> depths = {1, 5, 10, 50};
+    //saturation regimes, as fractions of porosity
+    std::vector<std::string> regimes = {"dry", "mid", "wet"};
+    std::vector<double> fracs = {0, 0.5, 0.98};
+
+    //read settings, with all output off so only the kernels are timed
+    Settings stg = parse_settings(read_values(argv[1]));
+    disable_output(stg);
+    //kernels are called outside of any integration, so there's nothing to watch
+    stg.watchdog = false;
+
+    std::vector<BenchResult> res;
+    BenchResult r;
+    for (unsigned long g=0; g<depths.size(); g++) {
+        Grid grid(depths[g], stg.delz0, stg.delzfrac, stg.delzmax);
+        Richards rich(grid, stg);
+        rich.set_quiet(true);
+        long n = rich.n;
+        std::vector<double> fout(rich.get_neq());
+        std::vector<float> row(2*n + 8);
+        //plain arrays for the isolated property and flux kernels
+        std::vector<double> a(n+1), sat(n);
+
+        for (unsigned long k=0; k<regimes.size(); k++) {
+            //the dry regime sits just above the wilting point, where fluxes still move
+            double frac = (k == 0) ? stg.wilt + 0.05 : fracs[k];
+            double *w = rich.get_sol();
+            for (long i=0; i<n; i++) w[i] = frac*rich.poroc[i];
+            //fill the column, so every kernel sees this regime's properties
+            rich.update_q(w, 0.0);
+            for (long i=0; i<n; i++) sat[i] = w[i]/rich.poroc[i];
+            const Column<double> &c = rich.col;
+
+            r.depth = depths[g];
+            r.n = n;
+            r.regime = regimes[k];
+            //bytes are counted as the arrays of doubles each edge streams through, read or written
+            r.kernel = "f_K";
+            r.m = n + 1;
+            r.bytes = 4*8.0*r.m;
+            r.ns = time_kernel([&] () {
+                for (long i=0; i<n+1; i++) a[i] = rich.f_K(c.we[i], c.Ksat[i], c.poroe[i], c.b);
+                sink = a[n];
+            });
+            res.push_back(r);
+
+            r.kernel = "f_dpsidw";
+            r.ns = time_kernel([&] () {
+                for (long i=0; i<n+1; i++) a[i] = rich.f_dpsidw(c.we[i], c.psisat[i], c.poroe[i], c.b);
+                sink = a[n];
+            });
+            res.push_back(r);
+
+            r.kernel = "f_q";
+            r.m = n - 1;
+            r.bytes = 5*8.0*r.m;
+            r.ns = time_kernel([&] () {
+                for (long i=1; i<n; i++) a[i] = rich.f_q(c.K[i], c.dpsidw[i], c.dwdz[i], sat[i-1], sat[i], c.wilt);
+                sink = a[n-1];
+            });
+            res.push_back(r);
+
+            r.kernel = "update_q";
+            r.m = n + 1;
+            r.bytes = 13*8.0*r.m;
+            r.ns = time_kernel([&] () {
+                rich.update_q(w, 0.0);
+                sink = rich.q[n];
+            });
+            res.push_back(r);
+
+            r.kernel = "ode_fun";
+            r.m = n;
+            r.bytes = 15*8.0*r.m;
+            r.ns = time_kernel([&] () {
+                rich.ode_fun(w, fout.data());
+                sink = fout[0];
+            });
+            res.push_back(r);
+
+            r.kernel = "dt_adapt";
+            r.m = n + 1;
+            r.bytes = 2*8.0*r.m;
+            r.ns = time_kernel([&] () {
+                sink = rich.dt_adapt();
+            });
+            res.push_back(r);
+
+            //a tracker row of every flux and water fraction, as recorded after each step
+            rich.jt = 0;
+            rich.jqtop = 1;
+            rich.jqmid = 2;
+            rich.jqbot = 3;
+            rich.jinfil = 4;
+            rich.jlimit = 5;
+            rich.jqall = 6;
+            rich.jwall = n + 7;
+            r.kernel = "tracker_row";
+            r.m = n + 1;
+            r.bytes = 13*8.0*r.m + 2*(8.0 + 4.0)*r.m;
+            r.ns = time_kernel([&] () {
+                rich.fill_row(row.data(), 0.0, w, rich.csamp);
+                sink = row[n];
+            });
+            res.push_back(r);
+            rich.jt = rich.jqtop = rich.jqmid = rich.jqbot = rich.jinfil = rich.jlimit = rich.jqall = rich.jwall = -1;
+        }
+    }
+
+    //one spinup period of the settings' own grid, from the initial condition
+    {
+        Grid grid(stg.depth, stg.delz0, stg.delzfrac, stg.delzmax);
+        Richards rich(grid, stg);
+        rich.set_quiet(true);
+        double t = wall_time();
+        rich.solve_adaptive(stg.infper, stg.infper/1e12, false);
+        t = wall_time() - t;
+        r.kernel = "spinup_period";
+        r.depth = stg.depth;
+        r.n = rich.n;
+        r.regime = "initial";
+        r.ns = 1e9*t;
+        r.m = rich.get_nstep();
+        r.bytes = 0;
+        res.push_back(r);
+    }
+
+    //table, with rates per edge or cell and per step for the spinup period
+    printf("  %-14s | %6s | %5s | %-7s | %12s | %10s | %8s\n",
+        "kernel", "depth", "n", "regime", "ns/call", "ns/item", "GB/s");
+    printf("  ---------------|--------|-------|---------|--------------|------------|---------\n");
+    for (unsigned long j=0; j<res.size(); j++) {
+        const BenchResult &b = res[j];
+        printf("  %-14s | %6g | %5li | %-7s | %12.1f | %10.3f | %8.2f\n",
+            b.kernel.c_str(), b.depth, b.n, b.regime.c_str(), b.ns, b.ns/b.m, b.bytes/b.ns);
+    }
+
+    //machine readable results
+    if ( argc == 3 ) {
+        check_file_write(argv[2]);
+        FILE *ofile = fopen(argv[2], "w");
+        fprintf(ofile, "kernel,depth,n,regime,ns_per_call,items_per_call,ns_per_item,gb_per_s\n");
+        for (unsigned long j=0; j<res.size(); j++) {
+            const BenchResult &b = res[j];
+            fprintf(ofile, "%s,%g,%li,%s,%.6g,%li,%.6g,%.6g\n",
+                b.kernel.c_str(), b.depth, b.n, b.regime.c_str(), b.ns, b.m, b.ns/b.m, b.bytes/b.ns);
+        }
+        fclose(ofile);
+        printf("results written to: %s\n", argv[2]);
+    }
+
+    return(0);
+}
@@ -0,0 +1,41 @@
+//! \file main_coupler.cc
+
+#include <string>
+#include <cstdio>
+#include <cstdlib>
+
+#include "io.h"
+#include "richards_api.h"
+
+//! driver function compiled into `richards_coupler.exe`
+int main (int argc, char **argv) {
+
+    if ( (argc != 3) && (argc != 4) )
+        print_exit("the coupler must be given two or three command line arguments\n  1. path to settings file\n  2. shared-memory name, like /richards0\n  3. (optional) relative tolerance for a spinup before serving, or 0 to skip it");
+
+    //model, with all output off
+    richards_model *m = richards_create(argv[1], NULL, NULL, 0);
+    if ( m == NULL )
+        print_exit(richards_error());
+    //spin up under the periodic schedule before the host takes over the forcing
+    double rtol = (argc == 4) ? std::atof(argv[3]) : 0.0;
+    if ( (rtol > 0) && (richards_spinup(m, rtol) != 0) )
+        print_exit(richards_error());
+
+    //segment for the host to attach to
+    richards_shm *s = richards_shm_create(argv[2], richards_ncell(m));
+    if ( s == NULL )
+        print_exit(richards_error());
+    printf("serving %li cells through %s\n", richards_ncell(m), argv[2]);
+    fflush(stdout);
+
+    int status = richards_shm_serve(m, s);
+    if ( status != 0 )
+        printf("FAILURE: %s\n", richards_error());
+    printf("stopped at t = %g s\n", richards_time(m));
+
+    richards_shm_close(s);
+    richards_destroy(m);
+
+    return( status == 0 ? 0 : EXIT_FAILURE );
+}
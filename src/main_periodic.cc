@@ -8,6 +8,7 @@
 #include "grid.h"
 #include "settings.h"
 #include "richards.h"
+#include "profile.h"
 
 //! driver function compiled into `richards_periodic.exe`
 int main (int argc, char **argv) {
@@ -22,6 +23,8 @@ int main (int argc, char **argv) {
 
     //read settings
     Settings stg = parse_settings(read_values(argv[1]));
+    if ( stg.forcing != "none" )
+        print_exit("the periodic program spins up with the periodic forcing, so it can't use a forcing series");
 
     //create grid
     Grid grid(stg.depth, stg.delz0, stg.delzfrac, stg.delzmax);
@@ -29,21 +32,70 @@ int main (int argc, char **argv) {
     printf("  %g meter grid created with %li cells\n", grid.get_dep(), grid.get_n());
     printf("    surface cell depth: %g cm\n", grid.get_delze()[n-1]*100);
     printf("    bottom cell depth: %g cm\n", grid.get_delze()[0]*100);
-    if ( stg.save_grid )
-        grid.save(dirout);
+    //a checkpoint left by a terminated run is continued
+    std::string fnckpt = dirout + "/richards.ckpt";
+    bool restart = stg.checkpoint && file_exists(fnckpt);
+    if ( stg.checkpoint )
+        install_checkpoint_handler();
+    //single output file, if requested
+    Store *store = stg.store ? new Store(dirout + "/output.store", restart) : NULL;
+    if ( stg.save_grid && !restart ) {
+        if ( store ) {
+            grid.save(*store);
+        } else {
+            grid.save(dirout);
+        }
+    }
 
     //create system
     Richards rich(grid, stg);
+    if ( store )
+        rich.set_store(store);
+    if ( stg.checkpoint ) {
+        if ( restart ) {
+            rich.load_checkpoint(fnckpt);
+            printf("  restarting from checkpoint @ t = %g\n", rich.get_t());
+        }
+        rich.set_checkpoint(fnckpt, stg.ckptint);
+    }
 
     //integrate
-    printf("  spinning up...\n");
-    rich.spinup(1e-6, false);
-    printf("  spinup finished @ t = %g, doing short integration\n", rich.get_t());
     long unsigned nstep = rich.get_nstep();
-    rich.solve_adaptive(2*stg.infper, stg.infper/1e12, stg.nsnap, dirout.c_str());
+    try {
+        if ( !rich.is_solving() ) {
+            printf("  spinning up...\n");
+            rich.spinup(1e-6, false);
+            printf("  spinup finished @ t = %g, doing short integration\n", rich.get_t());
+            nstep = rich.get_nstep();
+        }
+        rich.solve(2*stg.infper, stg.infper/1e12, stg.nsnap, dirout);
+    } catch ( Terminated & ) {
+        printf("  terminated @ t = %g, checkpoint written to %s\n", rich.get_t(), fnckpt.c_str());
+        delete store;
+        return(EXIT_FAILURE);
+    } catch ( Abandoned &e ) {
+        printf("  %s\n", e.what());
+        delete store;
+        return(EXIT_FAILURE);
+    }
+    if ( stg.checkpoint )
+        remove(fnckpt.c_str());
     printf("  %lu short integration steps\n", rich.get_nstep() - nstep);
+    //fluxes reduced during the short integration
+    const Metrics &met = rich.get_metrics();
+    double dur = met.t1 - met.t0;
+    printf("  mean bottom flux: %g m/s\n", met.qint[0]/dur);
+    printf("  mean top flux: %g m/s\n", met.qint[1]/dur);
+    for (unsigned long j=0; j<stg.probes.size(); j++)
+        printf("  mean flux at %g m: %g m/s\n", stg.probes[j], met.qint[j+2]/dur);
+    printf("  storage change: %g m, balance error: %g m\n", met.dstor, met.balance);
     printf("  %lu total steps\n", rich.get_nstep());
+    rich.print_limits();
     printf("  done\n");
+    //only written if profiling is compiled in
+    profile_report(dirout + "/profile.json");
+
+    delete store;
 
     return(0);
 }
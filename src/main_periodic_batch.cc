@@ -1,7 +1,9 @@
 //! \file main_periodic_batch.cc
 
+#include <cmath>
 #include <string>
 #include <vector>
+#include <algorithm>
 #include <iostream>
 
 #include "omp.h"
@@ -10,6 +12,106 @@
 #include "grid.h"
 #include "settings.h"
 #include "richards.h"
+#include "rom.h"
+#include "pipeline.h"
+#include "telemetry.h"
+#include "profile.h"
+
+//!sets the swept parameters of a trial
+/*!
+\param[in,out] s settings of the trial
+\param[in] p row of the parameter table
+*/
+void set_params (Settings &s, const double *p) {
+    s.poro = p[0];
+    s.perm = p[1];
+    s.b = p[2];
+    s.wilt = p[3];
+    s.tauevap = p[4];
+    s.Levap = p[5];
+    s.infper = p[6];
+    s.infdur = p[7];
+}
+
+//!runs trials sampled from the sweep at 1, 2, 4, ... threads, writing throughput and load balance into scaling.csv
+/*!
+Every thread count integrates the same trials, spun up and reduced over one period as in metrics-only mode. Busy time is the time a thread spends integrating trials, and tail time is how long it waits at the end for the last trials on other threads. If trials themselves slow down as threads are added, the threads are contending for something shared, like memory bandwidth or cache.
+\param[in] grid grid of the sweep
+\param[in] stg settings of the sweep, with output disabled
+\param[in] param parameter table
+\param[in] nparam number of trials in the sweep
+\param[in] dirout output directory
+*/
+void scaling (Grid &grid, Settings &stg, double **param, unsigned long nparam, const std::string &dirout) {
+
+    //trials spread evenly over the sweep
+    unsigned long m = std::min((unsigned long)stg.scaling, nparam), i;
+    std::vector<unsigned long> trials(m);
+    for (i=0; i<m; i++) trials[i] = (i*nparam)/m;
+    //thread counts doubling up to the maximum, which is always included
+    int pmax = omp_get_max_threads();
+    std::vector<int> nthr;
+    for (int p=1; p<pmax; p*=2) nthr.push_back(p);
+    nthr.push_back(pmax);
+
+    std::string fn = dirout + "/scaling.csv";
+    check_file_write(fn.c_str());
+    FILE *ofile = fopen(fn.c_str(), "w");
+    fprintf(ofile, "threads,trials,wall,throughput,speedup,efficiency,trial_mean,trial_slowdown,busy_mean,busy_min,busy_max,tail_mean,tail_max\n");
+
+    printf("measuring thread scaling with %lu trials sampled from the sweep\n", m);
+    printf("   threads | trials/s | speedup | efficiency | trial slowdown | busy min/max (s) | tail mean/max (s)\n");
+    printf("  -------- | -------- | ------- | ---------- | -------------- | ---------------- | -----------------\n");
+    double wall1 = 0.0, trial1 = 0.0;
+    for (unsigned long k=0; k<nthr.size(); k++) {
+        int p = nthr[k];
+        std::vector<double> busy(p, 0.0), last(p, 0.0), ttrial(m);
+        double t0 = wall_time();
+        #pragma omp parallel for schedule(dynamic) num_threads(p)
+        for (unsigned long i=0; i<m; i++) {
+            double ts = wall_time();
+            Settings s = copy_settings(stg);
+            set_params(s, param[trials[i]]);
+            Richards rich(grid, s);
+            rich.set_quiet(true);
+            //an abandoned trial still spent its budget on the thread
+            try {
+                rich.spinup(1e-6, true);
+                rich.solve(s.infper, s.infper/1e12);
+            } catch ( Abandoned & ) {}
+            double te = wall_time();
+            int tid = omp_get_thread_num();
+            busy[tid] += te - ts;
+            last[tid] = te;
+            ttrial[i] = te - ts;
+        }
+        double t1 = wall_time(), wall = t1 - t0;
+
+        //trial times, and each thread's busy time and wait for the others at the end
+        double trial = 0.0, bmean = 0.0, bmin = INFINITY, bmax = 0.0, tmean = 0.0, tmax = 0.0, tail;
+        for (i=0; i<m; i++) trial += ttrial[i]/m;
+        for (int j=0; j<p; j++) {
+            bmean += busy[j]/p;
+            bmin = std::min(bmin, busy[j]);
+            bmax = std::max(bmax, busy[j]);
+            tail = (last[j] > 0) ? t1 - last[j] : wall;
+            tmean += tail/p;
+            tmax = std::max(tmax, tail);
+        }
+        if ( k == 0 ) {
+            wall1 = wall;
+            trial1 = trial;
+        }
+        double speedup = wall1/wall;
+        printf("  %8d | %8.3f | %7.2f | %10.3f | %14.3f | %7.2f /%7.2f | %7.2f /%7.2f\n",
+            p, m/wall, speedup, speedup/p, trial/trial1, bmin, bmax, tmean, tmax);
+        fprintf(ofile, "%d,%lu,%.6g,%.6g,%.6g,%.6g,%.6g,%.6g,%.6g,%.6g,%.6g,%.6g,%.6g\n",
+            p, m, wall, m/wall, speedup, speedup/p, trial, trial/trial1, bmean, bmin, bmax, tmean, tmax);
+        fflush(ofile);
+    }
+    fclose(ofile);
+    printf("scaling table written to: %s\n", fn.c_str());
+}
 
 //! driver function compiled into `richards_periodic_batch.exe`
 int main (int argc, char **argv) {
@@ -43,6 +145,16 @@ int main (int argc, char **argv) {
     Settings stg = parse_settings(read_values(argv[1]));
     //set the depth
     stg.depth = std::atof(argv[2]);
+    //trials run in parallel and sweep the periodic forcing
+    sweep_settings(stg);
+    //only the table of metrics is written in metrics-only mode, and only timings when measuring scaling
+    if ( stg.metrics_only || (stg.scaling > 0) ) {
+        disable_output(stg);
+        stg.store = false;
+        stg.nwriter = 0;
+    }
+    if ( stg.scaling > 0 )
+        stg.checkpoint = false;
 
     //create grid
     Grid grid(stg.depth, stg.delz0, stg.delzfrac, stg.delzmax);
@@ -50,8 +162,27 @@ int main (int argc, char **argv) {
     printf("  %g meter grid created with %li cells\n", grid.get_dep(), grid.get_n());
     printf("    surface cell depth: %g cm\n", grid.get_delze()[n-1]*100);
     printf("    bottom cell depth: %g cm\n", grid.get_delze()[0]*100);
-    if ( stg.save_grid )
-        grid.save(dirout);
+    //a log of finished trials and checkpoints of unfinished ones let a terminated sweep be restarted
+    TrialLog *log = NULL;
+    if ( stg.checkpoint ) {
+        install_checkpoint_handler();
+        log = new TrialLog(dirout + "/trials.log", hash_settings(stg));
+        if ( log->restarted() )
+            printf("  restarting sweep, %lu trials already finished\n", log->get_ndone());
+        //trials share a store file only through the writers, which append whole trials
+        if ( stg.store && (stg.nwriter < 1) )
+            stg.nwriter = 1;
+    }
+    bool restart = log && log->restarted();
+    //single output file, if requested
+    Store *store = stg.store ? new Store(dirout + "/output.store", restart) : NULL;
+    if ( stg.save_grid && !restart ) {
+        if ( store ) {
+            grid.save(*store);
+        } else {
+            grid.save(dirout);
+        }
+    }
 
     //create parameter table
     nparam = (poro.size()*perm.size()*b.size()
@@ -107,35 +238,226 @@ int main (int argc, char **argv) {
     fclose(ofile);
     printf("parameter table written to: %s\n", fn.c_str());
 
+    //measure thread scaling on a sample of the sweep instead of running it
+    if ( stg.scaling > 0 ) {
+        scaling(grid, stg, param, nparam, dirout);
+        for (i=0; i<nparam; i++) delete [] param[i];
+        delete [] param;
+        return(0);
+    }
+
+    //train a reduced-order model on a full-order spinup with the base settings
+    Pod pod(n);
+    if ( stg.rom ) {
+        printf("  training reduced-order model...\n");
+        Richards ref(grid, stg);
+        pod.train(ref, 1e-6, 100);
+        pod.build(stg.romtol, n);
+        printf("  %li modes and %li DEIM points from %li snapshots\n",
+            pod.r, pod.p, pod.get_nsnap());
+    }
+
+    //progress of the sweep, written periodically instead of a line per trial
+    Telemetry *tel = NULL;
+    if ( stg.status > 0 ) {
+        //trials are expected to cost about the same as others with their infiltration period
+        std::vector<long> cls(nparam);
+        for (i=0; i<nparam; i++)
+            cls[i] = long(std::find(infper.begin(), infper.end(), param[i][6]) - infper.begin());
+        tel = new Telemetry(dirout + "/status.json", cls, omp_get_max_threads(), stg.status);
+        if ( log )
+            for (i=0; i<nparam; i++)
+                if ( log->is_done(i) )
+                    tel->skip(i);
+    }
+
+    //writer threads, so integrating threads never wait on the filesystem
+    Pipeline *pipe = NULL;
+    if ( stg.nwriter > 0 )
+        pipe = new Pipeline(dirout, store, stg.nwriter, 4*omp_get_max_threads(), log, tel != NULL);
+
+    //rows of the metrics table, filled in by trial and led by the trial's status, or only the
+    //reason a trial failed without metrics
+    std::vector<std::string> rows(nparam);
+    //metrics of failed trials
+    std::string nanrow;
+    std::string mhead = Richards::metrics_header(stg);
+    for (long k=0; k<=std::count(mhead.begin(), mhead.end(), ','); k++)
+        nanrow += ",nan";
+
+    //a settings copy and a solver for each thread, reused by all the thread's trials on one shared grid
+    std::shared_ptr<const Grid> geom = std::make_shared<const Grid>(grid);
+    std::vector<Settings> tstg(omp_get_max_threads(), stg);
+    std::vector< std::unique_ptr<Richards> > solvers(omp_get_max_threads());
+
     printf("beginning parallel integrations of %lu trials with %d threads\n",
         nparam, omp_get_max_threads());
-    printf("     trial    |    nstep\n");
-    printf("  ----------- | -----------\n");
+    if ( tel ) {
+        printf("  progress written every %g s to: %s/status.json\n", stg.status, dirout.c_str());
+    } else {
+        printf("     trial    |    nstep\n");
+        printf("  ----------- | -----------\n");
+    }
     #pragma omp parallel for schedule(dynamic)
     for (long unsigned i=0; i<nparam; i++) {
-        //copy settings
-        Settings s = copy_settings(stg);
-        //edit params
-        s.poro = param[i][0];
-        s.perm = param[i][1];
-        s.b = param[i][2];
-        s.wilt = param[i][3];
-        s.tauevap = param[i][4];
-        s.Levap = param[i][5];
-        s.infper = param[i][6];
-        s.infdur = param[i][7];
-        //create a solver
-        Richards rich(grid, s);
+        //skip finished trials, and everything once terminated
+        if ( log && log->is_done(i) ) {
+            rows[i] = log->get_row(i);
+            continue;
+        }
+        if ( terminate_requested() ) {
+            if ( pipe )
+                pipe->skip(i);
+            continue;
+        }
+        //don't run too far ahead of the next trial to be appended to the store
+        if ( pipe )
+            pipe->admit(i);
+        //edit the thread's settings, every swept parameter is set for each trial
+        int tid = omp_get_thread_num();
+        Settings &s = tstg[tid];
+        set_params(s, param[i]);
+        //capture output in memory for the writers
+        Store *out = pipe ? new Store() : NULL;
+        //reset the thread's solver, or create it for the thread's first trial
+        if ( solvers[tid] ) {
+            solvers[tid]->reset(s);
+        } else {
+            solvers[tid].reset(new Richards(geom, s));
+        }
+        Richards &rich = *solvers[tid];
         rich.set_quiet(true);
         rich.set_name(int_to_string(i));
-        //integrate
-        //rich.spinup(1e-6, true);
-        //rich.solve_adaptive(2*s.infper, s.infper/1e12, s.nsnap, dirout.c_str());
-        printf("  %11lu | %11lu\n", i, rich.get_nstep());
+        if ( tel )
+            rich.set_progress(tel->start(i, tid));
+        if ( out ) {
+            rich.set_store(out);
+        } else if ( store ) {
+            rich.set_store(store);
+        }
+        //continue from a checkpoint, if there is one
+        std::string fnckpt = dirout + "/" + int_to_string(i) + ".ckpt";
+        bool resumed = false;
+        if ( log ) {
+            resumed = rich.load_checkpoint(fnckpt);
+            rich.set_checkpoint(fnckpt, stg.ckptint);
+        }
+        try {
+            //integrate
+            bool spun = false;
+            if ( stg.rom && !resumed ) {
+                RichardsRom rom(rich, pod, stg.romerr);
+                if ( rom.spinup(1e-6) ) {
+                    //correct the lifted state with a few full-order periods, to the full model's tolerance
+                    rich.spinup(1e-6, true, ROM_NCORRECT);
+                } else {
+                    rich.spinup(1e-6, true);
+                }
+                spun = true;
+            } else if ( rich.is_spinning() ) {
+                rich.spinup(1e-6, true);
+                spun = true;
+            }
+            if ( !spun && !rich.is_solving() )
+                rich.spinup(1e-6, true);
+            if ( stg.metrics_only ) {
+                //reduce a single cycle in process, without writing anything else
+                rich.solve(s.infper, s.infper/1e12);
+                rows[i] = "ok," + rich.metrics_row();
+            } else {
+                //two cycles, writing the trial's trackers and snaps
+                rich.solve(2*s.infper, s.infper/1e12, s.nsnap, dirout);
+            }
+        } catch ( Terminated & ) {
+            //the checkpoint is written, so drop the trial's output
+            if ( tel )
+                tel->finish(i, tid, false);
+            if ( pipe )
+                pipe->skip(i);
+            delete out;
+            continue;
+        } catch ( Abandoned &e ) {
+            //drop the trial's output and record why, so a restarted sweep doesn't try it again
+            printf("  trial %lu %s\n", i, e.what());
+            if ( tel )
+                tel->finish(i, tid);
+            if ( pipe )
+                pipe->skip(i);
+            delete out;
+            rows[i] = failure_name(e.reason);
+            if ( stg.metrics_only )
+                rows[i] += nanrow;
+            if ( log ) {
+                remove(fnckpt.c_str());
+                log->add(i, rows[i]);
+            }
+            continue;
+        }
+        if ( tel )
+            tel->finish(i, tid);
+        if ( log )
+            remove(fnckpt.c_str());
+        if ( pipe ) {
+            pipe->push(i, rich.get_nstep(), out);
+        } else {
+            if ( !tel )
+                printf("  %11lu | %11lu\n", i, rich.get_nstep());
+            if ( log )
+                log->add(i, rows[i]);
+        }
+    }
+    delete pipe;
+    if ( tel ) {
+        tel->summary();
+        delete tel;
+    }
+
+    //a terminated sweep is continued by running it again
+    if ( terminate_requested() ) {
+        printf("terminated, checkpoints written to: %s\n", dirout.c_str());
+        for (i=0; i<nparam; i++) delete [] param[i];
+        delete [] param;
+        delete store;
+        delete log;
+        return(EXIT_FAILURE);
     }
 
+    //trials abandoned by the watchdog, and why
+    count = 0;
+    for (i=0; i<nparam; i++)
+        if ( !rows[i].empty() && (rows[i].compare(0, 3, "ok,") != 0) )
+            count++;
+    if ( count > 0 ) {
+        fn = dirout + "/failures.csv";
+        check_file_write(fn.c_str());
+        ofile = fopen(fn.c_str(), "w");
+        fprintf(ofile, "trial,reason\n");
+        for (i=0; i<nparam; i++)
+            if ( !rows[i].empty() && (rows[i].compare(0, 3, "ok,") != 0) )
+                fprintf(ofile, "%lu,%s\n", i, rows[i].substr(0, rows[i].find(',')).c_str());
+        fclose(ofile);
+        printf("%lu trials abandoned, listed in: %s\n", count, fn.c_str());
+    }
+
+    //metrics table, in order of trial number
+    if ( stg.metrics_only ) {
+        fn = dirout + "/metrics.csv";
+        check_file_write(fn.c_str());
+        ofile = fopen(fn.c_str(), "w");
+        fprintf(ofile, "trial,status,%s\n", mhead.c_str());
+        for (i=0; i<nparam; i++)
+            fprintf(ofile, "%lu,%s\n", i, rows[i].c_str());
+        fclose(ofile);
+        printf("metrics table written to: %s\n", fn.c_str());
+    }
+
+    //only written if profiling is compiled in
+    profile_report(dirout + "/profile.json");
+
     for (i=0; i<nparam; i++) delete [] param[i];
     delete [] param;
+    delete store;
+    delete log;
 
     return(0);
 }
@@ -0,0 +1,115 @@
+//! \file main_reduce.cc
+
+#include <cmath>
+#include <string>
+#include <vector>
+#include <fstream>
+
+#include "omp.h"
+
+#include "io.h"
+#include "reader.h"
+#include "checkpoint.h"
+
+//!time average of a tracked flux, by the trapezoid rule over its output times
+/*!
+\param[in] q flux values
+\param[in] t output times
+\param[in] m number of values
+\return integral of the flux divided by the time spanned, or NaN if there aren't two values
+*/
+double time_mean (const float *q, const float *t, unsigned long m) {
+
+    if ( m < 2 )
+        return(NAN);
+    double s = 0.0, tmin = t[0], tmax = t[0];
+    for (unsigned long i=1; i<m; i++) {
+        s += 0.5*(double(q[i-1]) + double(q[i]))*(double(t[i]) - double(t[i-1]));
+        if ( t[i] < tmin ) tmin = t[i];
+        if ( t[i] > tmax ) tmax = t[i];
+    }
+    return( s/(tmax - tmin) );
+}
+
+//! driver function compiled into `richards_reduce.exe`
+int main (int argc, char **argv) {
+
+    if ( argc < 3 )
+        print_exit("the reducer must be given at least two command line arguments\n  1. path to batch output directory\n  2. path to output table\n  3. (optional) names of tracked fluxes to average, qbot by default");
+
+    //batch directory and output table
+    std::string batdir = argv[1];
+    std::string fnout = argv[2];
+    //tracked fluxes to average over time
+    std::vector<std::string> vars;
+    for (int k=3; k<argc; k++)
+        vars.push_back(argv[k]);
+    if ( vars.empty() )
+        vars.push_back("qbot");
+    unsigned long nvar = vars.size();
+
+    //trials table, whose rows are extended with the reductions
+    std::string fn = batdir + "/trials.csv";
+    check_file_read(fn.c_str());
+    std::ifstream ifile(fn.c_str());
+    std::string header, line;
+    std::getline(ifile, header);
+    std::vector<std::string> rows;
+    std::vector<unsigned long> trials;
+    while ( std::getline(ifile, line) ) {
+        if ( line.empty() )
+            continue;
+        rows.push_back(line);
+        trials.push_back(std::strtoul(line.c_str(), NULL, 10));
+    }
+    unsigned long ntrial = rows.size();
+
+    //a sweep's store is mapped once and shared by all threads
+    StoreReader *store = NULL;
+    if ( file_exists(batdir + "/output.store") )
+        store = new StoreReader(batdir + "/output.store");
+
+    printf("reducing %lu trials of %s with %d threads\n", ntrial, batdir.c_str(), omp_get_max_threads());
+
+    //reductions of each trial, NaN where outputs are missing
+    std::vector<double> res(ntrial*nvar, NAN);
+    unsigned long nmissing = 0;
+    #pragma omp parallel for schedule(dynamic) reduction(+:nmissing)
+    for (unsigned long i=0; i<ntrial; i++) {
+        std::string prefix = int_to_string(trials[i]) + "_";
+        Series t, q;
+        if ( !read_output(batdir, store, prefix + "t", t) ) {
+            nmissing++;
+            continue;
+        }
+        for (unsigned long k=0; k<nvar; k++) {
+            if ( !read_output(batdir, store, prefix + vars[k], q) || (q.m != t.m) ) {
+                nmissing++;
+                continue;
+            }
+            res[i*nvar + k] = time_mean(q.x, t.x, t.m);
+        }
+    }
+    if ( nmissing > 0 )
+        printf("  %lu outputs were missing or incomplete, their reductions are NaN\n", nmissing);
+
+    //result table
+    check_file_write(fnout.c_str());
+    FILE *ofile = fopen(fnout.c_str(), "w");
+    fprintf(ofile, "%s", header.c_str());
+    for (unsigned long k=0; k<nvar; k++)
+        fprintf(ofile, ",%s", vars[k].c_str());
+    fprintf(ofile, "\n");
+    for (unsigned long i=0; i<ntrial; i++) {
+        fprintf(ofile, "%s", rows[i].c_str());
+        for (unsigned long k=0; k<nvar; k++)
+            fprintf(ofile, ",%.8e", res[i*nvar + k]);
+        fprintf(ofile, "\n");
+    }
+    fclose(ofile);
+    printf("table written to: %s\n", fnout.c_str());
+
+    delete store;
+
+    return(0);
+}
@@ -0,0 +1,97 @@
+//! \file main_server.cc
+
+#include <mutex>
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+#include <csignal>
+#include <cstring>
+#include <unistd.h>
+#include <sys/un.h>
+#include <sys/socket.h>
+
+#include "omp.h"
+
+#include "io.h"
+#include "server.h"
+
+//! driver function compiled into `richards_server.exe`
+int main (int argc, char **argv) {
+
+    if ( (argc != 2) && (argc != 3) )
+        print_exit("the server must be given one or two command line arguments\n  1. path to settings file\n  2. (optional) path of a unix domain socket to listen on, otherwise requests are read from stdin");
+
+    //a client that goes away mid-answer shouldn't stop the server
+    signal(SIGPIPE, SIG_IGN);
+
+    Server server(argv[1], omp_get_max_threads());
+
+    //one client on stdin and stdout
+    if ( argc == 2 ) {
+        std::shared_ptr<Connection> con(new Connection(STDOUT_FILENO, false));
+        con->send(server.header());
+        server.serve(STDIN_FILENO, con);
+        server.drain();
+        return(0);
+    }
+
+    //socket
+    std::string path = argv[2];
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if ( path.size() >= sizeof(addr.sun_path) )
+        print_exit("socket path is too long");
+    strcpy(addr.sun_path, path.c_str());
+    int lfd = socket(AF_UNIX, SOCK_STREAM, 0);
+    unlink(path.c_str());
+    if ( (lfd < 0) || (bind(lfd, (struct sockaddr*)&addr, sizeof(addr)) != 0) || (listen(lfd, 64) != 0) ) {
+        printf("FAILURE: cannot listen on socket %s: %s\n", path.c_str(), strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    printf("listening on %s with %d threads\n", path.c_str(), omp_get_max_threads());
+    fflush(stdout);
+
+    //a reader thread for each client, and the descriptors still being read
+    std::vector<std::thread> readers;
+    std::vector<int> open;
+    std::mutex omtx;
+    std::atomic<bool> stop(false);
+    while ( true ) {
+        int cfd = accept(lfd, NULL, NULL);
+        if ( cfd < 0 ) {
+            if ( (errno == EINTR) && !stop )
+                continue;
+            break;
+        }
+        {
+            std::lock_guard<std::mutex> lock(omtx);
+            open.push_back(cfd);
+        }
+        readers.push_back( std::thread([&, cfd] () {
+            std::shared_ptr<Connection> con(new Connection(cfd, true));
+            con->send(server.header());
+            bool more = server.serve(cfd, con);
+            std::lock_guard<std::mutex> lock(omtx);
+            open.erase(std::find(open.begin(), open.end(), cfd));
+            //a shutdown request stops accepting and ends every other client's requests
+            if ( !more && !stop ) {
+                stop = true;
+                shutdown(lfd, SHUT_RDWR);
+                for (unsigned long i=0; i<open.size(); i++)
+                    shutdown(open[i], SHUT_RD);
+            }
+        }) );
+    }
+    for (unsigned long i=0; i<readers.size(); i++)
+        readers[i].join();
+    //answer everything already requested
+    server.drain();
+    close(lfd);
+    unlink(path.c_str());
+    printf("server shut down\n");
+
+    return(0);
+}
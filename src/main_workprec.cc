@@ -0,0 +1,236 @@
+//! \file main_workprec.cc
+
+#include <cmath>
+#include <ctime>
+#include <string>
+#include <vector>
+
+#include "omp.h"
+
+#include "io.h"
+#include "grid.h"
+#include "settings.h"
+#include "richards.h"
+
+//!integration of one configuration, with its cost and what's compared to the reference
+struct WorkPrec {
+    //!safety factor on the stable time step
+    double dtfac;
+    //!spinup tolerance
+    double rtol;
+    //!factor scaling the cell sizes of the settings
+    double gridfac;
+    //!number of cells
+    long n;
+    //!number of spinup periods
+    long nper;
+    //!number of steps
+    unsigned long nstep;
+    //!number of flux evaluations
+    unsigned long neval;
+    //!cpu time of the spinup and the cycle (s)
+    double cpu;
+    //!cycle-mean bottom flux (m/s)
+    double qbot;
+    //!cell center coordinates (m)
+    std::vector<double> zc;
+    //!water fractions at the end of the cycle
+    std::vector<double> w;
+    //!relative error of the cycle-mean bottom flux
+    double qerr;
+    //!maximum error of the water fractions at the end of the cycle
+    double werr;
+    //!why the watchdog abandoned the integration, or empty
+    std::string fail;
+};
+
+//!gets the cpu time of the calling thread (s)
+double thread_cpu () {
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return( ts.tv_sec + 1e-9*ts.tv_nsec );
+}
+
+//!spins up a configuration and integrates it over one infiltration period
+/*!
+\param[in] stg settings, with output disabled
+\param[in,out] r configuration, whose results are filled in
+*/
+void run (const Settings &stg, WorkPrec &r) {
+
+    Settings s = stg;
+    s.dtfac = r.dtfac;
+    s.delz0 = stg.delz0*r.gridfac;
+    s.delzmax = stg.delzmax*r.gridfac;
+    Grid grid(s.depth, s.delz0, s.delzfrac, s.delzmax);
+    Richards rich(grid, s);
+    rich.set_quiet(true);
+
+    double t = thread_cpu();
+    try {
+        rich.spinup(r.rtol, true);
+        rich.solve(s.infper, s.infper/1e12);
+    } catch ( Abandoned &e ) {
+        r.fail = failure_name(e.reason);
+    }
+    r.cpu = thread_cpu() - t;
+
+    const Metrics &met = rich.get_metrics();
+    r.n = rich.n;
+    r.nper = rich.spincount + 1;
+    r.nstep = rich.get_nstep();
+    r.neval = rich.get_neval();
+    r.qbot = r.fail.empty() ? met.qint[0]/(met.t1 - met.t0) : NAN;
+    r.zc = grid.get_zc();
+    r.w.assign(rich.get_sol(), rich.get_sol() + rich.n);
+}
+
+//!interpolates a profile linearly onto other cell centers, holding the end values beyond its range
+/*!
+\param[in] zc cell centers of the profile, increasing
+\param[in] w profile
+\param[in] z where to interpolate
+*/
+double interp_profile (const std::vector<double> &zc, const std::vector<double> &w, double z) {
+    long m = long(zc.size());
+    if ( z <= zc[0] )
+        return(w[0]);
+    if ( z >= zc[m-1] )
+        return(w[m-1]);
+    long i = 1;
+    while ( zc[i] < z ) i++;
+    double f = (z - zc[i-1])/(zc[i] - zc[i-1]);
+    return( (1 - f)*w[i-1] + f*w[i] );
+}
+
+//! driver function compiled into `richards_workprec.exe`
+int main (int argc, char **argv) {
+
+    if ( (argc != 3) && (argc != 4) )
+        print_exit("the work-precision harness must be given two or three command line arguments\n  1. path to settings file\n  2. path to output table\n  3. (optional) target relative error of the cycle-mean bottom flux, to pick the cheapest configuration meeting it");
+
+    //configurations, all combinations of these
+    std::vector<double> dtfacs = {0.05, 0.1, 0.2, 0.3, 0.4},
+                        rtols = {1e-4, 1e-6, 1e-8},
+                        gridfacs = {2, 1};
+    //reference, with cells 8 times finer than the finest configuration, smaller steps, and a tighter
+    //spinup, so its own discretization error is well below the errors being ranked. A check solution
+    //with cells twice as large estimates that error, which is at most their difference for a scheme
+    //converging at first order or better
+    WorkPrec ref, chk;
+    ref.dtfac = 0.03;
+    ref.rtol = 1e-10;
+    ref.gridfac = 0.125;
+    chk.dtfac = ref.dtfac;
+    chk.rtol = ref.rtol;
+    chk.gridfac = 2*ref.gridfac;
+
+    //read settings, with all output off
+    Settings stg = parse_settings(read_values(argv[1]));
+    disable_output(stg);
+    //configurations run in parallel and are spun up
+    sweep_settings(stg);
+    std::string fnout = argv[2];
+    double target = (argc == 4) ? std::atof(argv[3]) : 0.0;
+
+    printf("  computing reference solutions with dtfac = %g, rtol = %g, and cells %g and %g times as large\n",
+        ref.dtfac, ref.rtol, ref.gridfac, chk.gridfac);
+    WorkPrec *refs[2] = {&ref, &chk};
+    #pragma omp parallel for schedule(static, 1)
+    for (int l=0; l<2; l++)
+        run(stg, *refs[l]);
+    for (int l=0; l<2; l++) {
+        const WorkPrec &r = *refs[l];
+        if ( !r.fail.empty() )
+            print_exit(("a reference solution was abandoned by the watchdog (" + r.fail + ")").c_str());
+        printf("  reference with cells %g times as large: %li cells, %li spinup periods, %lu steps, %g s, mean qbot = %.10g m/s\n",
+            r.gridfac, r.n, r.nper, r.nstep, r.cpu, r.qbot);
+    }
+    //estimated relative error of the reference's bottom flux, below which configurations can't be told apart
+    double referr = fabs(ref.qbot - chk.qbot)/fabs(ref.qbot);
+    printf("  estimated relative error of the reference bottom flux: %.2e\n", referr);
+
+    std::vector<WorkPrec> res;
+    for (unsigned long i=0; i<dtfacs.size(); i++) {
+        for (unsigned long j=0; j<rtols.size(); j++) {
+            for (unsigned long k=0; k<gridfacs.size(); k++) {
+                WorkPrec r;
+                r.dtfac = dtfacs[i];
+                r.rtol = rtols[j];
+                r.gridfac = gridfacs[k];
+                res.push_back(r);
+            }
+        }
+    }
+    unsigned long nres = res.size();
+
+    printf("  integrating %lu configurations with %d threads\n", nres, omp_get_max_threads());
+    #pragma omp parallel for schedule(dynamic)
+    for (unsigned long l=0; l<nres; l++) {
+        WorkPrec &r = res[l];
+        run(stg, r);
+        r.qerr = fabs(r.qbot - ref.qbot)/fabs(ref.qbot);
+        //profiles are compared on the reference's cells
+        r.werr = 0.0;
+        for (long i=0; i<ref.n; i++) {
+            double e = fabs(interp_profile(r.zc, r.w, ref.zc[i]) - ref.w[i]);
+            if ( e > r.werr )
+                r.werr = e;
+        }
+    }
+
+    //a configuration is efficient if no other one is both cheaper and more accurate in the bottom flux,
+    //and abandoned ones never are. Errors below the reference's own are all treated as equal to it,
+    //since the reference can't rank them
+    std::vector<bool> front(nres, true);
+    for (unsigned long l=0; l<nres; l++)
+        front[l] = res[l].fail.empty();
+    for (unsigned long l=0; l<nres; l++)
+        for (unsigned long m=0; m<nres; m++)
+            if ( (res[m].neval < res[l].neval) && (fmax(res[m].qerr, referr) < fmax(res[l].qerr, referr)) )
+                front[l] = false;
+    //warn when the reference doesn't resolve the configurations
+    unsigned long nunres = 0;
+    for (unsigned long l=0; l<nres; l++)
+        if ( res[l].qerr <= referr )
+            nunres++;
+    if ( nunres > 0 )
+        printf("  warning: %lu configurations have bottom flux errors within the reference's estimated error, so they are ranked as equally accurate\n", nunres);
+
+    printf("  %6s | %6s | %7s | %4s | %4s | %9s | %9s | %9s | %9s | %9s\n",
+        "dtfac", "rtol", "gridfac", "n", "per", "neval", "cpu (s)", "qbot err", "w err", "efficient");
+    for (unsigned long l=0; l<nres; l++) {
+        const WorkPrec &r = res[l];
+        printf("  %6g | %6g | %7g | %4li | %4li | %9lu | %9.3f | %9.2e | %9.2e | %9s\n",
+            r.dtfac, r.rtol, r.gridfac, r.n, r.nper, r.neval, r.cpu, r.qerr, r.werr, front[l] ? "yes" : r.fail.c_str());
+    }
+
+    //cheapest configuration meeting the target, by flux evaluations, which don't vary between runs like cpu time
+    if ( target > 0 ) {
+        if ( target < referr )
+            printf("  warning: the target error %g is below the reference's estimated error %.2e, so meeting it can't be verified\n", target, referr);
+        long best = -1;
+        for (unsigned long l=0; l<nres; l++)
+            if ( (res[l].qerr <= target) && ((best < 0) || (res[l].neval < res[best].neval)) )
+                best = l;
+        if ( best < 0 ) {
+            printf("  no configuration meets a relative bottom flux error of %g\n", target);
+        } else {
+            printf("  cheapest configuration with a relative bottom flux error below %g: dtfac = %g, rtol = %g, gridfac = %g (%lu evaluations, %g s)\n",
+                target, res[best].dtfac, res[best].rtol, res[best].gridfac, res[best].neval, res[best].cpu);
+        }
+    }
+
+    check_file_write(fnout.c_str());
+    FILE *ofile = fopen(fnout.c_str(), "w");
+    fprintf(ofile, "dtfac,rtol,gridfac,n,periods,nstep,neval,cpu,qbot,qbot_abserr,qbot_relerr,qbot_referr,w_maxerr,efficient\n");
+    for (unsigned long l=0; l<nres; l++) {
+        const WorkPrec &r = res[l];
+        fprintf(ofile, "%g,%g,%g,%li,%li,%lu,%lu,%.6g,%.10e,%.6e,%.6e,%.6e,%.6e,%d\n",
+            r.dtfac, r.rtol, r.gridfac, r.n, r.nper, r.nstep, r.neval, r.cpu, r.qbot, fabs(r.qbot - ref.qbot), r.qerr, referr, r.werr, int(front[l]));
+    }
+    fclose(ofile);
+    printf("table written to: %s\n", fnout.c_str());
+
+    return(0);
+}
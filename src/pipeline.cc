@@ -0,0 +1,160 @@
+//! \file pipeline.cc
+
+#include <chrono>
+
+#include "pipeline.h"
+
+Pipeline::Pipeline (const std::string &dirout, Store *store, long nwriter, unsigned long capacity, TrialLog *log, bool quiet) :
+    dirout (dirout),
+    store (store),
+    log (log),
+    quiet (quiet),
+    queue (capacity),
+    capacity (capacity) {
+
+    done = false;
+    next = 0;
+    appending = false;
+    for (long i=0; i<nwriter; i++)
+        writers.push_back( std::thread(&Pipeline::run, this) );
+}
+
+Pipeline::~Pipeline () {
+    finish();
+}
+
+void Pipeline::push (unsigned long trial, unsigned long nstep, Store *out) {
+    TrialOutput r;
+    r.trial = trial;
+    r.nstep = nstep;
+    r.out = out;
+    out->close();
+    //only wait if the writers are a whole queue behind
+    while ( !queue.push(r) )
+        std::this_thread::yield();
+}
+
+void Pipeline::finish () {
+
+    done = true;
+    for (unsigned long i=0; i<writers.size(); i++)
+        writers[i].join();
+    writers.clear();
+    //anything ready, then anything held back for a missing trial
+    for (unsigned long i=0; i<ready.size(); i++)
+        put(ready[i]);
+    ready.clear();
+    std::map<unsigned long, TrialOutput>::iterator it;
+    for (it=early.begin(); it!=early.end(); it++)
+        put(it->second);
+    early.clear();
+}
+
+void Pipeline::run () {
+
+    TrialOutput r;
+    long idle = 0;
+    while ( true ) {
+        if ( queue.pop(r) ) {
+            write(r);
+            idle = 0;
+        } else if ( done ) {
+            //the flag is checked after a failed pop, so nothing is left behind
+            if ( !queue.pop(r) )
+                break;
+            write(r);
+        } else {
+            //back off without taking cores from the compute threads
+            if ( idle++ < 64 ) {
+                std::this_thread::yield();
+            } else {
+                std::this_thread::sleep_for(std::chrono::microseconds(200));
+            }
+        }
+    }
+}
+
+void Pipeline::write (TrialOutput &r) {
+
+    if ( store == NULL ) {
+        put(r);
+        return;
+    }
+    //append to the store in order of trial number
+    {
+        std::lock_guard<std::mutex> lock(omtx);
+        early[r.trial] = r;
+        advance();
+    }
+    drain();
+}
+
+void Pipeline::admit (unsigned long trial) {
+    if ( store == NULL )
+        return;
+    std::unique_lock<std::mutex> lock(omtx);
+    //skipped trials may have moved the next one in order
+    advance();
+    while ( (trial != next) && ((trial >= next + capacity) || (ready.size() >= capacity)) )
+        turn.wait(lock);
+}
+
+void Pipeline::skip (unsigned long trial) {
+    if ( store == NULL )
+        return;
+    {
+        std::lock_guard<std::mutex> lock(omtx);
+        skipped.insert(trial);
+        advance();
+    }
+    drain();
+}
+
+void Pipeline::advance () {
+    unsigned long prev = next;
+    while ( true ) {
+        //trials finished by an earlier run of a restarted sweep, or skipped in this one, never arrive
+        while ( (log && log->is_done(next)) || (skipped.erase(next) > 0) )
+            next++;
+        if ( early.empty() || (early.begin()->first != next) )
+            break;
+        ready.push_back(early.begin()->second);
+        early.erase(early.begin());
+        next++;
+    }
+    if ( next != prev )
+        turn.notify_all();
+}
+
+void Pipeline::drain () {
+    std::vector<TrialOutput> batch;
+    std::unique_lock<std::mutex> lock(omtx);
+    //the writer already appending takes these too, keeping them in order
+    if ( appending )
+        return;
+    appending = true;
+    while ( !ready.empty() ) {
+        batch.swap(ready);
+        turn.notify_all();
+        lock.unlock();
+        for (unsigned long i=0; i<batch.size(); i++)
+            put(batch[i]);
+        batch.clear();
+        lock.lock();
+    }
+    appending = false;
+}
+
+void Pipeline::put (TrialOutput &r) {
+    if ( store ) {
+        store->append(*r.out);
+    } else {
+        r.out->write_files(dirout);
+    }
+    if ( !quiet )
+        printf("  %11lu | %11lu\n", r.trial, r.nstep);
+    //a restarted sweep skips the trial from now on
+    if ( log )
+        log->add(r.trial);
+    delete r.out;
+}
@@ -0,0 +1,114 @@
+#ifndef PIPELINE_H_
+#define PIPELINE_H_
+
+//! \file pipeline.h
+
+#include <map>
+#include <set>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "io.h"
+#include "store.h"
+#include "queue.h"
+#include "checkpoint.h"
+
+//!output of a finished trial, waiting to be written
+struct TrialOutput {
+    //!trial number
+    unsigned long trial;
+    //!number of steps taken by the trial
+    unsigned long nstep;
+    //!closed, in-memory store holding all of the trial's output
+    Store *out;
+};
+
+//!writes the output of batch trials on dedicated threads, so compute threads never wait on the filesystem
+/*!
+Compute threads capture each trial's output in an in-memory Store and push it onto a lock-free queue, which only makes them wait if the writers fall a whole queue behind. Writer threads pop trials and either append them to the sweep's store or write every record to its own file, then print the trial's progress line.
+
+When writing into a store, trials are appended in order of their trial numbers, holding back any that finish early. Only one writer appends at a time, outside the lock ordering the trials, and the others hand it the trials that become ready instead of waiting for it. So a slow trial can't make the held back ones pile up, compute threads call admit() before starting a trial, which waits while the trial is `capacity` or more past the next one in order, or while `capacity` trials are ready but not yet appended. The next trial in order is always admitted, so the sweep can't stall on it.
+*/
+class Pipeline {
+
+public:
+
+    //!starts the writer threads
+    /*!
+    \param[in] dirout output directory, used if there's no store
+    \param[in] store store to append trials to, or NULL to write separate files
+    \param[in] nwriter number of writer threads
+    \param[in] capacity number of trials the queue can hold, and how far past the next trial in order a trial may start when writing into a store
+    \param[in] log log of finished trials, each added once its output is written, or NULL
+    \param[in] quiet whether to skip printing a line for each trial written
+    */
+    Pipeline (const std::string &dirout, Store *store, long nwriter, unsigned long capacity, TrialLog *log=NULL, bool quiet=false);
+    //!finishes writing
+    ~Pipeline ();
+
+    //!hands over a trial's output, which is closed and later deleted by the pipeline
+    void push (unsigned long trial, unsigned long nstep, Store *out);
+
+    //!waits until a trial may start without its output being held back too long, if writing into a store
+    void admit (unsigned long trial);
+
+    //!marks a trial that will never be pushed, like one abandoned or terminated, so later trials aren't held back for it
+    void skip (unsigned long trial);
+
+    //!waits for every pushed trial to be written and stops the writers
+    void finish ();
+
+private:
+
+    //!pops and writes trials until finished
+    void run ();
+
+    //!writes a trial's output, in order if writing into a store
+    void write (TrialOutput &r);
+
+    //!moves the trials held back that are next in order to the ready ones, with omtx held
+    void advance ();
+
+    //!appends the ready trials, unless another writer already is
+    void drain ();
+
+    //!writes a trial's output and deletes it
+    void put (TrialOutput &r);
+
+    //!output directory
+    std::string dirout;
+    //!store to append to, if any
+    Store *store;
+    //!log of finished trials, if any
+    TrialLog *log;
+    //!whether to skip the progress line of each trial
+    bool quiet;
+    //!trials waiting to be written
+    Queue<TrialOutput> queue;
+    //!writer threads
+    std::vector<std::thread> writers;
+    //!whether no more trials will be pushed
+    std::atomic<bool> done;
+    //!protects the ordering of trials
+    std::mutex omtx;
+    //!signals admitted trials when the next trial in order advances or the ready ones are taken
+    std::condition_variable turn;
+    //!how far past the next trial in order a trial may start, and most trials ready to append before admissions wait
+    unsigned long capacity;
+    //!trials that finished before the next one in order
+    std::map<unsigned long, TrialOutput> early;
+    //!trials in order, waiting to be appended
+    std::vector<TrialOutput> ready;
+    //!whether a writer is appending the ready trials
+    bool appending;
+    //!trials that will never arrive
+    std::set<unsigned long> skipped;
+    //!next trial to append to the store
+    unsigned long next;
+};
+
+#endif
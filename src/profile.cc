@@ -0,0 +1,194 @@
+//! \file profile.cc
+
+#include "profile.h"
+
+#ifdef PROFILE
+
+#include <mutex>
+#include <chrono>
+#include <memory>
+#include <vector>
+#include <cstdio>
+#include <cstring>
+#include <unistd.h>
+#include <sys/resource.h>
+
+#ifdef PROFILE_PERF
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+#include "io.h"
+
+//!names of the phases in reports
+static const char *phase_names[NPHASE] = {
+    "spinup_period",
+    "ode_fun",
+    "update_q",
+    "dt_adapt",
+    "after_step",
+    "snap"
+};
+
+//!names of the hardware events in reports
+static const char *event_names[NEVENT] = {
+    "cycles",
+    "instructions",
+    "cache_misses"
+};
+
+//!totals of every phase on one thread
+struct ProfileThread {
+    //!number of times each phase was entered
+    uint64_t calls[NPHASE];
+    //!time spent in each phase (ns)
+    int64_t ns[NPHASE];
+    //!events counted in each phase
+    uint64_t events[NPHASE][NEVENT];
+    //!group leader of the thread's event counters, or -1 if they're unavailable
+    int fd;
+};
+
+//!every thread that has profiled a phase, kept until the program ends
+static std::vector< std::unique_ptr<ProfileThread> > threads;
+//!protects the list of threads
+static std::mutex tmtx;
+
+#ifdef PROFILE_PERF
+//!opens a counter of a hardware event on the calling thread
+static int open_event (uint64_t config, int group) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = config;
+    attr.read_format = PERF_FORMAT_GROUP;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return( int(syscall(__NR_perf_event_open, &attr, 0, -1, group, 0)) );
+}
+#endif
+
+//!gets the calling thread's totals, setting them up on first use
+static ProfileThread *get_thread () {
+
+    static thread_local ProfileThread *th = NULL;
+    if ( th )
+        return(th);
+
+    th = new ProfileThread;
+    memset(th, 0, sizeof(ProfileThread));
+    th->fd = -1;
+#ifdef PROFILE_PERF
+    //the three events are read together as a group, or not at all
+    uint64_t config[NEVENT] = {
+        PERF_COUNT_HW_CPU_CYCLES,
+        PERF_COUNT_HW_INSTRUCTIONS,
+        PERF_COUNT_HW_CACHE_MISSES
+    };
+    int fds[NEVENT];
+    long k;
+    for (k=0; k<NEVENT; k++) {
+        fds[k] = open_event(config[k], (k == 0) ? -1 : fds[0]);
+        if ( fds[k] < 0 )
+            break;
+    }
+    if ( k == NEVENT ) {
+        th->fd = fds[0];
+    } else {
+        for (long j=0; j<k; j++) close(fds[j]);
+    }
+#endif
+    std::lock_guard<std::mutex> lock(tmtx);
+    threads.push_back( std::unique_ptr<ProfileThread>(th) );
+    return(th);
+}
+
+//!reads the event counts of a thread, leaving them unchanged if they're unavailable
+static void read_events (ProfileThread *th, uint64_t *e) {
+#ifdef PROFILE_PERF
+    if ( th->fd >= 0 ) {
+        //number of events followed by their counts
+        uint64_t buf[1 + NEVENT];
+        if ( read(th->fd, buf, sizeof(buf)) == ssize_t(sizeof(buf)) )
+            for (long k=0; k<NEVENT; k++) e[k] = buf[1+k];
+    }
+#else
+    (void)th;
+    (void)e;
+#endif
+}
+
+//!gets a monotonic time (ns)
+static int64_t now_ns () {
+    return( std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count() );
+}
+
+ProfileScope::ProfileScope (ProfilePhase phase) : phase (phase) {
+    ProfileThread *th = get_thread();
+    for (long k=0; k<NEVENT; k++) e0[k] = 0;
+    read_events(th, e0);
+    t0 = now_ns();
+}
+
+ProfileScope::~ProfileScope () {
+    int64_t t1 = now_ns();
+    ProfileThread *th = get_thread();
+    uint64_t e1[NEVENT];
+    for (long k=0; k<NEVENT; k++) e1[k] = e0[k];
+    read_events(th, e1);
+    th->calls[phase]++;
+    th->ns[phase] += t1 - t0;
+    for (long k=0; k<NEVENT; k++) th->events[phase][k] += e1[k] - e0[k];
+}
+
+void profile_report (const std::string &fn) {
+
+    //sums over threads
+    uint64_t calls[NPHASE] = {0}, events[NPHASE][NEVENT] = {{0}};
+    int64_t ns[NPHASE] = {0};
+    bool counted = false;
+    std::lock_guard<std::mutex> lock(tmtx);
+    for (unsigned long i=0; i<threads.size(); i++) {
+        const ProfileThread *th = threads[i].get();
+        for (long p=0; p<NPHASE; p++) {
+            calls[p] += th->calls[p];
+            ns[p] += th->ns[p];
+            for (long k=0; k<NEVENT; k++) events[p][k] += th->events[p][k];
+        }
+        if ( th->fd >= 0 )
+            counted = true;
+    }
+    //peak resident memory of the whole process (kB)
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+
+    check_file_write(fn.c_str());
+    FILE *ofile = fopen(fn.c_str(), "w");
+    fprintf(ofile, "{\n");
+    fprintf(ofile, "  \"peak_rss_kb\": %ld,\n", ru.ru_maxrss);
+    fprintf(ofile, "  \"threads\": %lu,\n", threads.size());
+    fprintf(ofile, "  \"counters\": %s,\n", counted ? "true" : "false");
+    fprintf(ofile, "  \"phases\": {\n");
+    for (long p=0; p<NPHASE; p++) {
+        fprintf(ofile, "    \"%s\": {\"calls\": %lu, \"seconds\": %.9f",
+            phase_names[p], (unsigned long)calls[p], 1e-9*ns[p]);
+        if ( counted )
+            for (long k=0; k<NEVENT; k++)
+                fprintf(ofile, ", \"%s\": %lu", event_names[k], (unsigned long)events[p][k]);
+        fprintf(ofile, "}%s\n", (p < NPHASE - 1) ? "," : "");
+    }
+    fprintf(ofile, "  }\n}\n");
+    fclose(ofile);
+    printf("profile written to: %s\n", fn.c_str());
+}
+
+#else
+
+void profile_report (const std::string &fn) {
+    (void)fn;
+}
+
+#endif
@@ -0,0 +1,65 @@
+#ifndef PROFILE_H_
+#define PROFILE_H_
+
+//! \file profile.h
+
+/*!
+Profiling is compiled in by building with `make prof=-DPROFILE`, which times the phases of every integration on every thread. Adding `-DPROFILE_PERF` also counts cycles, instructions, and cache misses in each phase with perf_event_open, at the cost of a system call at the start and end of each phase. Without these flags PROFILE_SCOPE expands to nothing and profile_report() does nothing. Times of nested phases are inclusive, so the time in ode_fun contains the time in update_q.
+*/
+
+#include <string>
+#include <cstdint>
+
+//!phases of an integration that are profiled
+enum ProfilePhase {
+    PHASE_SPINUP_PERIOD,
+    PHASE_ODE_FUN,
+    PHASE_UPDATE_Q,
+    PHASE_DT_ADAPT,
+    PHASE_AFTER_STEP,
+    PHASE_SNAP,
+    NPHASE
+};
+
+//!number of hardware events counted in each phase
+#define NEVENT 3
+
+#ifdef PROFILE
+
+//!times a phase from construction to destruction, adding to the calling thread's totals
+class ProfileScope {
+
+public:
+
+    //!starts timing a phase
+    ProfileScope (ProfilePhase phase);
+    //!adds the elapsed time and events to the phase's totals
+    ~ProfileScope ();
+
+private:
+
+    //!phase being timed
+    ProfilePhase phase;
+    //!start time (ns)
+    int64_t t0;
+    //!event counts at the start
+    uint64_t e0[NEVENT];
+};
+
+//!profiles the rest of the enclosing block as a phase
+#define PROFILE_SCOPE(phase) ProfileScope profile_scope_(phase)
+
+#else
+
+#define PROFILE_SCOPE(phase)
+
+#endif
+
+//!writes the totals of every phase over all threads, with the peak resident memory, as JSON
+/*!
+Nothing is written unless profiling is compiled in. Threads must be finished integrating.
+\param[in] fn path to the report
+*/
+void profile_report (const std::string &fn);
+
+#endif
@@ -0,0 +1,828 @@
+//! \file python.cc
+
+//Python.h must come first
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include <string>
+#include <vector>
+#include <exception>
+
+#include "io.h"
+#include "grid.h"
+#include "settings.h"
+#include "checkpoint.h"
+#include "compress.h"
+#include "richards.h"
+
+//Python extension module, built by `make python` into bin/, exposing Settings,
+//Grid, Richards, and the decoder of compressed tracker outputs. Model arrays are NumPy arrays viewing the model's own
+//memory, or memoryviews if NumPy can't be imported. Integrations release the
+//GIL, so separate Richards objects can be integrated on separate threads.
+
+//------------------------------------------------------------------------------
+//array views
+
+//!numpy.asarray, or NULL if NumPy isn't available
+static PyObject *asarray = NULL;
+
+//!exports memory owned by another object through the buffer protocol, keeping the owner alive
+struct View {
+    PyObject_HEAD
+    //!object owning the memory
+    PyObject *owner;
+    //!count of the owner's exported buffers, which keeps it from freeing the memory, or NULL if it never does
+    Py_ssize_t *exports;
+    //!first element
+    void *data;
+    //!struct format of the elements
+    const char *format;
+    //!bytes in each element
+    Py_ssize_t itemsize;
+    //!number of dimensions, 1 or 2
+    int ndim;
+    //!number of elements along each dimension
+    Py_ssize_t shape[2];
+    //!bytes between elements along each dimension
+    Py_ssize_t strides[2];
+    //!whether the memory may not be written through the view
+    int readonly;
+};
+
+static PyTypeObject *ViewType = NULL;
+
+static void view_dealloc (PyObject *self) {
+    PyTypeObject *tp = Py_TYPE(self);
+    Py_XDECREF(((View*)self)->owner);
+    tp->tp_free(self);
+    Py_DECREF(tp);
+}
+
+static int view_getbuffer (PyObject *self, Py_buffer *buf, int flags) {
+
+    View *v = (View*)self;
+    if ( (flags & PyBUF_WRITABLE) && v->readonly ) {
+        PyErr_SetString(PyExc_BufferError, "array is read-only");
+        buf->obj = NULL;
+        return(-1);
+    }
+    buf->buf = v->data;
+    buf->obj = self;
+    Py_INCREF(self);
+    buf->len = v->itemsize*v->shape[0]*(v->ndim > 1 ? v->shape[1] : 1);
+    buf->readonly = v->readonly;
+    buf->itemsize = v->itemsize;
+    buf->format = (flags & PyBUF_FORMAT) ? (char*)v->format : NULL;
+    buf->ndim = v->ndim;
+    buf->shape = (flags & PyBUF_ND) ? v->shape : NULL;
+    buf->strides = ((flags & PyBUF_STRIDES) == PyBUF_STRIDES) ? v->strides : NULL;
+    buf->suboffsets = NULL;
+    buf->internal = NULL;
+    if ( v->exports )
+        (*v->exports)++;
+    return(0);
+}
+
+static void view_releasebuffer (PyObject *self, Py_buffer *buf) {
+    (void)buf;
+    View *v = (View*)self;
+    if ( v->exports )
+        (*v->exports)--;
+}
+
+static PyType_Slot view_slots[] = {
+    {Py_tp_dealloc, (void*)view_dealloc},
+    {Py_bf_getbuffer, (void*)view_getbuffer},
+    {Py_bf_releasebuffer, (void*)view_releasebuffer},
+    {0, NULL}
+};
+
+static PyType_Spec view_spec = {
+    "richards.View", sizeof(View), 0, Py_TPFLAGS_DEFAULT, view_slots
+};
+
+//!wraps memory owned by an object in an array, without copying
+/*!
+\param[in] owner object owning the memory, kept alive by the array
+\param[in] exports count of the owner's exported buffers, which it checks before freeing the memory, or NULL if it never does
+\param[in] data first element
+\param[in] nrow number of elements, or rows if ncol > 0
+\param[in] ncol number of columns of a two dimensional array, or 0
+\param[in] readonly whether the array may not be written
+\return a NumPy array, or a memoryview without NumPy
+*/
+template <class T>
+static PyObject *make_array (PyObject *owner, Py_ssize_t *exports, const T *data, Py_ssize_t nrow, Py_ssize_t ncol, bool readonly) {
+
+    //empty vectors may have no memory at all
+    static T empty[1];
+    View *v = PyObject_New(View, ViewType);
+    if ( v == NULL )
+        return(NULL);
+    Py_INCREF(owner);
+    v->owner = owner;
+    v->exports = exports;
+    v->data = (void*)( (data == NULL) ? empty : data );
+    v->format = (sizeof(T) == sizeof(double)) ? "d" : "f";
+    v->itemsize = sizeof(T);
+    v->ndim = (ncol > 0) ? 2 : 1;
+    v->shape[0] = nrow;
+    v->shape[1] = ncol;
+    v->strides[0] = (ncol > 0) ? ncol*sizeof(T) : sizeof(T);
+    v->strides[1] = sizeof(T);
+    v->readonly = readonly ? 1 : 0;
+
+    PyObject *mv = PyMemoryView_FromObject((PyObject*)v);
+    Py_DECREF(v);
+    if ( (mv == NULL) || (asarray == NULL) )
+        return(mv);
+    PyObject *a = PyObject_CallFunctionObjArgs(asarray, mv, NULL);
+    Py_DECREF(mv);
+    return(a);
+}
+
+template <class T>
+static PyObject *make_array (PyObject *owner, Py_ssize_t *exports, const std::vector<T> &a, bool readonly=true) {
+    return( make_array(owner, exports, a.data(), Py_ssize_t(a.size()), 0, readonly) );
+}
+
+//------------------------------------------------------------------------------
+//Settings
+
+//!settings read from a file, which can be edited before building grids and models
+struct PySettings {
+    PyObject_HEAD
+    //!setting and value pairs, as read from the file
+    std::vector< std::vector<std::string> > *values;
+};
+
+static PyTypeObject *SettingsType = NULL;
+
+static void settings_dealloc (PyObject *self) {
+    PyTypeObject *tp = Py_TYPE(self);
+    delete ((PySettings*)self)->values;
+    tp->tp_free(self);
+    Py_DECREF(tp);
+}
+
+static int settings_init (PyObject *self, PyObject *args, PyObject *kw) {
+
+    static const char *kwlist[] = {"fn", NULL};
+    const char *fn;
+    if ( !PyArg_ParseTupleAndKeywords(args, kw, "s", (char**)kwlist, &fn) )
+        return(-1);
+    //reading would quit the interpreter if the file can't be opened
+    FILE *f = fopen(fn, "r");
+    if ( f == NULL ) {
+        PyErr_SetFromErrnoWithFilename(PyExc_OSError, fn);
+        return(-1);
+    }
+    fclose(f);
+    PySettings *s = (PySettings*)self;
+    delete s->values;
+    s->values = new std::vector< std::vector<std::string> >(read_values(fn));
+    return(0);
+}
+
+//!finds a setting's pair, or returns NULL with a KeyError set
+static std::vector<std::string> *settings_find (PySettings *s, PyObject *key, bool raise=true) {
+    const char *k = PyUnicode_AsUTF8(key);
+    if ( k == NULL )
+        return(NULL);
+    for (unsigned long i=0; i<s->values->size(); i++)
+        if ( (*s->values)[i][0] == k )
+            return( &(*s->values)[i] );
+    if ( raise )
+        PyErr_SetObject(PyExc_KeyError, key);
+    return(NULL);
+}
+
+static PyObject *settings_getitem (PyObject *self, PyObject *key) {
+    std::vector<std::string> *p = settings_find((PySettings*)self, key);
+    if ( p == NULL )
+        return(NULL);
+    return( PyUnicode_FromString((*p)[1].c_str()) );
+}
+
+static int settings_setitem (PyObject *self, PyObject *key, PyObject *value) {
+
+    if ( value == NULL ) {
+        PyErr_SetString(PyExc_TypeError, "settings can't be deleted");
+        return(-1);
+    }
+    //values are kept as the strings a settings file would hold
+    PyObject *str = PyObject_Str(value);
+    if ( str == NULL )
+        return(-1);
+    const char *v = PyUnicode_AsUTF8(str);
+    PySettings *s = (PySettings*)self;
+    std::vector<std::string> *p = settings_find(s, key, false);
+    if ( (v == NULL) || PyErr_Occurred() ) {
+        Py_DECREF(str);
+        return(-1);
+    }
+    if ( p ) {
+        (*p)[1] = v;
+    } else {
+        std::vector<std::string> pair(2);
+        pair[0] = PyUnicode_AsUTF8(key);
+        pair[1] = v;
+        s->values->push_back(pair);
+    }
+    Py_DECREF(str);
+    return(0);
+}
+
+static Py_ssize_t settings_len (PyObject *self) {
+    return( Py_ssize_t(((PySettings*)self)->values->size()) );
+}
+
+static PyObject *settings_keys (PyObject *self, PyObject *unused) {
+    (void)unused;
+    PySettings *s = (PySettings*)self;
+    PyObject *keys = PyList_New(0);
+    for (unsigned long i=0; (keys != NULL) && (i<s->values->size()); i++) {
+        PyObject *k = PyUnicode_FromString((*s->values)[i][0].c_str());
+        if ( (k == NULL) || (PyList_Append(keys, k) != 0) )
+            Py_CLEAR(keys);
+        Py_XDECREF(k);
+    }
+    return(keys);
+}
+
+static PyMethodDef settings_methods[] = {
+    {"keys", settings_keys, METH_NOARGS, "names of all the settings"},
+    {NULL, NULL, 0, NULL}
+};
+
+static PyType_Slot settings_slots[] = {
+    {Py_tp_doc, (void*)"Settings(fn)\n\nsettings read from a file, indexed by name like a dict of strings; assigned values are converted with str()"},
+    {Py_tp_new, (void*)PyType_GenericNew},
+    {Py_tp_init, (void*)settings_init},
+    {Py_tp_dealloc, (void*)settings_dealloc},
+    {Py_tp_methods, (void*)settings_methods},
+    {Py_mp_subscript, (void*)settings_getitem},
+    {Py_mp_ass_subscript, (void*)settings_setitem},
+    {Py_mp_length, (void*)settings_len},
+    {0, NULL}
+};
+
+static PyType_Spec settings_spec = {
+    "richards.Settings", sizeof(PySettings), 0, Py_TPFLAGS_DEFAULT, settings_slots
+};
+
+//!parses a Settings object, or returns false with a TypeError or KeyError set
+static bool to_settings (PyObject *obj, Settings &stg) {
+    if ( !PyObject_TypeCheck(obj, SettingsType) || (((PySettings*)obj)->values == NULL) ) {
+        PyErr_SetString(PyExc_TypeError, "expected a Settings object");
+        return(false);
+    }
+    //parsing would quit the interpreter on an unknown setting
+    std::string err;
+    if ( !parse_settings(*((PySettings*)obj)->values, stg, err) ) {
+        PyErr_SetString(PyExc_KeyError, err.c_str());
+        return(false);
+    }
+    return(true);
+}
+
+//------------------------------------------------------------------------------
+//Grid
+
+//!model grid
+struct PyGrid {
+    PyObject_HEAD
+    Grid *grid;
+    //!number of buffers exported by arrays viewing the grid
+    Py_ssize_t nexport;
+};
+
+static PyTypeObject *GridType = NULL;
+
+static void grid_dealloc (PyObject *self) {
+    PyTypeObject *tp = Py_TYPE(self);
+    delete ((PyGrid*)self)->grid;
+    tp->tp_free(self);
+    Py_DECREF(tp);
+}
+
+static int grid_init (PyObject *self, PyObject *args, PyObject *kw) {
+
+    double depth, delz0, delzfrac, delzmax;
+    PyObject *obj;
+    if ( (PyTuple_Size(args) == 1) && (kw == NULL) ) {
+        //from the grid settings
+        if ( !PyArg_ParseTuple(args, "O", &obj) )
+            return(-1);
+        Settings stg;
+        if ( !to_settings(obj, stg) )
+            return(-1);
+        depth = stg.depth;
+        delz0 = stg.delz0;
+        delzfrac = stg.delzfrac;
+        delzmax = stg.delzmax;
+    } else {
+        static const char *kwlist[] = {"depth", "delz0", "delzfrac", "delzmax", NULL};
+        if ( !PyArg_ParseTupleAndKeywords(args, kw, "dddd", (char**)kwlist, &depth, &delz0, &delzfrac, &delzmax) )
+            return(-1);
+    }
+    PyGrid *g = (PyGrid*)self;
+    if ( g->nexport > 0 ) {
+        PyErr_SetString(PyExc_BufferError, "grid arrays are still in use, so the grid can't be replaced");
+        return(-1);
+    }
+    delete g->grid;
+    g->grid = new Grid(depth, delz0, delzfrac, delzmax);
+    return(0);
+}
+
+static Grid *get_grid (PyObject *self) {
+    Grid *grid = ((PyGrid*)self)->grid;
+    if ( grid == NULL )
+        PyErr_SetString(PyExc_RuntimeError, "grid isn't initialized");
+    return(grid);
+}
+
+static PyObject *grid_get_n (PyObject *self, void *unused) {
+    (void)unused;
+    Grid *g = get_grid(self);
+    return( g ? PyLong_FromLong(g->get_n()) : NULL );
+}
+
+static PyObject *grid_get_depth (PyObject *self, void *unused) {
+    (void)unused;
+    Grid *g = get_grid(self);
+    return( g ? PyFloat_FromDouble(g->get_dep()) : NULL );
+}
+
+//!grid arrays, selected by the closure
+static PyObject *grid_get_array (PyObject *self, void *which) {
+    Grid *g = get_grid(self);
+    if ( g == NULL )
+        return(NULL);
+    switch ( long(which) ) {
+        case 0: return( make_array(self, &((PyGrid*)self)->nexport, g->get_ze()) );
+        case 1: return( make_array(self, &((PyGrid*)self)->nexport, g->get_zc()) );
+        case 2: return( make_array(self, &((PyGrid*)self)->nexport, g->get_delz()) );
+        default: return( make_array(self, &((PyGrid*)self)->nexport, g->get_delze()) );
+    }
+}
+
+static PyGetSetDef grid_getset[] = {
+    {(char*)"n", grid_get_n, NULL, (char*)"number of cells", NULL},
+    {(char*)"depth", grid_get_depth, NULL, (char*)"depth of the domain (m)", NULL},
+    {(char*)"ze", grid_get_array, NULL, (char*)"cell edge coordinates (m)", (void*)0},
+    {(char*)"zc", grid_get_array, NULL, (char*)"cell center coordinates (m)", (void*)1},
+    {(char*)"delz", grid_get_array, NULL, (char*)"cell widths (m)", (void*)2},
+    {(char*)"delze", grid_get_array, NULL, (char*)"cell widths used for stability calculations (m)", (void*)3},
+    {NULL, NULL, NULL, NULL, NULL}
+};
+
+static PyType_Slot grid_slots[] = {
+    {Py_tp_doc, (void*)"Grid(depth, delz0, delzfrac, delzmax) or Grid(settings)\n\nmodel grid"},
+    {Py_tp_new, (void*)PyType_GenericNew},
+    {Py_tp_init, (void*)grid_init},
+    {Py_tp_dealloc, (void*)grid_dealloc},
+    {Py_tp_getset, (void*)grid_getset},
+    {0, NULL}
+};
+
+static PyType_Spec grid_spec = {
+    "richards.Grid", sizeof(PyGrid), 0, Py_TPFLAGS_DEFAULT, grid_slots
+};
+
+//------------------------------------------------------------------------------
+//Richards
+
+//!model, integrated with the GIL released
+struct PyRichards {
+    PyObject_HEAD
+    Richards *rich;
+    //!whether an integration is running on some thread
+    bool busy;
+    //!number of buffers exported by arrays viewing the model
+    Py_ssize_t nexport;
+};
+
+static PyTypeObject *RichardsType = NULL;
+
+static void richards_dealloc (PyObject *self) {
+    PyTypeObject *tp = Py_TYPE(self);
+    delete ((PyRichards*)self)->rich;
+    tp->tp_free(self);
+    Py_DECREF(tp);
+}
+
+static int richards_init (PyObject *self, PyObject *args, PyObject *kw) {
+
+    static const char *kwlist[] = {"grid", "settings", NULL};
+    PyObject *g, *s;
+    if ( !PyArg_ParseTupleAndKeywords(args, kw, "O!O", (char**)kwlist, GridType, &g, &s) )
+        return(-1);
+    Settings stg;
+    if ( !to_settings(s, stg) || (get_grid(g) == NULL) )
+        return(-1);
+    PyRichards *r = (PyRichards*)self;
+    if ( r->busy ) {
+        PyErr_SetString(PyExc_RuntimeError, "model is being integrated");
+        return(-1);
+    }
+    if ( r->nexport > 0 ) {
+        PyErr_SetString(PyExc_BufferError, "model arrays are still in use, so the model can't be replaced");
+        return(-1);
+    }
+    delete r->rich;
+    r->rich = NULL;
+    r->busy = false;
+    //a forcing series that can't be read throws
+    try {
+        r->rich = new Richards(*((PyGrid*)g)->grid, stg);
+    } catch ( std::exception &e ) {
+        PyErr_SetString(PyExc_RuntimeError, e.what());
+        return(-1);
+    }
+    return(0);
+}
+
+//!gets the model, or returns NULL with an exception set if it can't be used now
+static Richards *get_rich (PyObject *self) {
+    PyRichards *r = (PyRichards*)self;
+    if ( r->rich == NULL ) {
+        PyErr_SetString(PyExc_RuntimeError, "model isn't initialized");
+        return(NULL);
+    }
+    if ( r->busy ) {
+        PyErr_SetString(PyExc_RuntimeError, "model is being integrated on another thread");
+        return(NULL);
+    }
+    return(r->rich);
+}
+
+//!integration requested by a method, run without the GIL
+struct Job {
+    //!0 spinup, 1 solve, 2 advance, 3 step
+    int kind;
+    double a, b;
+    unsigned long nsnap;
+    std::string dirout;
+    bool quiet;
+};
+
+//!runs an integration with the GIL released, translating C++ exceptions into Python ones
+static PyObject *run (PyObject *self, const Job &job) {
+
+    Richards *rich = get_rich(self);
+    if ( rich == NULL )
+        return(NULL);
+    PyRichards *r = (PyRichards*)self;
+    std::string err;
+    r->busy = true;
+    Py_BEGIN_ALLOW_THREADS
+    try {
+        double h;
+        switch ( job.kind ) {
+            case 0:
+                rich->spinup(job.a, job.quiet);
+                break;
+            case 1:
+                rich->solve(job.a, job.b, job.nsnap, job.dirout);
+                break;
+            case 2:
+                rich->solve_adaptive(job.a, job.a/1e9, false);
+                break;
+            default:
+                //a single step of the size the model would choose
+                h = rich->dt_adapt();
+                if ( !(h > 0) ) {
+                    //diffusivities aren't evaluated until the first step
+                    std::vector<double> f(rich->get_neq());
+                    rich->ode_fun(rich->get_sol(), f.data());
+                    h = rich->dt_adapt();
+                }
+                rich->solve_fixed(h, h, false);
+        }
+    } catch ( Terminated & ) {
+        err = "integration terminated after writing its checkpoint";
+    } catch ( std::exception &e ) {
+        err = e.what();
+    }
+    Py_END_ALLOW_THREADS
+    r->busy = false;
+    if ( !err.empty() ) {
+        PyErr_SetString(PyExc_RuntimeError, err.c_str());
+        return(NULL);
+    }
+    return( PyFloat_FromDouble(rich->get_t()) );
+}
+
+static PyObject *richards_spinup (PyObject *self, PyObject *args, PyObject *kw) {
+    static const char *kwlist[] = {"rtol", "quiet", NULL};
+    Job job;
+    job.kind = 0;
+    job.a = 1e-12;
+    int quiet = 1;
+    if ( !PyArg_ParseTupleAndKeywords(args, kw, "|dp", (char**)kwlist, &job.a, &quiet) )
+        return(NULL);
+    job.quiet = quiet;
+    return( run(self, job) );
+}
+
+static PyObject *richards_solve_adaptive (PyObject *self, PyObject *args, PyObject *kw) {
+    static const char *kwlist[] = {"tint", "dt0", "nsnap", "dirout", NULL};
+    Job job;
+    job.kind = 1;
+    job.nsnap = 0;
+    const char *dirout = ".";
+    if ( !PyArg_ParseTupleAndKeywords(args, kw, "dd|ks", (char**)kwlist, &job.a, &job.b, &job.nsnap, &dirout) )
+        return(NULL);
+    job.dirout = dirout;
+    return( run(self, job) );
+}
+
+static PyObject *richards_advance (PyObject *self, PyObject *args) {
+    Job job;
+    job.kind = 2;
+    if ( !PyArg_ParseTuple(args, "d", &job.a) )
+        return(NULL);
+    return( run(self, job) );
+}
+
+static PyObject *richards_step (PyObject *self, PyObject *unused) {
+    (void)unused;
+    Job job;
+    job.kind = 3;
+    return( run(self, job) );
+}
+
+static PyObject *richards_set_quiet (PyObject *self, PyObject *args) {
+    int quiet;
+    Richards *rich = get_rich(self);
+    if ( (rich == NULL) || !PyArg_ParseTuple(args, "p", &quiet) )
+        return(NULL);
+    rich->set_quiet(quiet);
+    Py_RETURN_NONE;
+}
+
+static PyObject *richards_metrics (PyObject *self, PyObject *unused) {
+    (void)unused;
+    Richards *rich = get_rich(self);
+    if ( rich == NULL )
+        return(NULL);
+    const Metrics &m = rich->get_metrics();
+    return( Py_BuildValue("{s:d,s:d,s:N,s:N,s:N,s:d,s:d,s:d}",
+        "t0", m.t0,
+        "t1", m.t1,
+        "qint", make_array(self, &((PyRichards*)self)->nexport, m.qint),
+        "qmin", make_array(self, &((PyRichards*)self)->nexport, m.qmin),
+        "qmax", make_array(self, &((PyRichards*)self)->nexport, m.qmax),
+        "stor0", m.stor0,
+        "dstor", m.dstor,
+        "balance", m.balance) );
+}
+
+static PyObject *richards_limits (PyObject *self, PyObject *unused) {
+    (void)unused;
+    Richards *rich = get_rich(self);
+    if ( rich == NULL )
+        return(NULL);
+    PyObject *edges = PyList_New(rich->n + 1);
+    if ( edges == NULL )
+        return(NULL);
+    for (long i=0; i<rich->n+1; i++)
+        PyList_SET_ITEM(edges, i, PyLong_FromUnsignedLong(rich->nlimedge[i]));
+    return( Py_BuildValue("{s:k,s:k,s:k,s:k,s:N}",
+        "diffusion", rich->nlimit[LIMIT_DIFFUSION],
+        "infil", rich->nlimit[LIMIT_INFIL],
+        "event", rich->nlimit[LIMIT_EVENT],
+        "evap", rich->nlimit[LIMIT_EVAP],
+        "edges", edges) );
+}
+
+static PyObject *richards_tracker_columns (PyObject *self, PyObject *unused) {
+    (void)unused;
+    Richards *rich = get_rich(self);
+    if ( rich == NULL )
+        return(NULL);
+    return( Py_BuildValue("{s:l,s:l,s:l,s:l,s:l,s:l,s:l,s:l}",
+        "t", rich->jt,
+        "qtop", rich->jqtop,
+        "qmid", rich->jqmid,
+        "qbot", rich->jqbot,
+        "qall", rich->jqall,
+        "wall", rich->jwall,
+        "infil", rich->jinfil,
+        "limit", rich->jlimit) );
+}
+
+static PyMethodDef richards_methods[] = {
+    {"spinup", (PyCFunction)(void(*)(void))richards_spinup, METH_VARARGS | METH_KEYWORDS,
+        "spinup(rtol=1e-12, quiet=True)\n\nintegrates infiltration periods until the fluxes stop changing, returning the model time"},
+    {"solve_adaptive", (PyCFunction)(void(*)(void))richards_solve_adaptive, METH_VARARGS | METH_KEYWORDS,
+        "solve_adaptive(tint, dt0, nsnap=0, dirout='.')\n\nintegrates for tint seconds with trackers and reductions, writing the outputs enabled in the settings into dirout, and returns the model time"},
+    {"advance", richards_advance, METH_VARARGS,
+        "advance(tint)\n\nintegrates for tint seconds without trackers, reductions or output, returning the model time"},
+    {"step", richards_step, METH_NOARGS,
+        "step()\n\ntakes a single step of the size the model would choose, without trackers, reductions or output, returning the model time"},
+    {"set_quiet", richards_set_quiet, METH_VARARGS, "set_quiet(quiet)\n\nturns printing during integrations off or on"},
+    {"metrics", richards_metrics, METH_NOARGS, "reductions over the most recent solve, as a dict"},
+    {"limits", richards_limits, METH_NOARGS, "number of steps bounded by each constraint since the model was created, and by diffusion at each edge, as a dict"},
+    {"tracker_columns", richards_tracker_columns, METH_NOARGS, "columns of the tracker array holding each tracked variable, or -1 for those not tracked"},
+    {NULL, NULL, 0, NULL}
+};
+
+static PyObject *richards_get_scalar (PyObject *self, void *which) {
+    Richards *rich = get_rich(self);
+    if ( rich == NULL )
+        return(NULL);
+    switch ( long(which) ) {
+        case 0: return( PyFloat_FromDouble(rich->get_t()) );
+        case 1: return( PyFloat_FromDouble(rich->get_dt()) );
+        case 2: return( PyLong_FromUnsignedLong(rich->get_nstep()) );
+        case 3: return( PyLong_FromUnsignedLong(rich->get_neval()) );
+        default: return( PyLong_FromLong(rich->n) );
+    }
+}
+
+static PyObject *richards_get_name (PyObject *self, void *unused) {
+    (void)unused;
+    Richards *rich = get_rich(self);
+    return( rich ? PyUnicode_FromString(rich->get_name().c_str()) : NULL );
+}
+
+static int richards_set_name (PyObject *self, PyObject *value, void *unused) {
+    (void)unused;
+    Richards *rich = get_rich(self);
+    const char *name = value ? PyUnicode_AsUTF8(value) : NULL;
+    if ( (rich == NULL) || (name == NULL) )
+        return(-1);
+    rich->set_name(name);
+    return(0);
+}
+
+//!state arrays, selected by the closure
+static PyObject *richards_get_array (PyObject *self, void *which) {
+    Richards *rich = get_rich(self);
+    if ( rich == NULL )
+        return(NULL);
+    switch ( long(which) ) {
+        case 0: return( make_array(self, &((PyRichards*)self)->nexport, rich->get_sol(), Py_ssize_t(rich->get_neq()), 0, false) );
+        case 1: return( make_array(self, &((PyRichards*)self)->nexport, rich->get_sol(), Py_ssize_t(rich->n), 0, false) );
+        case 2: return( make_array(self, &((PyRichards*)self)->nexport, rich->q) );
+        case 3: return( make_array(self, &((PyRichards*)self)->nexport, rich->K) );
+        case 4: return( make_array(self, &((PyRichards*)self)->nexport, rich->D) );
+        case 5: return( make_array(self, &((PyRichards*)self)->nexport, rich->we) );
+        default: return( make_array(self, &((PyRichards*)self)->nexport, rich->dwdz) );
+    }
+}
+
+static PyObject *richards_get_tracker (PyObject *self, void *unused) {
+    (void)unused;
+    Richards *rich = get_rich(self);
+    if ( rich == NULL )
+        return(NULL);
+    Tracker &trk = rich->trk;
+    long width = trk.get_width();
+    unsigned long nrow = trk.get_nrow();
+    //solves replace the tracker's buffer, so the rows are copied into a bytes object owning them
+    PyObject *rows = PyBytes_FromStringAndSize((width > 0) ? (const char*)trk.get_row(0) : NULL, Py_ssize_t(nrow*width*sizeof(float)));
+    if ( rows == NULL )
+        return(NULL);
+    PyObject *a = make_array(rows, (Py_ssize_t*)NULL, (const float*)PyBytes_AS_STRING(rows), Py_ssize_t(nrow), Py_ssize_t(width), true);
+    Py_DECREF(rows);
+    return(a);
+}
+
+static PyGetSetDef richards_getset[] = {
+    {(char*)"t", richards_get_scalar, NULL, (char*)"model time (s)", (void*)0},
+    {(char*)"dt", richards_get_scalar, NULL, (char*)"most recent time step (s)", (void*)1},
+    {(char*)"nstep", richards_get_scalar, NULL, (char*)"number of steps taken", (void*)2},
+    {(char*)"neval", richards_get_scalar, NULL, (char*)"number of right-hand side evaluations", (void*)3},
+    {(char*)"n", richards_get_scalar, NULL, (char*)"number of cells", (void*)4},
+    {(char*)"name", richards_get_name, richards_set_name, (char*)"prefix of output names", NULL},
+    {(char*)"sol", richards_get_array, NULL, (char*)"whole solution vector, writable", (void*)0},
+    {(char*)"w", richards_get_array, NULL, (char*)"water fractions of the cells, writable", (void*)1},
+    {(char*)"q", richards_get_array, NULL, (char*)"fluxes at cell edges from the latest evaluation (m/s)", (void*)2},
+    {(char*)"K", richards_get_array, NULL, (char*)"hydraulic conductivity at cell edges (m/s)", (void*)3},
+    {(char*)"D", richards_get_array, NULL, (char*)"diffusivity at cell edges", (void*)4},
+    {(char*)"we", richards_get_array, NULL, (char*)"water fractions at cell edges", (void*)5},
+    {(char*)"dwdz", richards_get_array, NULL, (char*)"water fraction gradients at cell edges (1/m)", (void*)6},
+    {(char*)"tracker", richards_get_tracker, NULL,
+        (char*)"copy of the rows of tracked variables held in memory, one per step or sample, with columns given by tracker_columns()", NULL},
+    {NULL, NULL, NULL, NULL, NULL}
+};
+
+static PyType_Slot richards_slots[] = {
+    {Py_tp_doc, (void*)"Richards(grid, settings)\n\nmodel of one soil column, whose arrays are views of the model's memory; it can't be initialized again while any of them are alive"},
+    {Py_tp_new, (void*)PyType_GenericNew},
+    {Py_tp_init, (void*)richards_init},
+    {Py_tp_dealloc, (void*)richards_dealloc},
+    {Py_tp_methods, (void*)richards_methods},
+    {Py_tp_getset, (void*)richards_getset},
+    {0, NULL}
+};
+
+static PyType_Spec richards_spec = {
+    "richards.Richards", sizeof(PyRichards), 0, Py_TPFLAGS_DEFAULT, richards_slots
+};
+
+//------------------------------------------------------------------------------
+//compressed output
+
+//!reads a little-endian unsigned integer of a block header
+static uint64_t header_field (const unsigned char *in, int nbyte) {
+    uint64_t v = 0;
+    for (int k=nbyte-1; k>=0; k--) v = (v << 8) | in[k];
+    return(v);
+}
+
+static PyObject *decompress_block (PyObject *self, PyObject *args) {
+
+    (void)self;
+    Py_buffer buf;
+    Py_ssize_t pos;
+    if ( !PyArg_ParseTuple(args, "y*n", &buf, &pos) )
+        return(NULL);
+    const unsigned char *in = (const unsigned char*)buf.buf;
+    //the header has to fit, and every value takes at least one of the encoded bits
+    uint64_t m = 0, nb = 0;
+    bool ok = (pos >= 0) && (pos + COMPRESS_HEADER <= buf.len);
+    if ( ok ) {
+        m = header_field(in + pos + 8, 8);
+        nb = header_field(in + pos + 16, 8);
+        ok = (nb <= uint64_t(buf.len - pos - COMPRESS_HEADER)) && (m <= 8*nb);
+    }
+    if ( !ok ) {
+        PyBuffer_Release(&buf);
+        PyErr_SetString(PyExc_ValueError, "no complete compressed block at this offset");
+        return(NULL);
+    }
+
+    std::vector<float> x;
+    uint32_t ncol, j;
+    unsigned long next;
+    Py_BEGIN_ALLOW_THREADS
+    x.reserve(m);
+    next = decompress_series(in, pos, x, ncol, j);
+    Py_END_ALLOW_THREADS
+    PyBuffer_Release(&buf);
+
+    //the values are copied into a bytes object, which owns them and never changes
+    PyObject *b = PyBytes_FromStringAndSize((const char*)x.data(), Py_ssize_t(x.size()*sizeof(float)));
+    if ( b == NULL )
+        return(NULL);
+    PyObject *a = make_array(b, NULL, (const float*)PyBytes_AS_STRING(b), Py_ssize_t(x.size()), 0, true);
+    Py_DECREF(b);
+    if ( a == NULL )
+        return(NULL);
+    return( Py_BuildValue("kkNk", (unsigned long)ncol, (unsigned long)j, a, next) );
+}
+
+//------------------------------------------------------------------------------
+//module
+
+static PyMethodDef module_methods[] = {
+    {"decompress_block", decompress_block, METH_VARARGS,
+        "decompress_block(buf, pos)\n\ndecompresses the block of a compressed tracker output starting at byte offset pos of buf, returning the number of columns in its group, its column, its values as float32, and the offset after it"},
+    {NULL, NULL, 0, NULL}
+};
+
+static struct PyModuleDef module_def = {
+    PyModuleDef_HEAD_INIT, "richards", "one-dimensional Richards equation model", -1,
+    module_methods, NULL, NULL, NULL, NULL
+};
+
+//!adds a type to the module, returning false on failure
+static bool add_type (PyObject *m, PyType_Spec *spec, PyTypeObject *&type, const char *name) {
+    type = (PyTypeObject*)PyType_FromSpec(spec);
+    if ( type == NULL )
+        return(false);
+    Py_INCREF(type);
+    if ( PyModule_AddObject(m, name, (PyObject*)type) != 0 ) {
+        Py_DECREF(type);
+        return(false);
+    }
+    return(true);
+}
+
+PyMODINIT_FUNC PyInit_richards (void) {
+
+    PyObject *m = PyModule_Create(&module_def);
+    if ( m == NULL )
+        return(NULL);
+    ViewType = (PyTypeObject*)PyType_FromSpec(&view_spec);
+    if ( (ViewType == NULL)
+      || !add_type(m, &settings_spec, SettingsType, "Settings")
+      || !add_type(m, &grid_spec, GridType, "Grid")
+      || !add_type(m, &richards_spec, RichardsType, "Richards") ) {
+        Py_DECREF(m);
+        return(NULL);
+    }
+    //arrays are memoryviews without NumPy
+    PyObject *np = PyImport_ImportModule("numpy");
+    if ( np ) {
+        asarray = PyObject_GetAttrString(np, "asarray");
+        Py_DECREF(np);
+    }
+    PyErr_Clear();
+    return(m);
+}
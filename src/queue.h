@@ -0,0 +1,95 @@
+#ifndef QUEUE_H_
+#define QUEUE_H_
+
+//! \file queue.h
+
+#include <atomic>
+#include <memory>
+
+//!bounded, lock-free queue for any number of producer and consumer threads
+/*!
+This is Dmitry Vyukov's bounded MPMC queue. Each cell carries a sequence number telling producers and consumers whether it's free or full for their current lap around the ring, so pushing and popping each take a single compare-and-swap on the shared position and never block. A full queue makes push() fail and an empty one makes pop() fail, leaving the caller to decide how to wait.
+*/
+template <class T>
+class Queue {
+
+public:
+
+    //!constructs an empty queue
+    /*!
+    \param[in] capacity minimum number of items the queue can hold, rounded up to a power of two
+    */
+    Queue (unsigned long capacity) {
+        unsigned long m = 2;
+        while ( m < capacity ) m *= 2;
+        mask = m - 1;
+        cells.reset(new Cell[m]);
+        for (unsigned long i=0; i<m; i++)
+            cells[i].seq.store(i, std::memory_order_relaxed);
+        head.store(0, std::memory_order_relaxed);
+        tail.store(0, std::memory_order_relaxed);
+    }
+
+    //!adds an item, returning false if the queue is full
+    bool push (const T &x) {
+        Cell *c;
+        unsigned long p = tail.load(std::memory_order_relaxed);
+        while ( true ) {
+            c = &cells[p & mask];
+            unsigned long seq = c->seq.load(std::memory_order_acquire);
+            long d = long(seq) - long(p);
+            if ( d == 0 ) {
+                if ( tail.compare_exchange_weak(p, p + 1, std::memory_order_relaxed) )
+                    break;
+            } else if ( d < 0 ) {
+                return(false);
+            } else {
+                p = tail.load(std::memory_order_relaxed);
+            }
+        }
+        c->data = x;
+        c->seq.store(p + 1, std::memory_order_release);
+        return(true);
+    }
+
+    //!removes the oldest item, returning false if the queue is empty
+    bool pop (T &x) {
+        Cell *c;
+        unsigned long p = head.load(std::memory_order_relaxed);
+        while ( true ) {
+            c = &cells[p & mask];
+            unsigned long seq = c->seq.load(std::memory_order_acquire);
+            long d = long(seq) - long(p + 1);
+            if ( d == 0 ) {
+                if ( head.compare_exchange_weak(p, p + 1, std::memory_order_relaxed) )
+                    break;
+            } else if ( d < 0 ) {
+                return(false);
+            } else {
+                p = head.load(std::memory_order_relaxed);
+            }
+        }
+        x = c->data;
+        c->seq.store(p + mask + 1, std::memory_order_release);
+        return(true);
+    }
+
+private:
+
+    //!slot in the ring
+    struct Cell {
+        std::atomic<unsigned long> seq;
+        T data;
+    };
+
+    //!ring of cells
+    std::unique_ptr<Cell[]> cells;
+    //!number of cells minus one
+    unsigned long mask;
+    //!position of the next pop, on its own cache line
+    alignas(64) std::atomic<unsigned long> head;
+    //!position of the next push, on its own cache line
+    alignas(64) std::atomic<unsigned long> tail;
+};
+
+#endif
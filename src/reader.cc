@@ -0,0 +1,193 @@
+//! \file reader.cc
+
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "reader.h"
+
+MappedFile::MappedFile (const std::string &fn, bool sequential) {
+
+    ok = false;
+    data = NULL;
+    size = 0;
+
+    int fd = open(fn.c_str(), O_RDONLY);
+    if ( fd < 0 )
+        return;
+    struct stat st;
+    if ( fstat(fd, &st) != 0 ) {
+        close(fd);
+        return;
+    }
+    size = st.st_size;
+    ok = true;
+    //empty files can't be mapped, but are still open
+    if ( size > 0 ) {
+        void *p = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if ( p == MAP_FAILED ) {
+            ok = false;
+            size = 0;
+        } else {
+            data = (unsigned char*)p;
+            if ( sequential ) {
+                madvise(p, size, MADV_SEQUENTIAL);
+                madvise(p, size, MADV_WILLNEED);
+            }
+        }
+    }
+    //the mapping stays valid without the descriptor
+    close(fd);
+}
+
+MappedFile::~MappedFile () {
+    if ( data != NULL )
+        munmap(data, size);
+}
+
+//------------------------------------------------------------------------------
+
+StoreReader::StoreReader (const std::string &fn) :
+    map (fn, false) {
+
+    if ( !map.is_open() ) {
+        printf("FAILURE: cannot open store file %s\n", fn.c_str());
+        exit(EXIT_FAILURE);
+    }
+    const unsigned char *d = map.get_data();
+    uint64_t len = map.get_size();
+    StoreHeader h;
+    if ( (len < sizeof(h)) || (memcmp(d, "RICHSTOR", 8) != 0) ) {
+        printf("FAILURE: %s is not a store file\n", fn.c_str());
+        exit(EXIT_FAILURE);
+    }
+    memcpy(&h, d, sizeof(h));
+
+    StoreRecord r;
+    if ( (h.index > 0) && (h.index + h.nrec*sizeof(r) <= len) ) {
+        //records from the index
+        for (uint64_t l=0; l<h.nrec; l++) {
+            memcpy(&r, d + h.index + l*sizeof(r), sizeof(r));
+            records[r.key].push_back(r);
+        }
+    } else {
+        //walk the records of an unclosed store, stopping at the first incomplete one
+        uint64_t pos = sizeof(h);
+        while ( pos + sizeof(r) <= len ) {
+            memcpy(&r, d + pos, sizeof(r));
+            if ( (r.offset != pos + sizeof(r)) || (r.offset + r.nbytes > len) )
+                break;
+            records[r.key].push_back(r);
+            pos = r.offset + r.nbytes;
+            if ( pos % STORE_ALIGN != 0 )
+                pos += STORE_ALIGN - pos % STORE_ALIGN;
+        }
+    }
+}
+
+std::vector<std::string> StoreReader::keys () {
+    std::vector<std::string> k;
+    std::map<std::string, std::vector<StoreRecord> >::iterator it;
+    for (it=records.begin(); it!=records.end(); it++)
+        k.push_back(it->first);
+    return(k);
+}
+
+bool StoreReader::read (const std::string &key, Series &s) {
+
+    std::map<std::string, std::vector<StoreRecord> >::iterator it = records.find(key);
+    if ( it == records.end() ) {
+        s.x = NULL;
+        s.m = 0;
+        return(false);
+    }
+    const std::vector<StoreRecord> &recs = it->second;
+    const unsigned char *d = map.get_data();
+
+    s.buf.clear();
+    if ( strcmp(recs[0].dtype, "|cmp") == 0 ) {
+        //compressed chunks are decompressed together, keeping columns in order
+        std::vector<unsigned char> cmp;
+        for (unsigned long l=0; l<recs.size(); l++)
+            cmp.insert(cmp.end(), d + recs[l].offset, d + recs[l].offset + recs[l].nbytes);
+        decompress_output(cmp.data(), cmp.size(), s);
+        return(true);
+    }
+    if ( strcmp(recs[0].dtype, "<f4") != 0 )
+        print_exit("only float outputs can be read from a store");
+    s.ncol = recs[0].ncol;
+    if ( recs.size() == 1 ) {
+        //in place
+        s.x = (const float*)(d + recs[0].offset);
+        s.m = recs[0].nbytes/sizeof(float);
+        return(true);
+    }
+    //chunks are concatenated along their rows
+    for (unsigned long l=0; l<recs.size(); l++) {
+        const float *x = (const float*)(d + recs[l].offset);
+        s.buf.insert(s.buf.end(), x, x + recs[l].nbytes/sizeof(float));
+    }
+    s.x = s.buf.data();
+    s.m = s.buf.size();
+    return(true);
+}
+
+//------------------------------------------------------------------------------
+
+void decompress_output (const unsigned char *in, unsigned long size, Series &s) {
+
+    //each column is split into blocks, one per chunk, written in order
+    std::vector< std::vector<float> > cols;
+    uint32_t ncol = 1, j;
+    unsigned long pos = 0;
+    while ( pos + COMPRESS_HEADER <= size ) {
+        std::vector<float> x;
+        pos = decompress_series(in, pos, x, ncol, j);
+        if ( cols.size() < ncol )
+            cols.resize(ncol);
+        cols[j].insert(cols[j].end(), x.begin(), x.end());
+    }
+    //columns one after another, as in an output file that wasn't spilled
+    s.ncol = ncol;
+    s.buf.clear();
+    for (unsigned long c=0; c<cols.size(); c++) {
+        if ( cols[c].size() != cols[0].size() )
+            print_exit("columns of a compressed output have different lengths");
+        s.buf.insert(s.buf.end(), cols[c].begin(), cols[c].end());
+    }
+    s.x = s.buf.data();
+    s.m = s.buf.size();
+}
+
+bool read_output (const std::string &dir, StoreReader *store, const std::string &key, Series &s) {
+
+    s.map.reset();
+    s.x = NULL;
+    s.m = 0;
+    if ( store )
+        return( store->read(key, s) );
+
+    std::string path = dir + "/" + key;
+    //compressed file
+    MappedFile *f = new MappedFile(path + ".cmp");
+    if ( f->is_open() ) {
+        decompress_output(f->get_data(), f->get_size(), s);
+        delete f;
+        return(true);
+    }
+    delete f;
+    //plain file, read in place
+    f = new MappedFile(path);
+    if ( !f->is_open() ) {
+        delete f;
+        return(false);
+    }
+    s.map.reset(f);
+    s.x = (const float*)f->get_data();
+    s.m = f->get_size()/sizeof(float);
+    s.ncol = 1;
+    s.buf.clear();
+    return(true);
+}
@@ -0,0 +1,120 @@
+#ifndef READER_H_
+#define READER_H_
+
+//! \file reader.h
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "io.h"
+#include "store.h"
+#include "compress.h"
+
+//!read-only memory map of a whole file
+class MappedFile {
+
+public:
+
+    //!maps a file, leaving the map empty if the file can't be opened
+    /*!
+    \param[in] fn path to the file
+    \param[in] sequential whether the file will be read front to back, so the kernel reads ahead aggressively
+    */
+    MappedFile (const std::string &fn, bool sequential=true);
+    //!unmaps the file
+    ~MappedFile ();
+
+    //!checks whether the file was mapped
+    bool is_open () { return(ok); }
+    //!gets the mapped bytes
+    const unsigned char *get_data () { return(data); }
+    //!gets the number of mapped bytes
+    unsigned long get_size () { return(size); }
+
+private:
+
+    MappedFile (const MappedFile &);
+    MappedFile &operator= (const MappedFile &);
+
+    //!whether the file was mapped
+    bool ok;
+    //!mapped bytes
+    unsigned char *data;
+    //!number of mapped bytes
+    unsigned long size;
+};
+
+//!float series read from an output, either pointing into a mapped file or holding decompressed values
+struct Series {
+    //!first value
+    const float *x;
+    //!number of values
+    unsigned long m;
+    //!number of columns if known, or 1, with values laid out as in the output's own file
+    unsigned long ncol;
+    //!values, if they had to be copied or decompressed
+    std::vector<float> buf;
+    //!mapping of the variable's own file, if it was read in place
+    std::unique_ptr<MappedFile> map;
+};
+
+//!read-only, memory-mapped view of a store file, shared by any number of threads
+/*!
+The records are taken from the index, or found by walking the file if the store wasn't closed. Float records that weren't spilled in chunks are read in place, without copying.
+*/
+class StoreReader {
+
+public:
+
+    //!maps a store file, quitting if it isn't a store
+    StoreReader (const std::string &fn);
+
+    //!checks whether the store has a key
+    bool has (const std::string &key) { return( records.count(key) > 0 ); }
+
+    //!gets all the keys, in order
+    std::vector<std::string> keys ();
+
+    //!gets all the records of a key, in the order they were written
+    const std::vector<StoreRecord> &get_records (const std::string &key) { return(records[key]); }
+
+    //!gets the mapped bytes of the store
+    const unsigned char *get_data () { return(map.get_data()); }
+
+    //!reads a float variable, concatenating chunks and decompressing if needed
+    /*!
+    \param[in] key record key
+    \param[out] s the variable's values
+    \return whether the key was found
+    */
+    bool read (const std::string &key, Series &s);
+
+private:
+
+    //!mapped store file
+    MappedFile map;
+    //!records of each key
+    std::map<std::string, std::vector<StoreRecord> > records;
+};
+
+//!decompresses the concatenated blocks of a compressed output
+/*!
+\param[in] in compressed bytes
+\param[in] size number of compressed bytes
+\param[out] s decompressed values, one column after another
+*/
+void decompress_output (const unsigned char *in, unsigned long size, Series &s);
+
+//!reads a float output from a store if one is given, or else from its plain or compressed file
+/*!
+\param[in] dir output directory
+\param[in] store store holding the sweep's output, or NULL
+\param[in] key output name, like "12_qbot"
+\param[out] s the output's values
+\return whether the output was found
+*/
+bool read_output (const std::string &dir, StoreReader *store, const std::string &key, Series &s);
+
+#endif
@@ -1,20 +1,62 @@
 //! \file richards.cc
 
+#include <algorithm>
+#include <unistd.h>
+
+#include "profile.h"
 #include "richards.h"
 
-Richards::Richards (Grid grid, Settings stgin) :
-    OdeSsp3 (grid.get_n()+1),
+Richards::Richards (const Grid &grid, const Settings &stgin) :
+    Richards (std::make_shared<const Grid>(grid), stgin) {}
+
+Richards::Richards (std::shared_ptr<const Grid> grid, const Settings &stgin) :
+    OdeSsp3 (grid->get_n() + 1 + (stgin.sens ? NSENS*grid->get_n() : 0)),
     stg (copy_settings(stgin)),
-    n     (grid.get_n()),
-    dep   (grid.get_dep()),
-    ze    (grid.get_ze()),
-    zc    (grid.get_zc()),
-    delz  (grid.get_delz()),
-    delze (grid.get_delze()),
-    vefac (grid.get_vefac()),
-    gefac (grid.get_gefac()) {
+    geom  (grid),
+    n     (geom->get_n()),
+    dep   (geom->get_dep()),
+    ze    (geom->get_ze()),
+    zc    (geom->get_zc()),
+    delz  (geom->get_delz()),
+    delze (geom->get_delze()),
+    vefac (geom->get_vefac()),
+    gefac (geom->get_gefac()),
+    poroc  (col.poroc),
+    poroe  (col.poroe),
+    Ksat   (col.Ksat),
+    psisat (col.psisat),
+    we     (col.we),
+    dpsidw (col.dpsidw),
+    dwdz   (col.dwdz),
+    K      (col.K),
+    D      (col.D),
+    q      (col.q) {
 
-    long i;
+    initialize();
+}
+
+void Richards::reset (const Settings &stgin) {
+
+    //the number of equations is fixed by the integrator's storage
+    if ( stgin.sens != stg.sens )
+        print_exit("a model can't be reset to settings that turn sensitivities on or off");
+    stg = copy_settings(stgin);
+    //integrator state, as the integrator is constructed
+    set_t(0.0);
+    set_dt(NAN);
+    nstep = 0;
+    neval = 0;
+    set_quiet(false);
+    //outputs of the previous trial
+    tsnap.clear();
+    ckptfn.clear();
+    solvedir.clear();
+    initialize();
+}
+
+void Richards::initialize () {
+
+    long i, k;
 
     //set the name of the object
     set_name("richards");
@@ -24,39 +66,92 @@ Richards::Richards (Grid grid, Settings stgin) :
     //------------------
     //physical variables
 
-    //porosity at cell centers
-    for (i=0; i<n; i++) poroc.push_back( f_poro(-zc[i], stg.poro) );
-    //porosity at cell edges
-    for (i=0; i<n+1; i++) poroe.push_back( f_poro(-ze[i], stg.poro) );
-    //saturated hydraulic conductivity at cell edges
-    for (i=0; i<n+1; i++) Ksat.push_back( f_Ksat(-ze[i], stg.g, stg.mu, stg.rho) );
-    //saturated matric head
-    for (i=0; i<n+1; i++) psisat.push_back( f_psisat(-ze[i]) );
-
-    //water fractions at cell edges
-    we.resize(n+1);
-    //derivative of psi w/r/t moisture
-    dpsidw.resize(n+1);
-    //derivative of moisture w/r/t z
-    dwdz.resize(n+1);
-    //hydraulic conductivity (unsaturated)
-    K.resize(n+1);
-    //diffusivity (K*d psi / d t)
-    D.resize(n+1, INFINITY);
-    //fluxes
-    q.resize(n+1);
+    init_column(col, stg.poro, stg.perm, stg.b, stg.wilt);
 
-    //storage vectors, if needed
-    if ( stg.qall ) qall.resize(n+1);
-    if ( stg.wall ) wall.resize(n);
+    //dual variables seeded with unit derivatives w/r/t each parameter
+    if ( stg.sens ) {
+        init_column(scol, dual(stg.poro, 3), dual(stg.perm, 0),
+                          dual(stg.b, 1),    dual(stg.wilt, 2));
+        wsens.resize(n);
+        dqbot.assign(NSENS, NAN);
+    }
 
     //find the approximate middle cell edge
     mididx = argclose(ze, -dep/2.0, n+1);
 
+    //tracker storage, with separate output files until a store is set
+    store = NULL;
+    trk.set_store(NULL);
+    setup_trackers();
+
+    //threads sharing the loops over the column, only if it's long enough to pay for handing them out
+    if ( (stg.colthreads > 1) && (n >= stg.colmin) ) {
+        if ( !team || (team->size() != stg.colthreads) )
+            team.reset(new Team(int(stg.colthreads)));
+        teamdt.resize(stg.colthreads);
+        teamidx.resize(stg.colthreads);
+    } else {
+        team.reset();
+    }
+
+    //nobody watching progress
+    progress = NULL;
+    //the wall clock budget starts now
+    twatch = wall_time();
+    nwatch = get_nstep();
+
+    //separate column for fluxes at sample times and at the end of solves
+    init_column(csamp, stg.poro, stg.perm, stg.b, stg.wilt);
+
+    //edges whose fluxes are reduced during solves
+    redidx.clear();
+    redidx.push_back(0);
+    redidx.push_back(n);
+    for (i=0; i<long(stg.probes.size()); i++)
+        redidx.push_back( argclose(ze, -stg.probes[i], n+1) );
+    qstage.resize(3*redidx.size());
+    met.qint.assign(redidx.size(), 0.0);
+    met.qmin.assign(redidx.size(), 0.0);
+    met.qmax.assign(redidx.size(), 0.0);
+    reducing = false;
+
+    //no steps limited yet
+    limit = LIMIT_DIFFUSION;
+    limedge = 0;
+    nlimit.assign(NLIMIT, 0);
+    nlimedge.assign(n+1, 0);
+
+    //periodic infiltration, or the forcing series, until a host model sets the forcing
+    forced = false;
+    forcewet = false;
+    if ( stg.forcing == "none" ) {
+        series.reset();
+    } else if ( !series || (series->path() != stg.forcing) ) {
+        series.reset(new Forcing(stg.forcing));
+    }
+    tauevap0 = stg.tauevap;
+    Levap0 = stg.Levap;
+
+    //not checkpointing, spinning up, or solving yet
+    ckptint = 0.0;
+    tckpt = 0.0;
+    nckpt = 0;
+    spinning = false;
+    tperiod = 0.0;
+    spincount = -1;
+    spinmrd = INFINITY;
+    spinord = 0;
+    solving = false;
+    resuming = false;
+    solvetint = 0.0;
+    solvensnap = 0;
+    solveisnap = 0;
+
     //-------------------------------------
     //discretization constants for stable dt
 
-    for (i=0; i<n+1; i++) dtcons.push_back( delze[i]*delze[i]/2.0 );
+    dtcons.resize(n+1);
+    for (i=0; i<n+1; i++) dtcons[i] = delze[i]*delze[i]/2.0;
 
     //------------------
     //initial condition
@@ -65,44 +160,94 @@ Richards::Richards (Grid grid, Settings stgin) :
     for (i=0; i<n; i++) set_sol(i, 0.999*poroc[i]);
     //time
     set_sol(n, 0.0);
+    //sensitivities of the water fractions, only the porosity is nonzero
+    if ( stg.sens )
+        for (k=0; k<NSENS; k++)
+            for (i=0; i<n; i++)
+                set_sol(n + 1 + k*n + i, 0.999*scol.poroc[i].d[k]);
 
 }
 
+template <class T>
+void Richards::init_column (Column<T> &c, T poro, T perm, T b, T wilt) {
+
+    long i;
+
+    //parameters
+    c.poro = poro;
+    c.perm = perm;
+    c.b = b;
+    c.wilt = wilt;
+
+    //static depth-varying quantities, sized once so a reset model refills them in place
+    c.poroc.resize(n);
+    c.poroe.resize(n+1);
+    c.Ksat.resize(n+1);
+    c.psisat.resize(n+1);
+    //porosity at cell centers
+    for (i=0; i<n; i++) c.poroc[i] = f_poro(-zc[i], poro);
+    //porosity at cell edges
+    for (i=0; i<n+1; i++) c.poroe[i] = f_poro(-ze[i], poro);
+    //saturated hydraulic conductivity at cell edges
+    for (i=0; i<n+1; i++) c.Ksat[i] = f_Ksat(-ze[i], perm, stg.g, stg.mu, stg.rho);
+    //saturated matric head
+    for (i=0; i<n+1; i++) c.psisat[i] = f_psisat<T>(-ze[i]);
+
+    //water fractions at cell edges
+    c.we.assign(n+1, T());
+    //derivative of psi w/r/t moisture
+    c.dpsidw.assign(n+1, T());
+    //derivative of moisture w/r/t z
+    c.dwdz.assign(n+1, T());
+    //hydraulic conductivity (unsaturated)
+    c.K.assign(n+1, T());
+    //diffusivity (K*d psi / d t)
+    c.D.assign(n+1, T(INFINITY));
+    //fluxes
+    c.q.assign(n+1, T());
+}
+
 //------------------------------------------------------------------------------
 //physical functions
 
-double Richards::f_poro (double depth, double poro) {
+template <class T>
+T Richards::f_poro (double depth, T poro) {
     (void)depth;
     return(
         poro
     );
 }
 
-double Richards::f_ksat (double depth, double perm) {
+template <class T>
+T Richards::f_ksat (double depth, T perm) {
     (void)depth;
     return(
         perm
     );
 }
 
-double Richards::f_Ksat (double depth, double g, double mu, double rho) {
-    return ( rho*g*f_ksat(depth, stg.perm)/mu );
+template <class T>
+T Richards::f_Ksat (double depth, T perm, double g, double mu, double rho) {
+    return ( rho*g*f_ksat(depth, perm)/mu );
 }
 
-double Richards::f_K (double w, double Ksat, double wsat, double b) {
+template <class T>
+T Richards::f_K (T w, T Ksat, T wsat, T b) {
     return(
         Ksat*pow(w/wsat, 2.0*b + 3.0)
     );
 }
 
-double Richards::f_psisat (double depth) {
+template <class T>
+T Richards::f_psisat (double depth) {
     (void)depth;
     return(
-        -0.2
+        T(-0.2)
     );
 }
 
-double Richards::f_dpsidw (double w, double psisat, double wsat, double b) {
+template <class T>
+T Richards::f_dpsidw (T w, T psisat, T wsat, T b) {
     return(
         -(b/wsat)*psisat*pow(w/wsat, -(b + 1))
     );
@@ -110,6 +255,16 @@ double Richards::f_dpsidw (double w, double psisat, double wsat, double b) {
 
 bool Richards::f_infil (double t) {
 
+    //forcing from a host model
+    if ( forced )
+        return(forcewet);
+    //observed forcing, whose evaporation scales hold with its wetness
+    if ( series ) {
+        const ForcingRecord &r = series->at(t);
+        stg.tauevap = (r.tauevap > 0) ? r.tauevap : tauevap0;
+        stg.Levap = (r.Levap > 0) ? r.Levap : Levap0;
+        return(r.wet);
+    }
     //bounds of next/current infiltration event
     double ta, tb;
     infil_times(t, &ta, &tb);
@@ -121,7 +276,8 @@ bool Richards::f_infil (double t) {
     return(false);
 }
 
-double Richards::f_w_bot (double poro) {
+template <class T>
+T Richards::f_w_bot (T poro) {
     return(
         poro
     );
@@ -130,6 +286,15 @@ double Richards::f_w_bot (double poro) {
 //------------------------------------------------------------------------------
 //ODE solver functions
 
+void Richards::set_forcing (bool wet, double tauevap, double Levap) {
+    forced = true;
+    forcewet = wet;
+    if ( tauevap > 0 )
+        stg.tauevap = tauevap;
+    if ( Levap > 0 )
+        stg.Levap = Levap;
+}
+
 void Richards::infil_times (double t, double *ta, double *tb) {
     //end of next infiltration event
     (*tb) = t - fmod(t, stg.infper) + stg.infper;
@@ -137,116 +302,444 @@ void Richards::infil_times (double t, double *ta, double *tb) {
     (*ta) = (*tb) - stg.infdur;
 }
 
-double Richards::f_q (double K, double dpsidw, double dwdz, double satl, double satr) {
+template <class T>
+T Richards::f_q (T K, T dpsidw, T dwdz, T satl, T satr, T wilt) {
 
-    double q = -K*dpsidw*dwdz - K;
+    T q = -K*dpsidw*dwdz - K;
 
     if ( q < 0 ) {
-        if ( (satl > 1) || (satr < stg.wilt) )
+        if ( (satl > 1) || (satr < wilt) )
             q = 0.0;
     } else if ( q > 0 ) {
-        if ( (satr > 1) || (satl < stg.wilt) )
+        if ( (satr > 1) || (satl < wilt) )
             q = 0.0;
     }
 
     return(q);
 }
 
-double Richards::f_dwdt (double qt, double qb, double delz) {
+template <class T>
+T Richards::f_dwdt (T qt, T qb, double delz) {
     return(
         (qt - qb)/delz
     );
 }
 
-void Richards::update_q (double *w, double t) {
+template <class T>
+void Richards::update_props (long i, Column<T> &c) {
+    c.K[i] = f_K(c.we[i], c.Ksat[i], c.poroe[i], c.b);
+    c.dpsidw[i] = f_dpsidw(c.we[i], c.psisat[i], c.poroe[i], c.b);
+    c.D[i] = c.K[i]*c.dpsidw[i];
+}
 
-    //index
-    long i;
+template <class T>
+void Richards::update_bot (const T *w, Column<T> &c) {
+    //water table saturation and gradient
+    c.we[0] = f_w_bot(c.poroe[0]);
+    c.dwdz[0] = (w[0] - c.we[0])/(delz[0]/2);
+    //hydraulic properties
+    update_props(0, c);
+    //water table flux
+    c.q[0] = f_q(c.K[0], c.dpsidw[0], c.dwdz[0], c.wilt, w[0]/c.poroc[0], c.wilt);
+}
+
+template <class T>
+void Richards::update_mid (const T *w, long i, Column<T> &c) {
+    //interpolated saturation and gradient
+    c.we[i] = vefac[i]*w[i] + (1.0 - vefac[i])*w[i-1];
+    c.dwdz[i] = gefac[i]*(w[i] - w[i-1]);
+    //hydraulic properties
+    update_props(i, c);
+    //cell-to-cell exchange
+    c.q[i] = f_q(c.K[i], c.dpsidw[i], c.dwdz[i], w[i-1]/c.poroc[i-1], w[i]/c.poroc[i-1], c.wilt);
+}
+
+template <class T>
+void Richards::update_top (const T *w, bool infil, Column<T> &c) {
+    //top value depends on infiltration flag
+    if ( infil ) c.we[n] = c.poroe[n];
+    c.dwdz[n] = (c.we[n] - w[n-1])/(delz[n-1]/2);
+    //hydraulic properties
+    update_props(n, c);
+    //surface infiltration/evaporation
+    if ( infil ) {
+        c.q[n] = f_q(c.K[n], c.dpsidw[n], c.dwdz[n], w[n-1]/c.poroc[n-1], c.wilt, c.wilt);
+    } else {
+        c.q[n] = stg.Levap*(w[n-1] - c.wilt*c.poroe[n])/stg.tauevap;
+    }
+}
+
+template <class T>
+void Richards::update_q (const T *w, double t, Column<T> &c) {
+
+    PROFILE_SCOPE(PHASE_UPDATE_Q);
     //infiltration flag
     bool infil = f_infil(t);
+    //bottom, interior, and top edges
+    update_bot(w, c);
+    for (long i=1; i<n; i++)
+        update_mid(w, i, c);
+    update_top(w, infil, c);
+}
+
+//the C interface updates the sample column directly, so the instance must be emitted even when every call here is inlined
+template void Richards::update_q<double> (const double *w, double t, Column<double> &c);
 
-    //----------------------------------------------
-    //cell edge saturations and saturation gradients
+void Richards::update_q (double *w, double t) {
 
-    //bottom
-    we[0] = f_w_bot(poroe[0]);
-    dwdz[0] = (w[0] - we[0])/(delz[0]/2);
-    //interior
-    for (i=1; i<n; i++) {
-        we[i] = vefac[i]*w[i] + (1.0 - vefac[i])*w[i-1];
-        dwdz[i] = gefac[i]*(w[i] - w[i-1]);
+    if ( !team ) {
+        update_q(w, t, col);
+        return;
     }
-    //top value depends on infiltration flag
-    infil ? we[n] = poroe[n] : NAN;
-    dwdz[n] = (we[n] - w[n-1])/(delz[n-1]/2);
+    PROFILE_SCOPE(PHASE_UPDATE_Q);
+    //infiltration flag
+    bool infil = f_infil(t);
+    //each thread takes a contiguous range of edges, the first and last holding the boundaries
+    team->run(n + 1, [&] (long i0, long i1, int) {
+        if ( i0 == 0 )
+            update_bot(w, col);
+        for (long i=std::max(i0, 1L); i<std::min(i1, n); i++)
+            update_mid(w, i, col);
+        if ( i1 == n + 1 )
+            update_top(w, infil, col);
+    });
+}
 
-    //------------------------------
-    //cell edge hydraulic properties
+void Richards::update_edges (const double *w, double t, const std::vector<long> &edges) {
 
-    for (i=0; i<n+1; i++) {
-        K[i] = f_K(we[i], Ksat[i], poroe[i], stg.b);
-        dpsidw[i] = f_dpsidw(we[i], psisat[i], poroe[i], stg.b);
-        D[i] = K[i]*dpsidw[i];
+    //infiltration flag
+    bool infil = f_infil(t);
+    //only the requested edges
+    long i;
+    for (unsigned long j=0; j<edges.size(); j++) {
+        i = edges[j];
+        if ( i == 0 ) {
+            update_bot(w, col);
+        } else if ( i < n ) {
+            update_mid(w, i, col);
+        } else {
+            update_top(w, infil, col);
+        }
     }
+}
 
-    //------
-    //fluxes
+void Richards::update_q_sens (double *solin) {
 
-    //water table
-    q[0] = f_q(K[0], dpsidw[0], dwdz[0], stg.wilt, w[0]/poroc[0]);
-    //cell-to-cell exchange
-    for (i=1; i<n; i++)
-        q[i] = f_q(K[i], dpsidw[i], dwdz[i], w[i-1]/poroc[i-1], w[i]/poroc[i-1]);
-    //surface infiltration/evaporation
-    if ( infil ) {
-        q[n] = f_q(K[n], dpsidw[n], dwdz[n], w[n-1]/poroc[n-1], stg.wilt);
-    } else {
-        q[n] = stg.Levap*(w[n-1] - stg.wilt*poroe[n])/stg.tauevap;
+    long i, k;
+    //gather water fractions and their sensitivities into dual numbers
+    for (i=0; i<n; i++) {
+        wsens[i].v = solin[i];
+        for (k=0; k<NSENS; k++)
+            wsens[i].d[k] = solin[n + 1 + k*n + i];
     }
+    //dual fluxes
+    update_q(wsens.data(), solin[n], scol);
 }
 
 void Richards::ode_fun (double *solin, double *fout) {
 
+    PROFILE_SCOPE(PHASE_ODE_FUN);
+    long i, k;
     //autonomous form for time
     fout[n] = 1.0;
-    //compute fluxes
-    update_q(solin, solin[n]);
-    //time derivatives of water fractions
-    for (long i=0; i<n; i++)
-        fout[i] = f_dwdt(q[i], q[i+1], delz[i]);
+    if ( stg.sens ) {
+        //compute dual fluxes
+        update_q_sens(solin);
+        //keep the plain column consistent for step size selection and snaps, as the stages of a plain integration leave it
+        for (i=0; i<n+1; i++) {
+            we[i] = val(scol.we[i]);
+            dpsidw[i] = val(scol.dpsidw[i]);
+            dwdz[i] = val(scol.dwdz[i]);
+            K[i] = val(scol.K[i]);
+            D[i] = val(scol.D[i]);
+            q[i] = val(scol.q[i]);
+        }
+        //time derivatives of water fractions and their sensitivities
+        dual dwdt;
+        for (i=0; i<n; i++) {
+            dwdt = f_dwdt(scol.q[i], scol.q[i+1], delz[i]);
+            fout[i] = dwdt.v;
+            for (k=0; k<NSENS; k++)
+                fout[n + 1 + k*n + i] = dwdt.d[k];
+        }
+    } else {
+        //compute fluxes
+        update_q(solin, solin[n]);
+        //time derivatives of water fractions
+        if ( team ) {
+            team->run(n, [&] (long i0, long i1, int) {
+                for (long i=i0; i<i1; i++)
+                    fout[i] = f_dwdt(q[i], q[i+1], delz[i]);
+            });
+        } else {
+            for (i=0; i<n; i++)
+                fout[i] = f_dwdt(q[i], q[i+1], delz[i]);
+        }
+    }
+    //capture fluxes at each of the three stages of a step for the reductions
+    if ( reducing && (istage < 3) ) {
+        long m = long(redidx.size());
+        for (i=0; i<m; i++)
+            qstage[istage*m + i] = q[redidx[i]];
+        istage++;
+    }
 }
 
 double Richards::dt_adapt () {
 
+    PROFILE_SCOPE(PHASE_DT_ADAPT);
+    //every step is adapted once
+    if ( progress )
+        progress->step();
     //compute fraction of maximum stable time step
     double dt = INFINITY;
     double dtmax;
-    for (long i=0; i<n+1; i++) {
-        dtmax = dtcons[i]/D[i];
-        if ( (dtmax < dt) && !std::isnan(dtmax) )
-            dt = dtmax;
+    long imin = 0;
+    if ( team ) {
+        //minimum of each thread's edges, then of the threads in order, which finds the same edge as the serial loop
+        teamdt.assign(team->size(), INFINITY);
+        team->run(n + 1, [&] (long i0, long i1, int tid) {
+            double d = INFINITY, x;
+            long j = i0;
+            for (long i=i0; i<i1; i++) {
+                x = dtcons[i]/D[i];
+                if ( (x < d) && !std::isnan(x) ) {
+                    d = x;
+                    j = i;
+                }
+            }
+            teamdt[tid] = d;
+            teamidx[tid] = j;
+        });
+        for (int k=0; k<team->size(); k++) {
+            if ( teamdt[k] < dt ) {
+                dt = teamdt[k];
+                imin = teamidx[k];
+            }
+        }
+    } else {
+        for (long i=0; i<n+1; i++) {
+            dtmax = dtcons[i]/D[i];
+            if ( (dtmax < dt) && !std::isnan(dtmax) ) {
+                dt = dtmax;
+                imin = i;
+            }
+        }
     }
     dt *= stg.dtfac;
-    //infiltration management
-    double t, ta, tb;
-    t = get_sol(n);
-    infil_times(get_sol(n), &ta, &tb);
-    if ( (t >= ta) && (t <= tb) ) {
-        if ( dt > stg.infdur/1000 )
-            dt = stg.infdur/1000;
-        if ( t + dt > tb )
+    if ( stg.watchdog )
+        watch(dt);
+    limit = LIMIT_DIFFUSION;
+    limedge = imin;
+    dt = dt_forcing(dt, get_sol(n));
+    //attribute the step to whichever constraint bounded it last
+    nlimit[limit]++;
+    if ( limit == LIMIT_DIFFUSION )
+        nlimedge[limedge]++;
+
+    //spinup solves have no extras, so they're checkpointed here, between steps
+    if ( spinning && !ckptfn.empty() )
+        checkpoint();
+
+    return(dt);
+}
+
+double Richards::dt_forcing (double dt, double t) {
+
+    //infiltration management, unless a host model sets the forcing
+    double ta, tb;
+    if ( !forced && series ) {
+        //steps end on the series' boundaries, and are capped like periodic ones within wet records
+        bool wet = f_infil(t);
+        tb = series->next();
+        if ( wet ) {
+            //records without both ends are capped like periodic events
+            double dtwet = std::isinf(series->span()) ? stg.infdur/1000 : series->span()/1000;
+            if ( dt > dtwet ) {
+                dt = dtwet;
+                limit = LIMIT_INFIL;
+            }
+        }
+        if ( t + dt > tb ) {
             dt = tb - t;
-    } else {
-        if ( t + dt > ta )
-            dt = ta - t;
+            limit = LIMIT_EVENT;
+        }
+    } else if ( !forced ) {
+        infil_times(t, &ta, &tb);
+        if ( (t >= ta) && (t <= tb) ) {
+            if ( dt > stg.infdur/1000 ) {
+                dt = stg.infdur/1000;
+                limit = LIMIT_INFIL;
+            }
+            if ( t + dt > tb ) {
+                dt = tb - t;
+                limit = LIMIT_EVENT;
+            }
+        } else {
+            if ( t + dt > ta ) {
+                dt = ta - t;
+                limit = LIMIT_EVENT;
+            }
+        }
     }
     //evaporation management
-    if ( dt > stg.tauevap*delz[0]/stg.Levap )
+    if ( dt > stg.tauevap*delz[0]/stg.Levap ) {
         dt = 0.99*stg.tauevap*delz[0]/stg.Levap;
+        limit = LIMIT_EVAP;
+    }
 
     return( dt );
 }
 
+const char *failure_name (Failure reason) {
+    const char *names[NFAIL] = {"wall_time", "step_budget", "spinup_budget", "nonfinite", "stalled_dt"};
+    return(names[reason]);
+}
+
+Abandoned::Abandoned (Failure reason, double t, unsigned long nstep) :
+    std::runtime_error(std::string("abandoned (") + failure_name(reason) + ") @ t = "
+        + std::to_string(t) + " after " + std::to_string(nstep) + " steps"),
+    reason (reason),
+    t (t),
+    nstep (nstep) {}
+
+void Richards::watch (double dtstab) {
+
+    //the cheap checks are made every step
+    if ( (stg.maxstep > 0) && (get_nstep() >= (unsigned long)stg.maxstep) )
+        throw Abandoned(FAIL_STEPS, get_t(), get_nstep());
+    //diffusivities aren't computed before the first step
+    if ( (get_nstep() > 0) && (dtstab < stg.dtmin) )
+        throw Abandoned(FAIL_STALL, get_t(), get_nstep());
+    //the solution and the clock every 64 steps, since nonfinite values don't go away and budgets are long,
+    //counted from the last check because tiled windows take several steps at a time
+    if ( get_nstep() - nwatch < 64 )
+        return;
+    nwatch = get_nstep();
+    double s = 0.0;
+    for (long i=0; i<n; i++) s += get_sol(i);
+    if ( !std::isfinite(s) )
+        throw Abandoned(FAIL_NONFINITE, get_t(), get_nstep());
+    if ( (stg.maxwall > 0) && (wall_time() - twatch > stg.maxwall) )
+        throw Abandoned(FAIL_WALL, get_t(), get_nstep());
+}
+
+void Richards::tile_fun (const double *w, bool infil, long a, long b, double *dwdt) {
+
+    //edges with a cell on each side, and the boundaries if they're in range
+    long e0 = (a == 0) ? 0 : a + 1,
+         e1 = (b == n) ? n : b - 1;
+    for (long i=e0; i<=e1; i++) {
+        if ( i == 0 ) {
+            update_bot(w, col);
+        } else if ( i < n ) {
+            update_mid(w, i, col);
+        } else {
+            update_top(w, infil, col);
+        }
+    }
+    //cells with both edges
+    for (long i=e0; i<e1; i++)
+        dwdt[i] = f_dwdt(q[i], q[i+1], delz[i]);
+}
+
+void Richards::advance_tiled (double tend) {
+
+    long i, s, k, nwin;
+    double *w = get_sol();
+    tileu.resize(n);
+    tiles.resize(n);
+    tilek1.resize(n);
+    tilek2.resize(n);
+    tilek3.resize(n);
+    tilew.resize(n);
+    tileD.resize(n + 1);
+    tileq.resize(n + 1);
+    //steps of a window, the time variable at each, and the infiltration flags of their stages
+    std::vector<double> wdt(stg.tilek), wts(stg.tilek);
+    std::vector<bool> winf(3*stg.tilek);
+
+    while ( t < tend ) {
+        //step size of the window, conservative if it's set by diffusion
+        double dt = dt_adapt();
+        long lim = limit;
+        if ( (lim == LIMIT_DIFFUSION) && (stg.tilek > 1) )
+            dt *= stg.tilefac;
+        //steps of the window, ending at the end of the integration or before crossing an event boundary
+        double tt = t, ts = w[n];
+        for (nwin=0; nwin<stg.tilek; nwin++) {
+            double d = dt;
+            if ( nwin > 0 ) {
+                //the first step of an integration has zero length, as the integrator's does, because no diffusivities are known yet, and isn't repeated
+                if ( (dt == 0) || (dt_forcing(dt, ts) < dt) )
+                    break;
+                limit = lim;
+            }
+            if ( tt + d > tend )
+                d = tend - tt;
+            wdt[nwin] = d;
+            wts[nwin] = ts;
+            winf[3*nwin] = f_infil(ts);
+            winf[3*nwin+1] = f_infil(ts + d*1.0);
+            winf[3*nwin+2] = f_infil(ts + d*(1.0 + 1.0)/4);
+            ts += d*(1.0 + 1.0 + 4*1.0)/6;
+            tt += d;
+            if ( tt >= tend ) {
+                nwin++;
+                break;
+            }
+        }
+
+        //blocks of cells, each carried through the window with the neighbors it needs
+        for (long c0=0; c0<n; c0+=stg.tileb) {
+            long c1 = std::min(c0 + stg.tileb, n),
+                 a = std::max(c0 - 3*nwin, 0L),
+                 b = std::min(c1 + 3*nwin, n);
+            for (i=a; i<b; i++) tileu[i] = w[i];
+            for (s=0; s<nwin; s++) {
+                double d = wdt[s];
+                //each stage's derivatives are valid one cell further in from each interior side
+                long a1 = a + (a > 0), b1 = b - (b < n),
+                     a2 = a1 + (a1 > 0), b2 = b1 - (b1 < n),
+                     a3 = a2 + (a2 > 0), b3 = b2 - (b2 < n);
+                tile_fun(tileu.data(), winf[3*s], a, b, tilek1.data());
+                for (i=a1; i<b1; i++) tiles[i] = tileu[i] + d*tilek1[i];
+                tile_fun(tiles.data(), winf[3*s+1], a1, b1, tilek2.data());
+                for (i=a2; i<b2; i++) tiles[i] = tileu[i] + d*(tilek1[i] + tilek2[i])/4;
+                tile_fun(tiles.data(), winf[3*s+2], a2, b2, tilek3.data());
+                for (i=a3; i<b3; i++) tileu[i] += d*(tilek1[i] + tilek2[i] + 4*tilek3[i])/6;
+                a = a3;
+                b = b3;
+            }
+            for (i=c0; i<c1; i++) tilew[i] = tileu[i];
+            //the last stage found the block's own edges, before the next block overwrites some of them
+            for (i=c0; i<=c1; i++) {
+                tileD[i] = D[i];
+                tileq[i] = q[i];
+            }
+        }
+
+        //the window's end state, time, and counts, as if each step were taken by the integrator
+        for (i=0; i<n; i++) w[i] = tilew[i];
+        for (i=0; i<=n; i++) {
+            D[i] = tileD[i];
+            q[i] = tileq[i];
+        }
+        for (s=0; s<nwin; s++) {
+            w[n] += wdt[s]*(1.0 + 1.0 + 4*1.0)/6;
+            t += wdt[s];
+        }
+        nstep += nwin;
+        neval += 3*nwin;
+        //the first step of the window was counted by dt_adapt()
+        nlimit[lim] += nwin - 1;
+        if ( lim == LIMIT_DIFFUSION )
+            nlimedge[limedge] += nwin - 1;
+        if ( progress )
+            for (k=1; k<nwin; k++) progress->step();
+    }
+}
+
 void Richards::steady (double atol, unsigned long ntol) {
 
     //index
@@ -257,8 +750,10 @@ void Richards::steady (double atol, unsigned long ntol) {
     double dt = INFINITY;
     //alias the solution array
     double *w = get_sol();
+    //number of equations, including any sensitivities
+    long neq = long(get_neq());
     //storage for time derivatives, initially at inf
-    double *dwdt = new double[n+1];
+    double *dwdt = new double[neq];
     for (i=0; i<n; i++) dwdt[i] = INFINITY;
 
     //integrate until dwdt is small enough or too many steps are taken
@@ -267,153 +762,635 @@ void Richards::steady (double atol, unsigned long ntol) {
         dt = 0.75*dt_adapt();
         for (i=0; i<n; i++)
             w[i] += dt*dwdt[i];
+        for (i=n+1; i<neq; i++)
+            w[i] += dt*dwdt[i];
         count++;
     }
 
     delete [] dwdt;
 }
 
-void Richards::spinup (double rtol, bool quiet) {
+void Richards::spinup (double rtol, bool quiet, long nmin) {
 
     long i;
+    //thrown rather than quitting, because the model may be embedded in another program
+    if ( series && !forced )
+        throw std::runtime_error("a model forced by a series can't be spun up, because spinups need the periodic forcing");
     if ( !quiet ) {
         printf("  max rel dif requirement is %g\n", rtol);
         printf("    PERIODS |  MAX REL DIF \n");
         printf("    ------- | -------------\n");
     }
-    //integrate over a single infiltration period to get started
-    solve_adaptive(stg.infper, stg.infper/1e12, false);
-    //store the bottom boundary flux
-    std::vector<double> q_a(n, INFINITY);
-    std::vector<double> q_b;
-    for (i=0; i<n; i++) q_b.push_back(q[i]);
-    //maximum relative difference
-    double mrd = maxreldif(q_a, q_b, n);
-    //continue integrating over infiltration periods until the qb is stable
-    long count = 0;
-    long ord = floor(log10(mrd));
-    while ( (mrd > rtol) || (count <= 5) ) {
-        solve_adaptive(stg.infper, stg.infper/1e12, false);
-        count++;
-        for (i=0; i<n; i++) {
-            q_a[i] = q_b[i];
-            q_b[i] = q[i];
+    //start, unless continuing a spinup restored from a checkpoint
+    if ( !spinning ) {
+        spinning = true;
+        spincount = -1;
+        spinq.assign(n, INFINITY);
+        tperiod = get_t();
+    }
+    std::vector<double> q_b(n);
+    while ( true ) {
+        //integrate over an infiltration period, or the rest of one interrupted by a checkpoint
+        {
+            PROFILE_SCOPE(PHASE_SPINUP_PERIOD);
+            if ( (stg.tilek > 0) && !stg.sens ) {
+                advance_tiled(tperiod + stg.infper);
+            } else if ( get_t() == tperiod ) {
+                solve_adaptive(stg.infper, stg.infper/1e12, false);
+            } else {
+                solve_adaptive(tperiod + stg.infper - get_t(), dt_adapt(), false);
+            }
+        }
+        tperiod = get_t();
+        //maximum relative difference from the fluxes of the previous period
+        for (i=0; i<n; i++) q_b[i] = q[i];
+        spinmrd = maxreldif(spinq, q_b, n);
+        spinq.swap(q_b);
+        spincount++;
+        if ( progress )
+            progress->period();
+        if ( spincount == 0 ) {
+            spinord = floor(log10(spinmrd));
+        } else if ( (!quiet) && (floor(log10(spinmrd)) != spinord) ) {
+            printf("    %-7li | %-11g\n", spincount, spinmrd);
+            spinord = floor(log10(spinmrd));
         }
-        mrd = maxreldif(q_a, q_b, n);
-        if ( (!quiet) && (floor(log10(mrd)) != ord ) )  {
-            printf("    %-7li | %-11g\n", count, mrd);
-            ord = floor(log10(mrd));
+        //continue integrating over infiltration periods until the fluxes are stable
+        if ( !((spinmrd > rtol) || (spincount < nmin)) )
+            break;
+        //or until the budget of periods runs out
+        if ( stg.watchdog && (stg.maxper > 0) && (spincount + 1 >= stg.maxper) ) {
+            spinning = false;
+            throw Abandoned(FAIL_PERIODS, get_t(), get_nstep());
         }
     }
+    spinning = false;
+}
+
+void Richards::solve (double tint, double dt0, unsigned long nsnap, const std::string &dirout) {
+
+    if ( !solving ) {
+        solving = true;
+        solvetint = tint;
+        solvensnap = nsnap;
+        solveisnap = 0;
+        solvedir = dirout;
+        if ( nsnap > 0 ) {
+            solve_adaptive(tint, dt0, nsnap, dirout.c_str());
+        } else {
+            solve_adaptive(tint, dt0, true);
+        }
+    } else {
+        //continue a solve restored from a checkpoint, snap by snap, without starting it over
+        add_outputs();
+        reducing = true;
+        istage = 0;
+        resuming = true;
+        unsigned long m = (solvensnap > 0) ? solvensnap : 1;
+        double tend;
+        for (unsigned long k=solveisnap; k<m; k++) {
+            tend = met.t0 + (k + 1)*solvetint/m;
+            if ( get_t() < tend )
+                solve_adaptive(tend - get_t(), dt_adapt(), true);
+            if ( solvensnap > 0 )
+                after_snap(solvedir, k, get_t());
+        }
+        resuming = false;
+        after_solve();
+    }
+    solving = false;
 }
 
 //------------------------------------------------------------------------------
 //extras
 
 void Richards::before_solve () {
-    std::string name = get_name();
-    std::string dirout = get_dirout();
+    //nothing starts over when continuing a solve
+    if ( resuming )
+        return;
+    //reset the reductions
+    met.t0 = get_t();
+    met.t1 = met.t0;
+    met.stor0 = storage();
+    met.dstor = 0.0;
+    met.balance = 0.0;
+    for (unsigned long j=0; j<redidx.size(); j++) {
+        met.qint[j] = 0.0;
+        met.qmin[j] = INFINITY;
+        met.qmax[j] = -INFINITY;
+    }
+    tred = met.t0;
+    istage = 0;
+    reducing = true;
+    //reset the bottom flux sensitivity integral
+    if ( stg.sens ) {
+        tsolve = get_sol(n);
+        tsens = tsolve;
+        qbotint = 0.0;
+        update_q_sens(get_sol());
+        qbotsens = scol.q[0];
+    }
+    std::string dirout = outdir();
+    add_outputs();
+    //start sampling trackers at fixed intervals from the initial state
+    if ( dense ) {
+        nprev = 1;
+        tprev1 = get_t();
+        for (long i=0; i<n; i++) wprev1[i] = get_sol(i);
+        trk.set_tnext(tprev1);
+        float *row = trk.record(tprev1);
+        if ( row )
+            fill_row(row, tprev1, get_sol(), csamp);
+    }
     if ( stg.poroc )
-        write_array(dirout + "/" + name + "_poroc", poroc);
+        output(dirout, "poroc", poroc);
     if ( stg.poroe )
-        write_array(dirout + "/" + name + "_poroe", poroe);
+        output(dirout, "poroe", poroe);
     if ( stg.Ksat )
-        write_array(dirout + "/" + name + "_Ksat", Ksat);
+        output(dirout, "Ksat", Ksat);
     if ( stg.psisat )
-        write_array(dirout + "/" + name + "_psisat", psisat);
+        output(dirout, "psisat", psisat);
 }
 
-void Richards::after_snap (std::string dirout, long isnap, double tin) {
+void Richards::add_outputs () {
+    //tracker output files, which are created now if spilling to disk,
+    //or record keys if writing to a store
     std::string name = get_name();
+    std::string base = store ? name : outdir() + "/" + name;
+    if ( !trk.has_outputs() ) {
+        if ( jt >= 0 )
+            trk.add_output(base + "_t", jt);
+        if ( jqtop >= 0 )
+            trk.add_output(base + "_qtop", jqtop);
+        if ( jqmid >= 0 )
+            trk.add_output(base + "_qmid", jqmid);
+        if ( jqbot >= 0 )
+            trk.add_output(base + "_qbot", jqbot);
+        //spilled profiles are appended time-major, unless compressed
+        bool spilled = (stg.nchunk > 0) && !stg.compress;
+        if ( jqall >= 0 )
+            trk.add_output(base + (spilled ? "_qallt" : "_qall"), jqall, n+1);
+        if ( jwall >= 0 )
+            trk.add_output(base + (spilled ? "_wallt" : "_wall"), jwall, n);
+        if ( jinfil >= 0 )
+            trk.add_output(base + "_infil", jinfil);
+        if ( jlimit >= 0 )
+            trk.add_output(base + "_limit", jlimit);
+    }
+}
+
+void Richards::after_snap (std::string dirout, long isnap, double tin) {
+    PROFILE_SCOPE(PHASE_SNAP);
     std::string i = int_to_string(isnap);
     if ( stg.we )
-        write_array(dirout + "/" + name + "_we_" + i, we);
+        output(dirout, "we_" + i, we);
     if ( stg.dpsidw )
-        write_array(dirout + "/" + name + "_dpsidw_" + i, dpsidw);
+        output(dirout, "dpsidw_" + i, dpsidw);
     if ( stg.dwdz )
-        write_array(dirout + "/" + name + "_dwdz_" + i, dwdz);
+        output(dirout, "dwdz_" + i, dwdz);
     if ( stg.K )
-        write_array(dirout + "/" + name + "_K_" + i, K);
+        output(dirout, "K_" + i, K);
     if ( stg.D )
-        write_array(dirout + "/" + name + "_D_" + i, D);
+        output(dirout, "D_" + i, D);
     if ( stg.w )
-        write_array(dirout + "/" + name + "_w_" + i, get_sol(), n);
+        output(dirout, "w_" + i, get_sol(), n);
     if ( stg.q )
-        write_array(dirout + "/" + name + "_q_" + i, q);
+        output(dirout, "q_" + i, q);
     if ( stg.tsnap )
         tsnap.push_back( tin );
+    if ( solving )
+        solveisnap = isnap + 1;
 }
 
-void Richards::q_updated (double t, bool *qup) {
+void Richards::setup_trackers () {
 
-    if ( !(*qup) ) {
-        update_q(get_sol(), t);
-        *qup = true;
+    //lay out the columns of a tracker row
+    long width = 0;
+    jt = stg.t ? width++ : -1;
+    jqtop = stg.qtop ? width++ : -1;
+    jqmid = stg.qmid ? width++ : -1;
+    jqbot = stg.qbot ? width++ : -1;
+    jinfil = stg.infil ? width++ : -1;
+    jlimit = stg.limit ? width++ : -1;
+    jqall = -1;
+    if ( stg.qall ) {
+        jqall = width;
+        width += n + 1;
+    }
+    jwall = -1;
+    if ( stg.wall ) {
+        jwall = width;
+        width += n;
+    }
+    //at most nmaxout rows are ever stored, unless they're spilled to disk
+    trk.setup(width, stg.nmaxout, stg.dtout, stg.nchunk);
+    trk.set_compression(stg.compress, stg.ctol);
+    //sampling at fixed intervals interpolates between steps, evaluating
+    //fluxes in a separate column so the step size control is undisturbed,
+    //and only if rows can be stored, since the tracker advances the sample times as it stores them
+    dense = (width > 0) && (stg.dtout > 0) && ((stg.nmaxout > 0) || (stg.nchunk > 0));
+    if ( dense ) {
+        wprev0.resize(n);
+        wprev1.resize(n);
+        wint.resize(n);
     }
 }
 
-void Richards::after_step (double tin) {
+void Richards::fill_row (float *row, double tin, const double *w, Column<double> &c) {
 
-    //q updated flag
-    bool qup = false;
+    //fluxes, only if any are tracked
+    if ( ((jqtop >= 0) || (jqmid >= 0) || (jqbot >= 0) || (jqall >= 0)) )
+        update_q(w, tin, c);
 
-    if ( stg.t )
-        t.push_back( tin );
-    if ( stg.qtop ) {
-        q_updated(tin, &qup);
-        qtop.push_back( q.back() );
+    if ( jt >= 0 )
+        row[jt] = tin;
+    if ( jqtop >= 0 )
+        row[jqtop] = c.q[n];
+    if ( jqmid >= 0 )
+        row[jqmid] = c.q[mididx];
+    if ( jqbot >= 0 )
+        row[jqbot] = c.q[0];
+    if ( jqall >= 0 )
+        for (long i=0; i<n+1; i++) row[jqall+i] = c.q[i];
+    if ( jwall >= 0 )
+        for (long i=0; i<n; i++) row[jwall+i] = w[i];
+    if ( jinfil >= 0 )
+        row[jinfil] = f_infil(tin);
+    if ( jlimit >= 0 )
+        row[jlimit] = (limit == LIMIT_DIFFUSION) ? limedge : -limit;
+}
+
+void Richards::interpolate (double ts, double tin, double *w) {
+
+    long i;
+    const double *w2 = get_sol();
+    double t0 = tprev0, t1 = tprev1, t2 = tin;
+    double l0, l1, l2;
+
+    if ( t2 == t1 ) {
+        //zero length step
+        for (i=0; i<n; i++) w[i] = w2[i];
+    } else if ( (nprev < 2) || (t1 == t0) || (f_infil(0.5*(t0 + t1)) != f_infil(0.5*(t1 + t2))) ) {
+        //linear across a change in surface forcing, where the solution has a kink
+        l2 = (ts - t1)/(t2 - t1);
+        for (i=0; i<n; i++) w[i] = (1.0 - l2)*wprev1[i] + l2*w2[i];
+    } else {
+        //quadratic through the last three steps
+        l0 = (ts - t1)*(ts - t2)/((t0 - t1)*(t0 - t2));
+        l1 = (ts - t0)*(ts - t2)/((t1 - t0)*(t1 - t2));
+        l2 = (ts - t0)*(ts - t1)/((t2 - t0)*(t2 - t1));
+        for (i=0; i<n; i++) w[i] = l0*wprev0[i] + l1*wprev1[i] + l2*w2[i];
     }
-    if ( stg.qmid ) {
-        q_updated(tin, &qup);
-        qmid.push_back( q[mididx] );
+}
+
+void Richards::after_step (double tin) {
+
+    PROFILE_SCOPE(PHASE_AFTER_STEP);
+    //integrate fluxes with the weights of the integrator's own stages, so the
+    //integrals are exactly consistent with the change in water storage
+    if ( istage == 3 ) {
+        double dt = tin - tred;
+        long m = long(redidx.size());
+        for (long j=0; j<m; j++) {
+            met.qint[j] += dt*(qstage[j] + qstage[m+j] + 4*qstage[2*m+j])/6;
+            //the first stage is evaluated at the start of the step
+            if ( qstage[j] < met.qmin[j] ) met.qmin[j] = qstage[j];
+            if ( qstage[j] > met.qmax[j] ) met.qmax[j] = qstage[j];
+        }
     }
-    if ( stg.qbot ) {
-        q_updated(tin, &qup);
-        qbot.push_back( q[0] );
+    tred = tin;
+    istage = 0;
+
+    //integrate the bottom flux and its sensitivities with the trapezoid rule, leaving the plain column alone so sensitivities don't change the trajectory
+    if ( stg.sens ) {
+        update_q_sens(get_sol());
+        qbotint += 0.5*(qbotsens + scol.q[0])*(tin - tsens);
+        qbotsens = scol.q[0];
+        tsens = tin;
     }
-    if ( stg.qall ) {
-        q_updated(tin, &qup);
-        for (long i=0; i<n+1; i++) qall[i].push_back( q[i] );
+
+    if ( dense ) {
+        //record every sample time passed by this step
+        double ts;
+        float *row;
+        while ( trk.get_tnext() <= tin ) {
+            ts = trk.get_tnext();
+            interpolate(ts, tin, wint.data());
+            row = trk.record(ts);
+            if ( row )
+                fill_row(row, ts, wint.data(), csamp);
+        }
+        //shift the step history
+        wprev0.swap(wprev1);
+        for (long i=0; i<n; i++) wprev1[i] = get_sol(i);
+        tprev0 = tprev1;
+        tprev1 = tin;
+        nprev++;
+    } else {
+        //record the step, if it's sampled
+        float *row = trk.record(tin);
+        if ( row )
+            fill_row(row, tin, get_sol(), col);
     }
-    if ( stg.wall )
-        for (long i=0; i<n; i++) wall[i].push_back( get_sol(i) );
-    if ( stg.infil )
-        infil.push_back( f_infil(tin) );
+
+    //everything about the step is settled, so it's a consistent place to checkpoint
+    if ( solving && !ckptfn.empty() )
+        checkpoint();
 }
 
 void Richards::after_solve () {
 
-    std::string name = get_name();
-    std::string dirout = get_dirout();
-    std::vector<float> all, temp;
+    //a continued solve is only finished once
+    if ( resuming )
+        return;
+    //finish the reductions with the fluxes of the final state
+    reducing = false;
+    update_q(get_sol(), get_t(), csamp);
+    double qend;
+    for (unsigned long j=0; j<redidx.size(); j++) {
+        qend = csamp.q[redidx[j]];
+        if ( qend < met.qmin[j] ) met.qmin[j] = qend;
+        if ( qend > met.qmax[j] ) met.qmax[j] = qend;
+    }
+    met.t1 = get_t();
+    met.dstor = storage() - met.stor0;
+    met.balance = met.dstor - (met.qint[0] - met.qint[1]);
+
+    std::string dirout = outdir();
+    if ( stg.sens ) {
+        for (long k=0; k<NSENS; k++)
+            dqbot[k] = qbotint.d[k]/(tsens - tsolve);
+        output(dirout, "dqbot", dqbot);
+    }
     if ( stg.tsnap )
-        write_array(dirout + "/" + name + "_tsnap", tsnap);
-    if ( stg.t )
-        write_array(dirout + "/" + name + "_t", subsample(t, stg.nmaxout));
-    if ( stg.qtop )
-        write_array(dirout + "/" + name + "_qtop", subsample(qtop, stg.nmaxout));
-    if ( stg.qmid )
-        write_array(dirout + "/" + name + "_qmid", subsample(qmid, stg.nmaxout));
-    if ( stg.qbot )
-        write_array(dirout + "/" + name + "_qbot", subsample(qbot, stg.nmaxout));
-    if ( stg.qall ) {
-        all.clear();
-        for (long i=0; i<n+1; i++) {
-            temp = subsample(qall[i], stg.nmaxout);
-            for (long unsigned j=0; j<temp.size(); j++)
-                all.push_back(temp[j]);
-        }
-        write_array(dirout + "/" + name + "_qall", all);
+        output(dirout, "tsnap", tsnap);
+    //always keep the final step
+    double tend = get_t();
+    if ( !trk.is_last(tend) ) {
+        float *row = trk.record(tend, true);
+        if ( row )
+            fill_row(row, tend, get_sol(), dense ? csamp : col);
     }
-    if ( stg.wall ) {
-        all.clear();
-        for (long i=0; i<n; i++) {
-            temp = subsample(wall[i], stg.nmaxout);
-            for (long unsigned j=0; j<temp.size(); j++)
-                all.push_back(temp[j]);
-        }
-        write_array(dirout + "/" + name + "_wall", all);
+    trk.flush();
+}
+
+double Richards::storage () {
+    double s = 0.0;
+    for (long i=0; i<n; i++) s += get_sol(i)*delz[i];
+    return(s);
+}
+
+std::string Richards::metrics_header (const Settings &s) {
+    std::vector<std::string> names;
+    names.push_back("qbot");
+    names.push_back("qtop");
+    char buf[64];
+    for (unsigned long j=0; j<s.probes.size(); j++) {
+        snprintf(buf, sizeof(buf), "q%g", s.probes[j]);
+        names.push_back(buf);
+    }
+    std::string h = "t0,t1";
+    for (unsigned long j=0; j<names.size(); j++)
+        h += "," + names[j] + "_mean," + names[j] + "_int," + names[j] + "_min," + names[j] + "_max";
+    h += ",dstor,balance";
+    return(h);
+}
+
+std::string Richards::metrics_row () {
+    char buf[128];
+    double dur = met.t1 - met.t0;
+    snprintf(buf, sizeof(buf), "%.10g,%.10g", met.t0, met.t1);
+    std::string r = buf;
+    for (unsigned long j=0; j<redidx.size(); j++) {
+        snprintf(buf, sizeof(buf), ",%.8e,%.8e,%.8e,%.8e",
+            met.qint[j]/dur, met.qint[j], met.qmin[j], met.qmax[j]);
+        r += buf;
     }
-    if ( stg.infil )
-        write_array(dirout + "/" + name + "_infil", subsample(infil, stg.nmaxout));
+    snprintf(buf, sizeof(buf), ",%.8e,%.8e", met.dstor, met.balance);
+    r += buf;
+    return(r);
 }
+
+void Richards::print_limits () {
+    const char *names[NLIMIT] = {"diffusion", "infiltration cap", "infiltration event", "evaporation"};
+    unsigned long total = 0, ndiff = nlimit[LIMIT_DIFFUSION];
+    for (long k=0; k<NLIMIT; k++) total += nlimit[k];
+    if ( total == 0 )
+        return;
+    printf("  steps bounded by each constraint:\n");
+    for (long k=0; k<NLIMIT; k++)
+        printf("    %-18s | %6.2f %%\n", names[k], 100.0*nlimit[k]/total);
+    //edges bounding the most diffusion-limited steps
+    std::vector<long> idx(n+1);
+    for (long i=0; i<n+1; i++) idx[i] = i;
+    std::sort(idx.begin(), idx.end(), [this] (long a, long b) { return(nlimedge[a] > nlimedge[b]); });
+    for (long j=0; (j<3) && (j<n+1) && (nlimedge[idx[j]] > 0); j++)
+        printf("      edge %-4li (z = %7.3f m) bounds %6.2f %% of diffusion-limited steps\n",
+            idx[j], ze[idx[j]], 100.0*nlimedge[idx[j]]/ndiff);
+}
+
+//------------------------------------------------------------------------------
+//checkpoints
+
+void Richards::set_checkpoint (const std::string &fn, double interval) {
+    ckptfn = fn;
+    ckptint = interval;
+    tckpt = wall_time();
+    nckpt = get_nstep();
+}
+
+void Richards::checkpoint () {
+    bool term = terminate_requested();
+    //the clock is only read every 1000 steps, counted from the last reading because tiled windows take several steps at a time
+    if ( !term ) {
+        if ( (ckptint <= 0) || (get_nstep() - nckpt < 1000) )
+            return;
+        nckpt = get_nstep();
+        if ( wall_time() - tckpt < ckptint )
+            return;
+    }
+    save_checkpoint();
+    tckpt = wall_time();
+    if ( term )
+        throw Terminated();
+}
+
+bool Richards::save_checkpoint () {
+
+    //write a temporary file and rename it, so a checkpoint is never incomplete
+    std::string tmp = ckptfn + ".tmp";
+    check_file_write(tmp.c_str());
+    FILE *f = fopen(tmp.c_str(), "wb");
+
+    //identification
+    fwrite(CKPT_MAGIC, 1, 8, f);
+    put_value(f, uint64_t(CKPT_VERSION));
+    put_value(f, hash_settings(stg));
+    put_value(f, n);
+    put_value(f, get_neq());
+    //integrator state, with the diffusivities that set the next time step
+    put_value(f, t);
+    put_value(f, dt);
+    put_value(f, nstep);
+    put_value(f, neval);
+    fwrite(get_sol(), sizeof(double), get_neq(), f);
+    put_vector(f, D);
+    //edge water fractions, since the surface keeps its value between infiltration events
+    put_vector(f, we);
+    put_vector(f, csamp.we);
+    put_vector(f, scol.we);
+    //spinup progress
+    put_value(f, spinning);
+    put_value(f, tperiod);
+    put_value(f, spincount);
+    put_vector(f, spinq);
+    put_value(f, spinmrd);
+    put_value(f, spinord);
+    //solve progress
+    put_value(f, solving);
+    put_value(f, solvetint);
+    put_value(f, solvensnap);
+    put_value(f, solveisnap);
+    put_string(f, solvedir);
+    put_vector(f, tsnap);
+    //reductions
+    put_value(f, met.t0);
+    put_value(f, met.stor0);
+    put_vector(f, met.qint);
+    put_vector(f, met.qmin);
+    put_vector(f, met.qmax);
+    put_value(f, tred);
+    //step limits
+    put_vector(f, nlimit);
+    put_vector(f, nlimedge);
+    //sensitivity integrals
+    put_value(f, qbotint);
+    put_value(f, qbotsens);
+    put_value(f, tsens);
+    put_value(f, tsolve);
+    //step history for interpolated tracker samples
+    put_value(f, nprev);
+    put_value(f, tprev0);
+    put_value(f, tprev1);
+    put_vector(f, wprev0);
+    put_vector(f, wprev1);
+    //trackers
+    trk.save(f);
+    //store contents if in memory, or the length of a store file
+    long kind = (store == NULL) ? 0 : (store->in_memory() ? 1 : 2);
+    put_value(f, kind);
+    if ( kind == 1 )
+        store->save(f);
+    if ( kind == 2 )
+        put_value(f, store->size());
+
+    //only a checkpoint that's completely on disk replaces the previous one, so a full disk loses
+    //the progress since the last checkpoint instead of the checkpoint itself
+    bool ok = (ferror(f) == 0) && (fflush(f) == 0) && (fsync(fileno(f)) == 0);
+    ok = (fclose(f) == 0) && ok;
+    if ( !ok ) {
+        remove(tmp.c_str());
+        printf("  cannot write checkpoint file %s, keeping the previous one\n", ckptfn.c_str());
+        return(false);
+    }
+    if ( rename(tmp.c_str(), ckptfn.c_str()) != 0 ) {
+        printf("FAILURE: cannot write checkpoint file %s\n", ckptfn.c_str());
+        exit(EXIT_FAILURE);
+    }
+    return(true);
+}
+
+bool Richards::load_checkpoint (const std::string &fn) {
+
+    FILE *f = fopen(fn.c_str(), "rb");
+    if ( f == NULL )
+        return(false);
+
+    //identification
+    char magic[8];
+    uint64_t version, hash, neq;
+    long n_;
+    if ( (fread(magic, 1, 8, f) != 8) || (memcmp(magic, CKPT_MAGIC, 8) != 0) ) {
+        printf("FAILURE: %s is not a checkpoint file\n", fn.c_str());
+        exit(EXIT_FAILURE);
+    }
+    get_value(f, version);
+    get_value(f, hash);
+    get_value(f, n_);
+    get_value(f, neq);
+    if ( (version != CKPT_VERSION) || (hash != hash_settings(stg)) || (n_ != n) || (neq != get_neq()) ) {
+        printf("FAILURE: checkpoint %s was written with different settings, remove it to start over\n", fn.c_str());
+        exit(EXIT_FAILURE);
+    }
+    //integrator state
+    get_value(f, t);
+    get_value(f, dt);
+    get_value(f, nstep);
+    get_value(f, neval);
+    if ( fread(get_sol(), sizeof(double), neq, f) != neq )
+        print_exit("checkpoint file ended unexpectedly");
+    get_vector(f, D);
+    //edge water fractions
+    get_vector(f, we);
+    get_vector(f, csamp.we);
+    get_vector(f, scol.we);
+    //spinup progress
+    get_value(f, spinning);
+    get_value(f, tperiod);
+    get_value(f, spincount);
+    get_vector(f, spinq);
+    get_value(f, spinmrd);
+    get_value(f, spinord);
+    //solve progress
+    get_value(f, solving);
+    get_value(f, solvetint);
+    get_value(f, solvensnap);
+    get_value(f, solveisnap);
+    get_string(f, solvedir);
+    get_vector(f, tsnap);
+    //reductions
+    get_value(f, met.t0);
+    get_value(f, met.stor0);
+    get_vector(f, met.qint);
+    get_vector(f, met.qmin);
+    get_vector(f, met.qmax);
+    get_value(f, tred);
+    //step limits
+    get_vector(f, nlimit);
+    get_vector(f, nlimedge);
+    //sensitivity integrals
+    get_value(f, qbotint);
+    get_value(f, qbotsens);
+    get_value(f, tsens);
+    get_value(f, tsolve);
+    //step history for interpolated tracker samples
+    get_value(f, nprev);
+    get_value(f, tprev0);
+    get_value(f, tprev1);
+    get_vector(f, wprev0);
+    get_vector(f, wprev1);
+    //trackers
+    trk.load(f);
+    //store contents, or the length to cut a store file back to
+    long kind, kind_ = (store == NULL) ? 0 : (store->in_memory() ? 1 : 2);
+    uint64_t size;
+    get_value(f, kind);
+    if ( kind != kind_ )
+        print_exit("checkpoint was written with a different kind of store");
+    if ( kind == 1 )
+        store->load(f);
+    if ( kind == 2 ) {
+        get_value(f, size);
+        store->truncate(size);
+    }
+
+    fclose(f);
+    return(true);
+}
+
+//------------------------------------------------------------------------------
+//kernels for plain numbers, instantiated for callers in other files like the benchmarks
+
+template double Richards::f_K<double> (double w, double Ksat, double wsat, double b);
+template double Richards::f_dpsidw<double> (double w, double psisat, double wsat, double b);
+template double Richards::f_q<double> (double K, double dpsidw, double dwdz, double satl, double satr, double wilt);
@@ -9,6 +9,7 @@ This is a model for solving the richards equation for unsaturated groundwater fl
 + The model uses a nonuniform, finite-volume grid. The surface cell is the smallest, with larger cells at depth.
 + The particular ratio of cell depths can be controlled and a maximum cell depth can be set.
 + The model is set up to use a fully saturated bottom boundary and a top boundary that goes through cycles of full saturation and full dryness. The cycle is meant to simulate periodic wetting events and the amount of water that penetrates to the bottom boundary for different cycle properties and physical parameters.
++ Instead of the cycle, the top boundary can follow observed precipitation and evaporation, read from the file given by the `forcing` setting. The file is streamed in chunks, so multi-year records don't have to fit in memory (see forcing.h).
 + There are three different `main` programs that generate three different executables.
     1. `main.cc` is compiled into `richards.exe`, which integrates the model without any cycling. This program is most useful for testing. The `scripts/plot_out.py` program plots the results generated by theis program.
     2. `main_periodic.cc` is compiled into `richards_periodic.exe`, which spins up the model with cyclical surface wetting, then integrates over a single cycle and writes results. The `scripts/plot_period.py` script is meant to plot the results of this program.
@@ -27,6 +28,10 @@ What is a settings file? An example should be included in the repository as `set
 
 To compile the model, edit the first four variables in the Makefile, then run `make`. The model runs on top of ODE solvers from [libode](https://github.com/wordsworthgroup/libode), which must be downloaded and compiled first.
 
+`make python` builds a Python extension module into `bin`, importable as `richards`, with `Settings`, `Grid` and `Richards` classes and a `decompress_block` function decoding compressed tracker outputs, which scripts/compress.py uses. The model's solution, fluxes, conductivities and diffusivities are NumPy arrays viewing the model's own memory, the tracker's rows are copied, and integrations release the GIL, so models can be integrated on separate Python threads. The module needs libode to be compiled with `-fPIC`.
+
+`richards_server.exe` keeps running and answers trial requests, read from stdin or from clients of a unix domain socket given as the second argument. Each request line holds an identifier and `key=value` overrides of the settings file, and is answered with the trial's row of metrics as soon as it finishes. Repeated trials are answered from a cache, and new trials start their spinups from the nearest state already spun up, so exploring a parameter space interactively doesn't pay for a cold start every time. A `shutdown` line stops the server.
+
 After things are compiled, a quick test would consist of:
 \code{sh}
 ./bin/richards_periodic.exe settings.txt out
@@ -39,17 +44,142 @@ cd ..
 #include <cmath>
 #include <cstdio>
 #include <string>
+#include <memory>
 #include <vector>
 #include <iostream>
+#include <stdexcept>
 
 #include "io.h"
 #include "grid.h"
 #include "util.h"
 #include "settings.h"
+#include "tracker.h"
+#include "store.h"
+#include "checkpoint.h"
+#include "telemetry.h"
+#include "team.h"
+#include "forcing.h"
+#include "dual.h"
 
 //header file for ODE integrator class
 #include "ode_ssp_3.h"
 
+//!number of parameters carried by the sensitivity integration (perm, b, wilt, poro)
+#define NSENS 4
+
+//!dual number type used for the sensitivity integration
+typedef Dual<NSENS> dual;
+
+//!depth-varying model variables and soil parameters, templated on the scalar type
+/*!
+The model keeps a `Column<double>` for ordinary integration. When sensitivities are requested it also keeps a `Column<dual>`, whose entries carry derivatives with respect to the parameters `perm`, `b`, `wilt`, and `poro`, in that order.
+*/
+template <class T>
+struct Column {
+
+    //!porosity
+    T poro;
+    //!permeability (m^2)
+    T perm;
+    //!Brooks-Corey parameter
+    T b;
+    //!wilting saturation as fraction of porosity
+    T wilt;
+
+    //!porosity at cell centers (maximum saturation fraction)
+    std::vector<T> poroc;
+    //!porosity at cell edges
+    std::vector<T> poroe;
+    //!saturated hydraulic conductivity over depth (m/s)
+    std::vector<T> Ksat;
+    //!saturated matric head (m)
+    std::vector<T> psisat;
+
+    //!water fractions at cell edges
+    std::vector<T> we;
+    //!derivative of psi w/r/t moisture
+    std::vector<T> dpsidw;
+    //!derivative of moisture w/r/t z
+    std::vector<T> dwdz;
+    //!hydraulic conductivity (unsaturated)
+    std::vector<T> K;
+    //!diffusivity (K*d psi /dt)
+    std::vector<T> D;
+    //!fluxes
+    std::vector<T> q;
+};
+
+//!reductions accumulated over the most recent solve
+/*!
+Fluxes are reduced at a list of cell edges: the bottom edge, the top edge, and then an edge near each of the probe depths in the settings.
+*/
+struct Metrics {
+    //!start time of the solve (s)
+    double t0;
+    //!end time of the solve (s)
+    double t1;
+    //!time integrals of the fluxes at the reduced edges (m)
+    std::vector<double> qint;
+    //!minimum fluxes at the reduced edges (m/s)
+    std::vector<double> qmin;
+    //!maximum fluxes at the reduced edges (m/s)
+    std::vector<double> qmax;
+    //!water stored in the column at the start of the solve (m)
+    double stor0;
+    //!change in water stored in the column over the solve (m)
+    double dstor;
+    //!storage change minus the net integrated inflow, which should be near zero (m)
+    double balance;
+};
+
+//!constraints that can bound a time step, chosen by dt_adapt()
+enum StepLimit {
+    //!diffusive stability at a cell edge
+    LIMIT_DIFFUSION,
+    //!resolution of an infiltration event, a thousandth of its duration
+    LIMIT_INFIL,
+    //!landing on the start or end of an infiltration event
+    LIMIT_EVENT,
+    //!surface evaporation
+    LIMIT_EVAP,
+    //!number of constraints
+    NLIMIT
+};
+
+//!reasons the watchdog abandons an integration
+enum Failure {
+    //!the wall clock budget ran out
+    FAIL_WALL,
+    //!the step budget ran out
+    FAIL_STEPS,
+    //!the spinup didn't converge within its budget of periods
+    FAIL_PERIODS,
+    //!the solution isn't finite
+    FAIL_NONFINITE,
+    //!the stable time step collapsed below its minimum
+    FAIL_STALL,
+    //!number of reasons
+    NFAIL
+};
+
+//!short names of the watchdog's reasons, for results tables
+const char *failure_name (Failure reason);
+
+//!thrown out of an integration abandoned by the watchdog
+/*!
+Like a Terminated, it's thrown between steps and caught by the drivers, which record the reason instead of waiting on a trial that won't finish. It derives from std::runtime_error, so callers catching any exception also report it.
+*/
+struct Abandoned : public std::runtime_error {
+    //!why the integration was abandoned
+    Failure reason;
+    //!model time when it was abandoned
+    double t;
+    //!steps taken when it was abandoned
+    unsigned long nstep;
+    //!sets up the exception and its message
+    Abandoned (Failure reason, double t, unsigned long nstep);
+};
+
 //!the main model class
 class Richards : public OdeSsp3 {
 
@@ -57,10 +187,24 @@ public:
 
     //!constructs
     /*!
-    \param[in] grid a Grid object defining the model domain and discretization
+    \param[in] grid a Grid object defining the model domain and discretization, copied once into the model's own shared geometry
+    \param[in] stgin a Settings object defining model settings and configuration
+    */
+    Richards (const Grid &grid, const Settings &stgin);
+
+    //!constructs on a geometry shared with other models, which only read it
+    /*!
+    \param[in] grid shared Grid object defining the model domain and discretization
+    \param[in] stgin a Settings object defining model settings and configuration
+    */
+    Richards (std::shared_ptr<const Grid> grid, const Settings &stgin);
+
+    //!returns the model to the state of a newly constructed one with new settings, reusing its memory
+    /*!
+    The grid is kept, and so is the number of equations, so the new settings must agree with the old ones on whether sensitivities are integrated. Outputs, stores, progress counters, and checkpoints are all dropped, as for a new model, and have to be set again. A batch of short trials can reuse one model per thread this way, instead of allocating and filling a new one for every trial.
     \param[in] stgin a Settings object defining model settings and configuration
     */
-    Richards (Grid grid, Settings stgin);
+    void reset (const Settings &stgin);
 
     //!settings container
     Settings stg;
@@ -68,102 +212,300 @@ public:
     //--------------
     //grid variables
 
+    //!geometry, shared read-only by every model on the same grid
+    std::shared_ptr<const Grid> geom;
     //!number of cells
     const long n;
     //!length/depth of domain (m)
     const double dep;
     //!cell edge coordinates (m)
-    const std::vector<double> ze;
+    const std::vector<double> &ze;
     //!cell center coordinates (m)
-    const std::vector<double> zc;
+    const std::vector<double> &zc;
     //!cell width (m)
-    const std::vector<double> delz;
+    const std::vector<double> &delz;
     //!cell widths used for stability calculations (m)
-    const std::vector<double> delze;
+    const std::vector<double> &delze;
     //!factors for cell edge values
-    const std::vector<double> vefac;
+    const std::vector<double> &vefac;
     //!factors for cell edge gradients
-    const std::vector<double> gefac;
+    const std::vector<double> &gefac;
     //!constants for finding maximum stable time step
     std::vector<double> dtcons;
 
     //------------------
     //physical variables
 
+    //!depth-varying variables of the column
+    Column<double> col;
+
     //static depth-varying quantities
 
     //!porosity at cell centers (maximum saturation fraction)
-    std::vector<double> poroc;
+    std::vector<double> &poroc;
     //!porosity at cell edges
-    std::vector<double> poroe;
+    std::vector<double> &poroe;
     //!saturated hydraulic conductivity over depth (m/s)
-    std::vector<double> Ksat;
+    std::vector<double> &Ksat;
     //!saturated matric head (m)
-    std::vector<double> psisat;
+    std::vector<double> &psisat;
 
     //dynamic, depth-varying quantities
 
     //!water fractions at cell edges
-    std::vector<double> we;
+    std::vector<double> &we;
     //!derivative of psi w/r/t moisture
-    std::vector<double> dpsidw;
+    std::vector<double> &dpsidw;
     //!derivative of moisture w/r/t z
-    std::vector<double> dwdz;
+    std::vector<double> &dwdz;
     //!hydraulic conductivity (unsaturated)
-    std::vector<double> K;
+    std::vector<double> &K;
     //!diffusivity (K*d psi /dt)
-    std::vector<double> D;
+    std::vector<double> &D;
     //!fluxes
-    std::vector<double> q;
+    std::vector<double> &q;
+
+    //-------------
+    //sensitivities
+
+    //!depth-varying variables carrying parameter derivatives, if sensitivities are on
+    Column<dual> scol;
+    //!work array of dual water fractions
+    std::vector<dual> wsens;
+    //!bottom flux with derivatives at the most recent step
+    dual qbotsens;
+    //!time integral of the bottom flux with derivatives over the current solve
+    dual qbotint;
+    //!time of the most recent dual bottom flux
+    double tsens;
+    //!start time of the current solve
+    double tsolve;
+    //!cycle-mean bottom flux derivatives w/r/t perm, b, wilt, and poro after a solve
+    std::vector<double> dqbot;
 
     //--------
     //trackers
 
-    //!time tracker
-    std::vector<float> t;
     //!snapshot times
     std::vector<float> tsnap;
-    //!top boundary flux
-    std::vector<float> qtop;
-    //!middle boundary flux
-    std::vector<float> qmid;
     //!index of approximate middle edge
     unsigned long mididx;
-    //!bottom boundary flux
-    std::vector<float> qbot;
-    //!whether to track ALL fluxes
-    std::vector< std::vector<float> > qall;
-    //!whether to track ALL water fractions
-    std::vector< std::vector<float> > wall;
-    //!infiltration flag
-    std::vector<float> infil;
+    //!bounded storage for all the variables tracked at every step
+    Tracker trk;
+    //!store receiving all output, or NULL to write a file for each output
+    Store *store;
+    //!progress counters of a batch sweep, advanced by every step and spinup period, or NULL
+    ThreadProgress *progress;
+    //!tracker column of step times, or -1 if not tracked
+    long jt;
+    //!tracker column of the top boundary flux, or -1 if not tracked
+    long jqtop;
+    //!tracker column of the middle boundary flux, or -1 if not tracked
+    long jqmid;
+    //!tracker column of the bottom boundary flux, or -1 if not tracked
+    long jqbot;
+    //!first of n+1 tracker columns of all fluxes, or -1 if not tracked
+    long jqall;
+    //!first of n tracker columns of all water fractions, or -1 if not tracked
+    long jwall;
+    //!tracker column of the infiltration flag, or -1 if not tracked
+    long jinfil;
+    //!tracker column of the step limit, the edge for diffusion or minus the StepLimit otherwise, or -1 if not tracked
+    long jlimit;
+    //!whether trackers are sampled at fixed intervals, interpolating between steps
+    bool dense;
+    //!column used to evaluate fluxes at sample times and at the end of solves
+    Column<double> csamp;
+    //!water fractions two steps back
+    std::vector<double> wprev0;
+    //!water fractions one step back
+    std::vector<double> wprev1;
+    //!interpolated water fractions
+    std::vector<double> wint;
+    //!time two steps back
+    double tprev0;
+    //!time one step back
+    double tprev1;
+    //!number of steps in the history since the solve began
+    long nprev;
+
+    //----------
+    //reductions
+
+    //!cell edges whose fluxes are reduced, the bottom, top, and then probe edges
+    std::vector<long> redidx;
+    //!fluxes at the reduced edges for each stage of the current step
+    std::vector<double> qstage;
+    //!number of stages of the current step captured so far
+    long istage;
+    //!whether ode_fun and after_step are accumulating reductions
+    bool reducing;
+    //!time of the most recent reduced step
+    double tred;
+    //!reductions over the most recent solve
+    Metrics met;
+
+    //-----------
+    //step limits
+
+    //!constraint bounding the most recent step, a StepLimit
+    long limit;
+    //!edge bounding the most recent step, if limited by diffusion
+    long limedge;
+    //!number of steps bounded by each constraint, since the model was created
+    std::vector<unsigned long> nlimit;
+    //!number of steps bounded by diffusion at each edge, since the model was created
+    std::vector<unsigned long> nlimedge;
+
+    //-------------------------
+    //intra-column parallelism
+
+    //!team sharing the loops over the column, or NULL to run them serially
+    std::unique_ptr<Team> team;
+    //!smallest stable time step found by each thread of the team
+    std::vector<double> teamdt;
+    //!edge of each thread's smallest stable time step
+    std::vector<long> teamidx;
+
+    //----------------
+    //temporal tiling
+
+    //!water fractions of the blocks, each advanced in place through a window of steps
+    std::vector<double> tileu;
+    //!stage water fractions of the blocks
+    std::vector<double> tiles;
+    //!first stage derivatives of the blocks
+    std::vector<double> tilek1;
+    //!second stage derivatives of the blocks
+    std::vector<double> tilek2;
+    //!third stage derivatives of the blocks
+    std::vector<double> tilek3;
+    //!water fractions at the end of a window
+    std::vector<double> tilew;
+    //!diffusivities of each block's own edges at the last stage of a window
+    std::vector<double> tileD;
+    //!fluxes of each block's own edges at the last stage of a window
+    std::vector<double> tileq;
+
+    //!integrates without extras, advancing cache-sized blocks of cells through windows of several steps
+    /*!
+    Each window takes up to `tilek` steps of one size, the step chosen by dt_adapt() at the start of the window and shrunk by `tilefac` if diffusion bounds it, so it stays stable while the diffusivities change over the window. Windows end early at infiltration event boundaries and at the end of the integration, so those are landed on as in solve_adaptive(). Within a window, each block of `tileb` cells is copied with enough neighboring cells to advance it through every stage of every step, three cells per step on each side, and only its own cells are kept, so its whole working set stays in cache instead of every stage streaming every array of the column. The arithmetic is the integrator's own. Blocks overwrite their neighbors' edges in the shared column as they go, so the diffusivities and fluxes of each block's own edges at the last stage are set aside and restored once every block is done, leaving the column as the integrator's last stage would for the next window's step size and the spinup's convergence check. Windows of one step therefore reproduce solve_adaptive() exactly, for any block size.
+    \param[in] tend time to integrate to (s)
+    */
+    void advance_tiled (double tend);
+
+    //!computes the derivatives of the cells whose fluxes can be found from water fractions over a range of cells
+    /*!
+    \param[in] w water fractions, valid over [a,b)
+    \param[in] infil infiltration flag
+    \param[in] a first valid cell
+    \param[in] b end of valid cells
+    \param[out] dwdt derivatives, over [a,b) shrunk by one cell on any side that isn't a boundary of the column
+    */
+    void tile_fun (const double *w, bool infil, long a, long b, double *dwdt);
+
+    //-----------
+    //watchdog
+
+    //!wall clock time the model was created, or the watchdog last restarted
+    double twatch;
+    //!step count at the last check of the solution and the clock, since tiled windows take several steps between checks
+    unsigned long nwatch;
+
+    //!checks the budgets, the solution, and the stable time step, throwing an Abandoned if any fail
+    /*!
+    \param[in] dtstab stable time step, before it's bounded by the forcing
+    */
+    void watch (double dtstab);
+
+    //-----------
+    //checkpoints
+
+    //!checkpoint file, or empty if not checkpointing
+    std::string ckptfn;
+    //!wall clock time between periodic checkpoints (s), or zero to only checkpoint on SIGTERM
+    double ckptint;
+    //!wall clock time of the most recent checkpoint, or of setting the checkpoint file
+    double tckpt;
+    //!step count when the clock was last read for periodic checkpoints
+    unsigned long nckpt;
+    //!whether spinup() is in progress
+    bool spinning;
+    //!start time of the current spinup period
+    double tperiod;
+    //!number of spinup periods completed after the first, or -1 during the first
+    long spincount;
+    //!fluxes at the end of the previous spinup period
+    std::vector<double> spinq;
+    //!maximum relative flux difference between the last two spinup periods
+    double spinmrd;
+    //!order of magnitude of the last printed spinup difference
+    long spinord;
+    //!whether solve() is in progress
+    bool solving;
+    //!whether a solve restored from a checkpoint is being continued, so before_solve() and after_solve() are skipped
+    bool resuming;
+    //!duration of the current solve
+    double solvetint;
+    //!number of snaps of the current solve
+    unsigned long solvensnap;
+    //!number of snaps already taken in the current solve
+    unsigned long solveisnap;
+    //!output directory of the current solve
+    std::string solvedir;
 
     //------------------
     //physical functions
 
     //!computes porosity as a function of depth (-)
-    double f_poro (double depth, double poro);
+    template <class T> T f_poro (double depth, T poro);
 
     //!computes saturated permeability (m^2)
-    double f_ksat (double depth, double perm);
+    template <class T> T f_ksat (double depth, T perm);
 
     //!computes saturated hydraulic conductivity (m/s)
-    double f_Ksat (double depth, double g, double mu, double rho);
+    template <class T> T f_Ksat (double depth, T perm, double g, double mu, double rho);
 
     //!computes Brooks-Corey hydraulic conductivity (m/s)
-    double f_K (double w, double Ksat, double wsat, double b);
+    template <class T> T f_K (T w, T Ksat, T wsat, T b);
 
     //!computes the saturation matric head (m)
-    double f_psisat (double depth);
+    template <class T> T f_psisat (double depth);
 
     //!computes derivative of Brooks-Corey matric head w/r/t water fraction (-)
-    double f_dpsidw (double w, double psisat, double wsat, double b);
+    template <class T> T f_dpsidw (T w, T psisat, T wsat, T b);
 
-    //!infiltration flag
+    //!infiltration flag, which also sets the evaporation scales of the forcing series at t, if there is one
     bool f_infil (double t);
 
+    //!sets the surface forcing explicitly, replacing the periodic infiltration schedule
+    /*!
+    The forcing holds until it's set again, as when a host model couples the column to its own surface at every coupling step.
+    \param[in] wet whether the surface is saturated, or else evaporating
+    \param[in] tauevap evaporation time scale (s), or zero to keep the current one
+    \param[in] Levap evaporation length scale (m), or zero to keep the current one
+    */
+    void set_forcing (bool wet, double tauevap=0.0, double Levap=0.0);
+
+    //!whether the surface forcing was set explicitly
+    bool forced;
+    //!whether the surface is saturated, if the forcing was set explicitly
+    bool forcewet;
+    //!observed forcing replacing the periodic infiltration, or NULL, unless the forcing was set explicitly
+    std::unique_ptr<Forcing> series;
+    //!evaporation time scale of the settings, for records of the series that don't set one (s)
+    double tauevap0;
+    //!evaporation length scale of the settings, for records of the series that don't set one (m)
+    double Levap0;
+
     //!bottom boundary condition
-    double f_w_bot (double poro);
+    template <class T> T f_w_bot (T poro);
+
+    //!fills the static variables of a column and sizes its dynamic variables, reusing their memory
+    template <class T> void init_column (Column<T> &c, T poro, T perm, T b, T wilt);
+
+    //!sets everything that depends on the settings, and the initial condition, for construction or reset()
+    void initialize ();
 
     //--------------------
     //ODE solver functions
@@ -172,40 +514,194 @@ public:
     void infil_times (double t, double *ta, double *tb);
 
     //!computes the flux between two cells
-    double f_q (double K, double dpsidw, double dwdz, double satl, double satr);
+    template <class T> T f_q (T K, T dpsidw, T dwdz, T satl, T satr, T wilt);
 
     //!computes the time derivative of a cell, given fluxes on its sides
-    double f_dwdt (double qt, double qb, double delz);
+    template <class T> T f_dwdt (T qt, T qb, double delz);
+
+    //!updates hydraulic properties at a cell edge from its saturation
+    template <class T> void update_props (long i, Column<T> &c);
+
+    //!updates the bottom (water table) edge of any column
+    template <class T> void update_bot (const T *w, Column<T> &c);
+
+    //!updates an interior cell edge of any column
+    template <class T> void update_mid (const T *w, long i, Column<T> &c);
+
+    //!updates the top (surface) edge of any column
+    template <class T> void update_top (const T *w, bool infil, Column<T> &c);
+
+    //!updates fluxes in any column
+    template <class T> void update_q (const T *w, double t, Column<T> &c);
 
     //!updates fluxes
     void update_q (double *w, double t);
 
+    //!updates fluxes at a subset of cell edges, leaving the others untouched
+    /*!
+    \param[in] w water fractions, only those adjacent to the requested edges are used
+    \param[in] t time
+    \param[in] edges indices of the cell edges to update
+    */
+    void update_edges (const double *w, double t, const std::vector<long> &edges);
+
+    //!updates the dual column's fluxes from the water fractions and their sensitivities in a solution array, leaving the plain column alone
+    void update_q_sens (double *solin);
+
     //!ode function for the integrator
     void ode_fun (double *solin, double *fout);
 
     //!computes the next time step, based on the maximum diffusivity
     double dt_adapt ();
 
+    //!limits a time step so it respects infiltration event boundaries, or the boundaries of a forcing series, and evaporation
+    double dt_forcing (double dt, double t);
+
     //!integrates to steady state using current state boundary conditions
     void steady (double atol=1e-9, unsigned long ntol=1000000);
 
     //!integrates over infiltration periods until nearly periodic behavior is established
-    void spinup (double rtol=1e-12, bool quiet=true);
+    /*!
+    If checkpointing, the spinup is checkpointed between steps and continues from where it stopped when called after load_checkpoint(). If the watchdog is on and the spinup hasn't converged after `maxper` periods, it's abandoned. Spinups need the periodic forcing, so spinning up a model forced by a series throws a std::runtime_error.
+    \param[in] rtol relative tolerance on the change in fluxes between periods
+    \param[in] quiet whether to skip printing progress
+    \param[in] nmin minimum number of periods compared to their predecessors, which guards against a slowly changing initial condition and can be lowered when starting from a nearly periodic state
+    */
+    void spinup (double rtol=1e-12, bool quiet=true, long nmin=6);
+
+    //!integrates like solve_adaptive(), but can be checkpointed and continued from where it stopped when called after load_checkpoint()
+    /*!
+    \param[in] tint duration of the solve
+    \param[in] dt0 initial time step
+    \param[in] nsnap number of snaps, or zero for none
+    \param[in] dirout output directory
+    */
+    void solve (double tint, double dt0, unsigned long nsnap=0, const std::string &dirout="");
+
+    //-----------
+    //checkpoints
+
+    //!starts checkpointing spinups and solves
+    /*!
+    \param[in] fn checkpoint file, written to a temporary file and renamed so it's never incomplete
+    \param[in] interval wall clock time between periodic checkpoints (s), or zero to only checkpoint on SIGTERM
+    */
+    void set_checkpoint (const std::string &fn, double interval);
+
+    //!writes a checkpoint if one is due, throwing a Terminated afterward if a termination signal has arrived
+    void checkpoint ();
+
+    //!writes the complete state of the model into the checkpoint file
+    /*!
+    The state includes the solution and step counts, spinup progress, the bookkeeping of a solve in progress (snaps, reductions, step history, sensitivity integrals), the tracker's rows and spilled file lengths, and the contents of an in-memory store or the length of a store file. The file is written beside the checkpoint and synced to disk before replacing it, so a failed write, like on a full disk, leaves the previous checkpoint in place.
+    \return false if the checkpoint couldn't be written, in which case a warning is printed
+    */
+    bool save_checkpoint ();
+
+    //!restores the state saved in a checkpoint file, after any store is set
+    /*!
+    The program quits if the checkpoint was written with different settings.
+    \param[in] fn checkpoint file
+    \return false if there is no checkpoint file
+    */
+    bool load_checkpoint (const std::string &fn);
+
+    //!checks whether a spinup was in progress when the checkpoint was taken
+    bool is_spinning () { return(spinning); }
+
+    //!checks whether a solve was in progress when the checkpoint was taken
+    bool is_solving () { return(solving); }
 
     //-----------------
     //extras
 
     //!does extra stuff before starting a solve
     void before_solve ();
+    //!registers the tracker outputs, if they aren't already
+    void add_outputs ();
+    //!gets the output directory of the solve in progress
+    std::string outdir () { return( solving ? solvedir : get_dirout() ); }
     //!does extra stuff after every snap
     void after_snap (std::string dirout, long isnap, double t);
-    //!updates fluxes and sets a flag, if needed
-    void q_updated (double t, bool *qup);
+    //!assigns tracker columns to the tracked variables and empties the tracker
+    void setup_trackers ();
+    //!fills a tracker row
+    /*!
+    \param[in] row tracker row to fill
+    \param[in] t time of the row
+    \param[in] w water fractions at time t
+    \param[in] c column in which fluxes are evaluated
+    */
+    void fill_row (float *row, double t, const double *w, Column<double> &c);
+    //!interpolates the water fractions to a time inside the latest step
+    /*!
+    The SSP integrator has no dense output of its own. The last three steps are interpolated quadratically, or the latest step linearly where it borders a change in surface forcing.
+    \param[in] ts sample time, between the previous and current step
+    \param[in] tin time of the current step
+    \param[out] w interpolated water fractions
+    */
+    void interpolate (double ts, double tin, double *w);
     //!does extra stuff after every step
     void after_step (double tin);
     //!does extra stuff after integrating
     void after_solve ();
 
+    //!computes the water stored in the column (m)
+    double storage ();
+
+    //!gets the reductions over the most recent solve
+    const Metrics &get_metrics () { return(met); }
+
+    //!names the columns of a metrics table, as in metrics_row()
+    /*!
+    \param[in] s settings with the probe depths
+    */
+    static std::string metrics_header (const Settings &s);
+
+    //!formats the reductions over the most recent solve as a comma separated row
+    std::string metrics_row ();
+
+    //!prints the fraction of steps bounded by each constraint, and the edges most often bounding them by diffusion
+    void print_limits ();
+
+    //!restarts the watchdog's wall clock budget
+    void reset_watch () { twatch = wall_time(); nwatch = get_nstep(); }
+
+    //!gets the derivative of the most recent solve's mean bottom flux w/r/t a parameter
+    /*!
+    \param[in] k parameter index, 0 for perm, 1 for b, 2 for wilt, and 3 for poro
+    */
+    double get_dqbot (long k) { return(dqbot[k]); }
+
+    //!writes all output into a store instead of separate files, before solving
+    void set_store (Store *store_) { store = store_; trk.set_store(store_); }
+
+    //!counts steps and spinup periods into a sweep's progress counters
+    void set_progress (ThreadProgress *progress_) { progress = progress_; }
+
+    //!writes an output array into its own file or into the store
+    /*!
+    \param[in] dirout output directory
+    \param[in] var variable name, appended to the object's name
+    \param[in] a array to write
+    \param[in] size length of array
+    */
+    template <class T>
+    void output (const std::string &dirout, const std::string &var, const T *a, long size) {
+        std::string key = get_name() + "_" + var;
+        if ( store ) {
+            store->append(key, a, size);
+        } else {
+            write_array(dirout + "/" + key, a, size);
+        }
+    }
+
+    //!writes an output vector into its own file or into the store
+    template <class T>
+    void output (const std::string &dirout, const std::string &var, const std::vector<T> &a) {
+        output(dirout, var, a.data(), long(a.size()));
+    }
+
 };
 
 #endif
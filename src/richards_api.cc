@@ -0,0 +1,440 @@
+//! \file richards_api.cc
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <exception>
+#include <fcntl.h>
+#include <unistd.h>
+#include <semaphore.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "omp.h"
+
+#include "io.h"
+#include "grid.h"
+#include "settings.h"
+#include "checkpoint.h"
+#include "richards.h"
+#include "richards_api.h"
+
+//!identifies shared-memory segments
+#define SHM_MAGIC "RICHSHM"
+
+//!model handle
+struct richards_model {
+    Richards *rich;
+    //!failure of the model's most recent call, or empty
+    std::string error;
+};
+
+//!requests the host can make of a serving process
+enum ShmCommand { SHM_ADVANCE, SHM_STOP };
+
+//!start of a shared-memory segment, followed by the water fractions and edge fluxes of the column
+struct ShmHeader {
+    //!identifies the segment, written last when creating it
+    char magic[8];
+    //!interface version
+    int64_t version;
+    //!number of cells
+    int64_t ncell;
+    //!posted by the host when a request is ready
+    sem_t request;
+    //!posted by the serving process when a request is finished
+    sem_t reply;
+    //!request
+    int32_t command;
+    //!whether the request carries new forcing
+    int32_t setforcing;
+    //!whether the state in the segment replaces the model's
+    int32_t setstate;
+    //!zero if the request succeeded
+    int32_t status;
+    //!length of the interval (s)
+    double tint;
+    //!forcing over the interval
+    richards_forcing forcing;
+    //!results of the interval
+    richards_fluxes fluxes;
+    //!description of a failure
+    char error[256];
+};
+
+//!segment handle
+struct richards_shm {
+    //!shared-memory name
+    std::string name;
+    //!whether this process created the segment and removes it
+    bool owner;
+    //!mapped segment
+    void *base;
+    //!size of the segment in bytes
+    size_t size;
+    //!header at the start of the segment
+    ShmHeader *h;
+    //!water fractions in the segment
+    double *w;
+    //!edge fluxes in the segment
+    double *q;
+};
+
+//!failure on each thread
+static thread_local std::string error;
+
+//!records a failure
+static int fail (const std::string &msg) {
+    error = msg;
+    return(1);
+}
+
+//!records a failure of a model, on the model too, since calls on many models fail on other threads
+static int fail (richards_model *m, const std::string &msg) {
+    m->error = msg;
+    return( fail(msg) );
+}
+
+//!gets the offset of the arrays in a segment
+static size_t shm_offset () {
+    return( (sizeof(ShmHeader) + 63)/64*64 );
+}
+
+//!gets the size of a segment
+static size_t shm_size (long ncell) {
+    return( shm_offset() + (2*ncell + 1)*sizeof(double) );
+}
+
+//------------------------------------------------------------------------------
+//models
+
+const char *richards_error (void) {
+    return(error.c_str());
+}
+
+const char *richards_model_error (richards_model *m) {
+    return(m->error.c_str());
+}
+
+richards_model *richards_create (const char *fnsettings, const char **keys, const char **values, int nover) {
+
+    //reading would quit the host if the file can't be opened
+    FILE *f = fopen(fnsettings, "r");
+    if ( f == NULL ) {
+        fail(std::string("cannot open settings file ") + fnsettings);
+        return(NULL);
+    }
+    fclose(f);
+    std::vector< std::vector<std::string> > sv = read_values(fnsettings);
+    for (int k=0; k<nover; k++) {
+        if ( !override_value(sv, keys[k], values[k]) ) {
+            fail(std::string("unknown setting ") + keys[k]);
+            return(NULL);
+        }
+    }
+    //parsing would quit the host on an unknown setting
+    Settings stg;
+    std::string err;
+    if ( !parse_settings(sv, stg, err) ) {
+        fail(err);
+        return(NULL);
+    }
+    //the host handles all output
+    disable_output(stg);
+
+    richards_model *m = new richards_model;
+    try {
+        Grid grid(stg.depth, stg.delz0, stg.delzfrac, stg.delzmax);
+        m->rich = new Richards(grid, stg);
+    } catch ( std::exception &e ) {
+        delete m;
+        fail(e.what());
+        return(NULL);
+    }
+    m->rich->set_quiet(true);
+    return(m);
+}
+
+void richards_destroy (richards_model *m) {
+    if ( m == NULL )
+        return;
+    delete m->rich;
+    delete m;
+}
+
+long richards_ncell (richards_model *m) {
+    return(m->rich->n);
+}
+
+double richards_time (richards_model *m) {
+    return(m->rich->get_t());
+}
+
+int richards_get_edges (richards_model *m, double *ze) {
+    const std::vector<double> &z = m->rich->ze;
+    memcpy(ze, z.data(), z.size()*sizeof(double));
+    return(0);
+}
+
+int richards_get_state (richards_model *m, double *w) {
+    memcpy(w, m->rich->get_sol(), m->rich->n*sizeof(double));
+    return(0);
+}
+
+int richards_set_state (richards_model *m, const double *w) {
+    m->error.clear();
+    for (long i=0; i<m->rich->n; i++) {
+        if ( !(w[i] >= 0) )
+            return( fail(m, "water fractions must be non-negative numbers") );
+    }
+    memcpy(m->rich->get_sol(), w, m->rich->n*sizeof(double));
+    return(0);
+}
+
+int richards_get_edge_fluxes (richards_model *m, double *q) {
+    Richards *rich = m->rich;
+    //fluxes of the current state, in the column used for samples
+    rich->update_q(rich->get_sol(), rich->get_t(), rich->csamp);
+    memcpy(q, rich->csamp.q.data(), (rich->n + 1)*sizeof(double));
+    return(0);
+}
+
+int richards_set_forcing (richards_model *m, const richards_forcing *f) {
+    m->error.clear();
+    if ( (f->tauevap < 0) || (f->Levap < 0) )
+        return( fail(m, "evaporation scales must not be negative") );
+    m->rich->set_forcing(f->wet != 0, f->tauevap, f->Levap);
+    return(0);
+}
+
+int richards_spinup (richards_model *m, double rtol) {
+    m->error.clear();
+    if ( m->rich->forced )
+        return( fail(m, "spinup follows the periodic infiltration schedule, so it must come before any forcing is set") );
+    if ( m->rich->series )
+        return( fail(m, "spinup follows the periodic infiltration schedule, so a model forced by a series can't be spun up") );
+    try {
+        m->rich->spinup(rtol, true);
+    } catch ( std::exception &e ) {
+        return( fail(m, e.what()) );
+    }
+    return(0);
+}
+
+int richards_advance (richards_model *m, double tint, richards_fluxes *out) {
+
+    m->error.clear();
+    if ( !(tint > 0) )
+        return( fail(m, "coupling interval must be positive") );
+    Richards *rich = m->rich;
+    unsigned long nstep = rich->get_nstep();
+    try {
+        rich->solve(tint, tint/1e9);
+    } catch ( std::exception &e ) {
+        return( fail(m, e.what()) );
+    }
+    if ( out == NULL )
+        return(0);
+    //reductions of the solve, with the end fluxes it evaluated
+    const Metrics &met = rich->get_metrics();
+    double dur = met.t1 - met.t0;
+    out->t = rich->get_t();
+    out->qbot = met.qint[0]/dur;
+    out->qtop = met.qint[1]/dur;
+    out->qbot_end = rich->csamp.q[0];
+    out->qtop_end = rich->csamp.q[rich->n];
+    out->dstor = met.dstor;
+    out->balance = met.balance;
+    out->nstep = rich->get_nstep() - nstep;
+    return(0);
+}
+
+int richards_advance_many (richards_model **m, long nmodel, const richards_forcing *f, double tint, richards_fluxes *out) {
+
+    long nfail = 0;
+    #pragma omp parallel for schedule(dynamic) reduction(+:nfail)
+    for (long i=0; i<nmodel; i++) {
+        if ( f && (richards_set_forcing(m[i], f + i) != 0) ) {
+            nfail++;
+            continue;
+        }
+        if ( richards_advance(m[i], tint, out ? out + i : NULL) != 0 )
+            nfail++;
+    }
+    if ( nfail > 0 ) {
+        //each model keeps its own failure, and the first is reported here
+        long first = 0;
+        while ( m[first]->error.empty() )
+            first++;
+        return( fail(int_to_string(nfail) + " of " + int_to_string(nmodel) + " models failed, first model "
+            + int_to_string(first) + ": " + m[first]->error) );
+    }
+    return(0);
+}
+
+//------------------------------------------------------------------------------
+//shared memory
+
+//!maps a segment, returning NULL on failure
+static richards_shm *shm_map (const char *name, int fd, size_t size, bool owner) {
+    void *base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if ( base == MAP_FAILED ) {
+        fail(std::string("cannot map shared memory ") + name);
+        return(NULL);
+    }
+    richards_shm *s = new richards_shm;
+    s->name = name;
+    s->owner = owner;
+    s->base = base;
+    s->size = size;
+    s->h = (ShmHeader*)base;
+    s->w = (double*)((char*)base + shm_offset());
+    return(s);
+}
+
+richards_shm *richards_shm_create (const char *name, long ncell) {
+
+    shm_unlink(name);
+    int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600);
+    size_t size = shm_size(ncell);
+    if ( (fd < 0) || (ftruncate(fd, size) != 0) ) {
+        if ( fd >= 0 )
+            close(fd);
+        fail(std::string("cannot create shared memory ") + name + ": " + strerror(errno));
+        return(NULL);
+    }
+    richards_shm *s = shm_map(name, fd, size, true);
+    if ( s == NULL )
+        return(NULL);
+    s->q = s->w + ncell;
+    ShmHeader *h = s->h;
+    h->version = RICHARDS_API_VERSION;
+    h->ncell = ncell;
+    sem_init(&h->request, 1, 0);
+    sem_init(&h->reply, 1, 0);
+    //the magic marks the segment as ready for attaching
+    __sync_synchronize();
+    memcpy(h->magic, SHM_MAGIC, sizeof(SHM_MAGIC));
+    return(s);
+}
+
+richards_shm *richards_shm_attach (const char *name) {
+
+    int fd = shm_open(name, O_RDWR, 0600);
+    struct stat st;
+    if ( (fd < 0) || (fstat(fd, &st) != 0) || (size_t(st.st_size) < shm_offset()) ) {
+        if ( fd >= 0 )
+            close(fd);
+        fail(std::string("cannot open shared memory ") + name);
+        return(NULL);
+    }
+    richards_shm *s = shm_map(name, fd, st.st_size, false);
+    if ( s == NULL )
+        return(NULL);
+    ShmHeader *h = s->h;
+    if ( (memcmp(h->magic, SHM_MAGIC, sizeof(SHM_MAGIC)) != 0)
+      || (h->version != RICHARDS_API_VERSION)
+      || (s->size < shm_size(h->ncell)) ) {
+        richards_shm_close(s);
+        fail(std::string(name) + " is not a ready segment of this interface version");
+        return(NULL);
+    }
+    s->q = s->w + h->ncell;
+    return(s);
+}
+
+void richards_shm_close (richards_shm *s) {
+    if ( s == NULL )
+        return;
+    if ( s->owner ) {
+        sem_destroy(&s->h->request);
+        sem_destroy(&s->h->reply);
+    }
+    munmap(s->base, s->size);
+    if ( s->owner )
+        shm_unlink(s->name.c_str());
+    delete s;
+}
+
+long richards_shm_ncell (richards_shm *s) {
+    return(s->h->ncell);
+}
+
+double *richards_shm_state (richards_shm *s) {
+    return(s->w);
+}
+
+const double *richards_shm_edge_fluxes (richards_shm *s) {
+    return(s->q);
+}
+
+//!waits on a semaphore, through interruptions by signals
+static int shm_wait (sem_t *sem) {
+    while ( sem_wait(sem) != 0 ) {
+        if ( errno != EINTR )
+            return( fail(std::string("waiting on shared memory failed: ") + strerror(errno)) );
+    }
+    return(0);
+}
+
+int richards_shm_serve (richards_model *m, richards_shm *s) {
+
+    ShmHeader *h = s->h;
+    if ( h->ncell != richards_ncell(m) )
+        return( fail("segment and model have different numbers of cells") );
+    //the host starts from the model's state
+    richards_get_state(m, s->w);
+    richards_get_edge_fluxes(m, s->q);
+    while ( true ) {
+        if ( shm_wait(&h->request) != 0 )
+            return(1);
+        if ( h->command == SHM_STOP ) {
+            sem_post(&h->reply);
+            return(0);
+        }
+        int status = 0;
+        if ( h->setforcing )
+            status = richards_set_forcing(m, &h->forcing);
+        if ( (status == 0) && h->setstate )
+            status = richards_set_state(m, s->w);
+        if ( status == 0 )
+            status = richards_advance(m, h->tint, &h->fluxes);
+        if ( status == 0 ) {
+            richards_get_state(m, s->w);
+            richards_get_edge_fluxes(m, s->q);
+        } else {
+            snprintf(h->error, sizeof(h->error), "%s", error.c_str());
+        }
+        h->status = status;
+        sem_post(&h->reply);
+    }
+}
+
+int richards_shm_advance (richards_shm *s, const richards_forcing *f, double tint, int setstate, richards_fluxes *out) {
+
+    ShmHeader *h = s->h;
+    h->command = SHM_ADVANCE;
+    h->setforcing = (f != NULL);
+    if ( f )
+        h->forcing = *f;
+    h->setstate = setstate;
+    h->tint = tint;
+    sem_post(&h->request);
+    if ( shm_wait(&h->reply) != 0 )
+        return(1);
+    if ( h->status != 0 )
+        return( fail(h->error) );
+    if ( out )
+        *out = h->fluxes;
+    return(0);
+}
+
+int richards_shm_stop (richards_shm *s) {
+    s->h->command = SHM_STOP;
+    sem_post(&s->h->request);
+    return( shm_wait(&s->h->reply) );
+}
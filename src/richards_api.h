@@ -0,0 +1,177 @@
+#ifndef RICHARDS_API_H_
+#define RICHARDS_API_H_
+
+/*! \file richards_api.h
+C interface for embedding the column model in another program, like a land-surface model calling it at every coupling step for many grid points. Models are opaque handles and every array is a buffer provided by the caller, so nothing is allocated or copied per call beyond the integration itself. Functions returning int give zero on success and nonzero on failure, with a description from richards_error().
+
+A model can also be run in a separate process and driven through a shared-memory segment. The model process creates the segment and serves it with richards_shm_serve(). The host attaches to it and calls richards_shm_advance() at every coupling step, reading and writing the column's water fractions in the segment directly.
+
+The interface is compiled into `bin/librichards.so` with `make capi`, and `bin/richards_coupler.exe` serves a segment from the command line.
+*/
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//!version of the interface, changed whenever a struct or signature changes
+#define RICHARDS_API_VERSION 1
+
+//!opaque model handle
+typedef struct richards_model richards_model;
+
+//!opaque shared-memory segment handle
+typedef struct richards_shm richards_shm;
+
+//!surface forcing over the next coupling interval
+typedef struct {
+    //!nonzero if the surface is saturated, zero if it's evaporating
+    int wet;
+    //!evaporation time scale (s), or zero to keep the current one
+    double tauevap;
+    //!evaporation length scale (m), or zero to keep the current one
+    double Levap;
+} richards_forcing;
+
+//!results of a coupling interval, with fluxes positive upward
+typedef struct {
+    //!model time at the end of the interval (s)
+    double t;
+    //!mean flux through the surface over the interval (m/s)
+    double qtop;
+    //!mean flux through the bottom boundary over the interval (m/s)
+    double qbot;
+    //!flux through the surface at the end of the interval (m/s)
+    double qtop_end;
+    //!flux through the bottom boundary at the end of the interval (m/s)
+    double qbot_end;
+    //!change in water stored in the column over the interval (m)
+    double dstor;
+    //!storage change minus net inflow, which should be near zero (m)
+    double balance;
+    //!number of steps taken over the interval
+    unsigned long nstep;
+} richards_fluxes;
+
+//!gets a description of the most recent failure on the calling thread
+const char *richards_error (void);
+
+//!gets a description of the failure of a model's most recent call, or an empty string if it succeeded
+/*!
+Calls on many models at once, like richards_advance_many(), run them on other threads, so this is how the host finds out which of them failed and why.
+*/
+const char *richards_model_error (richards_model *m);
+
+//!creates a model from a settings file, optionally overriding some settings
+/*!
+\param[in] fnsettings path to a settings file
+\param[in] keys names of settings to override, or NULL
+\param[in] values values of the overridden settings, as they would appear in the file, or NULL
+\param[in] nover number of overridden settings
+\return a model, whose output is all turned off, or NULL on failure
+*/
+richards_model *richards_create (const char *fnsettings, const char **keys, const char **values, int nover);
+
+//!destroys a model
+void richards_destroy (richards_model *m);
+
+//!gets the number of cells
+long richards_ncell (richards_model *m);
+
+//!gets the model time (s)
+double richards_time (richards_model *m);
+
+//!copies the cell edge coordinates (m), which are zero at the surface and negative below, into a buffer of ncell+1 values
+int richards_get_edges (richards_model *m, double *ze);
+
+//!copies the water fractions of the cells, bottom first, into a buffer of ncell values
+int richards_get_state (richards_model *m, double *w);
+
+//!sets the water fractions of the cells, bottom first, from a buffer of ncell values
+int richards_set_state (richards_model *m, const double *w);
+
+//!evaluates the fluxes of the current state at the cell edges (m/s), bottom first, into a buffer of ncell+1 values
+int richards_get_edge_fluxes (richards_model *m, double *q);
+
+//!sets the surface forcing, which replaces the periodic infiltration schedule of the settings and holds until set again
+int richards_set_forcing (richards_model *m, const richards_forcing *f);
+
+//!spins up under the periodic infiltration schedule of the settings, before any forcing is set, failing for a model forced by a series
+/*!
+\param[in] m model
+\param[in] rtol relative tolerance on the change in fluxes between periods
+*/
+int richards_spinup (richards_model *m, double rtol);
+
+//!integrates over a coupling interval
+/*!
+\param[in] m model
+\param[in] tint length of the interval (s)
+\param[out] out results of the interval, or NULL
+*/
+int richards_advance (richards_model *m, double tint, richards_fluxes *out);
+
+//!sets the forcing of many models and integrates them over the same interval in parallel
+/*!
+\param[in] m models
+\param[in] nmodel number of models
+\param[in] f forcing of each model, or NULL to keep the current forcing
+\param[in] tint length of the interval (s)
+\param[out] out results of each model, or NULL
+\return zero if every model succeeded
+*/
+int richards_advance_many (richards_model **m, long nmodel, const richards_forcing *f, double tint, richards_fluxes *out);
+
+//!creates a shared-memory segment for a column of ncell cells, replacing any existing one with the same name
+/*!
+\param[in] name POSIX shared-memory name, like "/richards0"
+\param[in] ncell number of cells of the model that will serve the segment
+\return the segment, or NULL on failure
+*/
+richards_shm *richards_shm_create (const char *name, long ncell);
+
+//!attaches to a segment created by another process
+/*!
+\return the segment, or NULL on failure
+*/
+richards_shm *richards_shm_attach (const char *name);
+
+//!detaches from a segment, removing it if this process created it
+void richards_shm_close (richards_shm *s);
+
+//!gets the number of cells of a segment's column
+long richards_shm_ncell (richards_shm *s);
+
+//!gets the water fractions of the column in a segment, ncell values that the host can read after each interval and write before the next
+double *richards_shm_state (richards_shm *s);
+
+//!gets the fluxes at the cell edges at the end of the latest interval, ncell+1 values
+const double *richards_shm_edge_fluxes (richards_shm *s);
+
+//!serves a segment, integrating a model for each request until told to stop
+/*!
+\param[in] m model
+\param[in] s segment, with as many cells as the model
+\return zero when stopped by the host
+*/
+int richards_shm_serve (richards_model *m, richards_shm *s);
+
+//!asks the serving process to integrate over a coupling interval and waits for it
+/*!
+\param[in] s segment
+\param[in] f surface forcing over the interval, or NULL to keep the current forcing
+\param[in] tint length of the interval (s)
+\param[in] setstate nonzero if the water fractions in the segment were changed and should replace the model's
+\param[out] out results of the interval, or NULL
+*/
+int richards_shm_advance (richards_shm *s, const richards_forcing *f, double tint, int setstate, richards_fluxes *out);
+
+//!tells the serving process to stop
+int richards_shm_stop (richards_shm *s);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,405 @@
+//! \file rom.cc
+
+#include <algorithm>
+
+#include "rom.h"
+
+Pod::Pod (long n) :
+    n (n) {
+
+    r = 0;
+    p = 0;
+    stride = 1;
+    nadd = 0;
+}
+
+void Pod::add_snapshot (const double *w, const double *f) {
+
+    //only snapshots on the stride are kept
+    if ( nadd++ % stride != 0 )
+        return;
+    //drop every other stored snapshot when full, keeping the first
+    long m = get_nsnap();
+    if ( m == POD_MAXSNAP ) {
+        for (long j=1; 2*j<m; j++) {
+            std::copy(ws.begin() + 2*j*n, ws.begin() + (2*j + 1)*n, ws.begin() + j*n);
+            std::copy(fs.begin() + 2*j*n, fs.begin() + (2*j + 1)*n, fs.begin() + j*n);
+        }
+        ws.resize(((m + 1)/2)*n);
+        fs.resize(((m + 1)/2)*n);
+        stride *= 2;
+        //the snapshot being offered may no longer fall on the stride
+        if ( (nadd - 1) % stride != 0 )
+            return;
+    }
+    for (long i=0; i<n; i++) {
+        ws.push_back( w[i] );
+        fs.push_back( f[i] );
+    }
+}
+
+void Pod::train (Richards &rich, double rtol, long nper) {
+
+    long i, j;
+    //snapshots in the dry and wet parts of each period
+    long ndry = nper/2;
+    long nwet = nper - ndry;
+    double tdry = rich.stg.infper - rich.stg.infdur;
+    //storage for time derivatives
+    double *f = new double[rich.get_neq()];
+    //fluxes at the end of consecutive periods
+    std::vector<double> q_a(n, INFINITY);
+    std::vector<double> q_b(n, INFINITY);
+    double mrd = INFINITY;
+    long count = 0;
+
+    //integrate over infiltration periods until the fluxes are stable
+    while ( (mrd > rtol) || (count <= 5) ) {
+        for (j=0; j<nper; j++) {
+            if ( j < ndry ) {
+                rich.solve_adaptive(tdry/ndry, rich.stg.infper/1e12, false);
+            } else {
+                rich.solve_adaptive(rich.stg.infdur/nwet, rich.stg.infper/1e12, false);
+            }
+            rich.ode_fun(rich.get_sol(), f);
+            add_snapshot(rich.get_sol(), f);
+        }
+        count++;
+        for (i=0; i<n; i++) {
+            q_a[i] = q_b[i];
+            q_b[i] = rich.q[i];
+        }
+        mrd = maxreldif(q_a, q_b, n);
+    }
+
+    delete [] f;
+}
+
+long Pod::modes (const std::vector<double> &X, double tol, long rmax, std::vector<double> &V) {
+
+    long i, j, k, m = long(X.size())/n;
+    std::vector<double> C, evals, evecs;
+    double tot, cum, d;
+
+    //method of snapshots, m x m, which the thinning keeps small
+    C.assign(m*m, 0.0);
+    for (i=0; i<m; i++)
+        for (j=i; j<m; j++) {
+            for (k=0; k<n; k++)
+                C[i*m+j] += X[i*n+k]*X[j*n+k];
+            C[j*m+i] = C[i*m+j];
+        }
+    eig_sym(C, m, evals, evecs);
+
+    //number of modes capturing the requested energy
+    tot = 0.0;
+    for (i=0; i<long(evals.size()); i++)
+        if ( evals[i] > 0 )
+            tot += evals[i];
+    cum = 0.0;
+    long nm = 0;
+    while ( (nm < long(evals.size())) && (nm < rmax) && (nm < n) && (evals[nm] > 0) && (cum < (1 - tol)*tot) ) {
+        cum += evals[nm];
+        nm++;
+    }
+
+    //modes, row-major n x nm
+    V.assign(n*nm, 0.0);
+    for (k=0; k<nm; k++)
+        for (j=0; j<m; j++)
+            for (i=0; i<n; i++)
+                V[i*nm+k] += X[j*n+i]*evecs[j*m+k]/sqrt(evals[k]);
+    //modes of small eigenvalues lose orthogonality to rounding, so they're orthonormalized with modified Gram-Schmidt
+    for (k=0; k<nm; k++) {
+        for (j=0; j<k; j++) {
+            d = 0.0;
+            for (i=0; i<n; i++) d += V[i*nm+j]*V[i*nm+k];
+            for (i=0; i<n; i++) V[i*nm+k] -= d*V[i*nm+j];
+        }
+        d = 0.0;
+        for (i=0; i<n; i++) d += V[i*nm+k]*V[i*nm+k];
+        d = sqrt(d);
+        for (i=0; i<n; i++) V[i*nm+k] /= d;
+    }
+
+    return(nm);
+}
+
+void Pod::build (double tol, long rmax) {
+
+    long i, j, k, l, m = get_nsnap();
+    if ( m == 0 )
+        print_exit("cannot build a POD basis without snapshots");
+
+    //------------------------
+    //water fraction modes
+
+    wbar.assign(n, 0.0);
+    for (j=0; j<m; j++)
+        for (i=0; i<n; i++)
+            wbar[i] += ws[j*n+i]/m;
+    std::vector<double> X(ws);
+    for (j=0; j<m; j++)
+        for (i=0; i<n; i++)
+            X[j*n+i] -= wbar[i];
+    r = modes(X, tol, rmax, phi);
+
+    //------------------------
+    //time derivative modes, at least as many as water fraction modes
+
+    p = modes(fs, tol, rmax, u);
+    if ( p < r ) {
+        p = std::min(r, n);
+        modes(fs, 0.0, p, u);
+    }
+
+    //-------------------------
+    //greedy DEIM point selection
+
+    std::vector<double> A, c, res(n);
+    idx.clear();
+    for (l=0; l<p; l++) {
+        //residual of interpolating mode l with the previous modes
+        for (i=0; i<n; i++) res[i] = u[i*p+l];
+        if ( l > 0 ) {
+            A.resize(l*l);
+            c.resize(l);
+            for (j=0; j<l; j++) {
+                for (k=0; k<l; k++)
+                    A[j*l+k] = u[idx[j]*p+k];
+                c[j] = u[idx[j]*p+l];
+            }
+            lu_solve(A, c, l);
+            for (i=0; i<n; i++)
+                for (k=0; k<l; k++)
+                    res[i] -= u[i*p+k]*c[k];
+        }
+        //the largest residual is the next point
+        i = 0;
+        for (j=1; j<n; j++)
+            if ( fabs(res[j]) > fabs(res[i]) )
+                i = j;
+        idx.push_back( i );
+    }
+
+    //----------------------------------
+    //reduced operator Phi^T U (P^T U)^-1
+
+    //transpose of P^T U
+    std::vector<double> At(p*p);
+    for (j=0; j<p; j++)
+        for (k=0; k<p; k++)
+            At[k*p+j] = u[idx[j]*p+k];
+    M.assign(r*p, 0.0);
+    for (k=0; k<r; k++) {
+        //row k of Phi^T U
+        c.assign(p, 0.0);
+        for (l=0; l<p; l++)
+            for (i=0; i<n; i++)
+                c[l] += phi[i*r+k]*u[i*p+l];
+        lu_solve(At, c, p);
+        for (l=0; l<p; l++)
+            M[k*p+l] = c[l];
+    }
+}
+
+void Pod::save (std::string dirout) {
+    write_array(dirout + "/pod_wbar", wbar);
+    write_array(dirout + "/pod_phi", phi);
+    write_array(dirout + "/pod_u", u);
+    write_array(dirout + "/pod_idx", idx);
+    write_array(dirout + "/pod_M", M);
+}
+
+//------------------------------------------------------------------------------
+
+RichardsRom::RichardsRom (Richards &rich, Pod &pod, double errtol) :
+    OdeSsp3 (pod.r + 1),
+    rich (rich),
+    pod (pod),
+    errtol (errtol),
+    r (pod.r),
+    p (pod.p) {
+
+    long i, j, l;
+
+    //set the name of the object
+    set_name("richards_rom");
+    //turn on silent snapping
+    set_silent_snap(true);
+
+    //cells and edges needed by each DEIM point
+    for (l=0; l<p; l++) {
+        i = pod.idx[l];
+        for (j=i-1; j<=i+1; j++)
+            if ( (j >= 0) && (j < rich.n) )
+                cells.push_back( j );
+        edges.push_back( i );
+        edges.push_back( i + 1 );
+    }
+    std::sort(cells.begin(), cells.end());
+    cells.erase(std::unique(cells.begin(), cells.end()), cells.end());
+    std::sort(edges.begin(), edges.end());
+    edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+
+    //work arrays
+    w.resize(rich.get_neq(), 0.0);
+    fp.resize(p);
+    f = new double[rich.get_neq()];
+
+    //start from the full-order model's state
+    project();
+}
+
+RichardsRom::~RichardsRom () {
+    delete [] f;
+}
+
+void RichardsRom::project () {
+
+    long i, k;
+    double a;
+    for (k=0; k<r; k++) {
+        a = 0.0;
+        for (i=0; i<rich.n; i++)
+            a += pod.phi[i*r+k]*(rich.get_sol(i) - pod.wbar[i]);
+        set_sol(k, a);
+    }
+    set_sol(r, rich.get_sol(rich.n));
+    set_t(rich.get_t());
+}
+
+void RichardsRom::reconstruct (const double *a) {
+
+    long i, j, k;
+    for (j=0; j<long(cells.size()); j++) {
+        i = cells[j];
+        w[i] = pod.wbar[i];
+        for (k=0; k<r; k++)
+            w[i] += pod.phi[i*r+k]*a[k];
+    }
+}
+
+void RichardsRom::lift () {
+
+    long i, k;
+    double x;
+    for (i=0; i<rich.n; i++) {
+        x = pod.wbar[i];
+        for (k=0; k<r; k++)
+            x += pod.phi[i*r+k]*get_sol(k);
+        rich.set_sol(i, x);
+    }
+    rich.set_sol(rich.n, get_sol(r));
+    rich.set_t(get_t());
+}
+
+double RichardsRom::error () {
+
+    long i, k, l, n = rich.n;
+    double g, gh, num = 0.0, den = 0.0;
+
+    //full profile, with time
+    for (i=0; i<n; i++) {
+        w[i] = pod.wbar[i];
+        for (k=0; k<r; k++)
+            w[i] += pod.phi[i*r+k]*get_sol(k);
+        if ( std::isnan(w[i]) || (w[i] < 0) || (w[i] > rich.poroc[i]) )
+            return(INFINITY);
+    }
+    w[n] = get_sol(r);
+    //full-order time derivatives
+    rich.ode_fun(w.data(), f);
+    //compare the Galerkin projection with the DEIM approximation
+    for (k=0; k<r; k++) {
+        g = 0.0;
+        for (i=0; i<n; i++)
+            g += pod.phi[i*r+k]*f[i];
+        gh = 0.0;
+        for (l=0; l<p; l++)
+            gh += pod.M[k*p+l]*f[pod.idx[l]];
+        num += (gh - g)*(gh - g);
+        den += g*g;
+    }
+    if ( std::isnan(num) || (den == 0) )
+        return(INFINITY);
+
+    return( sqrt(num/den) );
+}
+
+bool RichardsRom::spinup (double rtol) {
+
+    long i, n = rich.n;
+    //state at the beginning of the current period, for falling back
+    std::vector<double> aprev(r+1);
+    double tprev;
+    //fluxes at the end of consecutive periods
+    std::vector<double> q_a(n, INFINITY);
+    std::vector<double> q_b(n, INFINITY);
+    double mrd = INFINITY;
+    long count = 0;
+
+    //start from the full-order state
+    project();
+    //make sure the diffusivities at the evaluated edges are current
+    ode_fun(get_sol(), f);
+    //integrate over infiltration periods until the fluxes are stable
+    while ( (mrd > rtol) || (count <= 5) ) {
+        for (i=0; i<r+1; i++) aprev[i] = get_sol(i);
+        tprev = get_t();
+        solve_adaptive(rich.stg.infper, rich.stg.infper/1e12, false);
+        //check the reduced model, filling the full-order fluxes
+        if ( !(error() <= errtol) ) {
+            for (i=0; i<r+1; i++) set_sol(i, aprev[i]);
+            set_t(tprev);
+            lift();
+            return(false);
+        }
+        count++;
+        for (i=0; i<n; i++) {
+            q_a[i] = q_b[i];
+            q_b[i] = rich.q[i];
+        }
+        mrd = maxreldif(q_a, q_b, n);
+    }
+    lift();
+
+    return(true);
+}
+
+void RichardsRom::ode_fun (double *solin, double *fout) {
+
+    long i, k, l;
+    //autonomous form for time
+    fout[r] = 1.0;
+    //profile at the cells around the DEIM points
+    reconstruct(solin);
+    //fluxes at the edges of the DEIM cells
+    rich.update_edges(w.data(), solin[r], edges);
+    //time derivatives at the DEIM cells
+    for (l=0; l<p; l++) {
+        i = pod.idx[l];
+        fp[l] = (rich.q[i] - rich.q[i+1])/rich.delz[i];
+    }
+    //reduced time derivatives
+    for (k=0; k<r; k++) {
+        fout[k] = 0.0;
+        for (l=0; l<p; l++)
+            fout[k] += pod.M[k*p+l]*fp[l];
+    }
+}
+
+double RichardsRom::dt_adapt () {
+
+    //fraction of maximum stable time step at the evaluated edges
+    double dt = INFINITY;
+    double dtmax;
+    for (unsigned long j=0; j<edges.size(); j++) {
+        dtmax = rich.dtcons[edges[j]]/rich.D[edges[j]];
+        if ( (dtmax < dt) && !std::isnan(dtmax) )
+            dt = dtmax;
+    }
+    dt *= rich.stg.dtfac;
+
+    return( rich.dt_forcing(dt, get_sol(r)) );
+}
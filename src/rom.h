@@ -0,0 +1,169 @@
+#ifndef ROM_H_
+#define ROM_H_
+
+//! \file rom.h
+
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "io.h"
+#include "util.h"
+#include "richards.h"
+
+//header file for ODE integrator class
+#include "ode_ssp_3.h"
+
+//!most snapshots kept by a basis, which thins them evenly in time to stay under it
+#define POD_MAXSNAP 512
+
+//!minimum number of full-order periods compared to their predecessors after a converged reduced spinup, correcting the lifted state
+#define ROM_NCORRECT 2
+
+//!proper orthogonal decomposition of water fraction profiles, with DEIM points for the fluxes
+/*!
+Snapshots of the water fraction profile and its time derivative are collected from a full-order integration. The water fractions are approximated by their snapshot mean plus `r` POD modes. The time derivatives are approximated by `p` modes of their own, which are only evaluated at `p` cells selected by the discrete empirical interpolation method (DEIM). Because each cell's time derivative only depends on its two neighbors, the reduced model never has to evaluate the whole column.
+
+At most POD_MAXSNAP snapshots are kept. When they fill up, every other one is dropped and only every other new one is kept from then on, like a tracker's decimation, so a long training spinup stays evenly sampled in time. Modes always come from the method of snapshots, the eigenvectors of the snapshots' m x m correlation matrix, so building a basis costs O(m^2 n + m^3) however long the column is.
+*/
+class Pod {
+
+public:
+
+    //!constructs an empty basis
+    /*!
+    \param[in] n number of cells in the model column
+    */
+    Pod (long n);
+
+    //!number of cells
+    const long n;
+    //!number of water fraction modes
+    long r;
+    //!number of DEIM points
+    long p;
+    //!interval between kept snapshots, in snapshots offered
+    long stride;
+    //!number of snapshots offered
+    long nadd;
+
+    //!snapshots of water fractions, each n long and one after another
+    std::vector<double> ws;
+    //!snapshots of water fraction time derivatives, each n long and one after another
+    std::vector<double> fs;
+    //!mean water fraction profile of the snapshots
+    std::vector<double> wbar;
+    //!water fraction modes, row-major n x r
+    std::vector<double> phi;
+    //!time derivative modes, row-major n x p
+    std::vector<double> u;
+    //!DEIM cell indices
+    std::vector<long> idx;
+    //!reduced operator Phi^T U (P^T U)^-1, row-major r x p
+    std::vector<double> M;
+
+    //!stores a snapshot, if it falls on the stride, thinning the stored ones when they fill up
+    /*!
+    \param[in] w water fractions
+    \param[in] f time derivatives of the water fractions
+    */
+    void add_snapshot (const double *w, const double *f);
+
+    //!spins up a full-order model from its current state, taking snapshots along the way
+    /*!
+    Snapshots are taken at evenly spaced times inside the dry and wet parts of every infiltration period, so that the short wetting events are represented.
+    \param[in] rich full-order model
+    \param[in] rtol spinup tolerance, as in Richards::spinup
+    \param[in] nper number of snapshots per infiltration period
+    */
+    void train (Richards &rich, double rtol, long nper);
+
+    //!computes the modes and DEIM points from the stored snapshots
+    /*!
+    \param[in] tol fraction of snapshot energy that may be left out of each basis
+    \param[in] rmax maximum number of modes in each basis
+    */
+    void build (double tol, long rmax);
+
+    //!writes the basis into a directory as binary files
+    void save (std::string dirout);
+
+    //!gets the number of stored snapshots
+    long get_nsnap () { return( long(ws.size())/n ); }
+
+private:
+
+    //!computes the leading modes of a snapshot matrix by the method of snapshots, orthonormalized against rounding
+    long modes (const std::vector<double> &X, double tol, long rmax, std::vector<double> &V);
+};
+
+//!Galerkin/DEIM reduced-order version of a Richards model
+/*!
+The solution array holds the `r` modal coefficients followed by time. Fluxes are only evaluated at the cell edges bounding the DEIM cells, using the constitutive functions of the full-order model, so a trial with different soil parameters can be integrated in the basis built from another trial. The error indicator compares the reduced time derivative with the Galerkin projection of the full-order one on a reconstructed profile. When it exceeds tolerance, the caller should continue with the full-order model.
+*/
+class RichardsRom : public OdeSsp3 {
+
+public:
+
+    //!constructs
+    /*!
+    \param[in] rich the full-order model, which supplies physics and receives reconstructed states
+    \param[in] pod a built basis
+    \param[in] errtol tolerance of the error indicator
+    */
+    RichardsRom (Richards &rich, Pod &pod, double errtol);
+    ~RichardsRom ();
+
+    //!full-order model
+    Richards &rich;
+    //!basis
+    Pod &pod;
+    //!tolerance of the error indicator
+    double errtol;
+    //!number of modes
+    const long r;
+    //!number of DEIM points
+    const long p;
+    //!cells whose water fractions are needed to evaluate the DEIM points
+    std::vector<long> cells;
+    //!cell edges whose fluxes are needed to evaluate the DEIM points
+    std::vector<long> edges;
+    //!full-length water fraction work array, only valid at the needed cells
+    std::vector<double> w;
+    //!time derivatives at the DEIM points
+    std::vector<double> fp;
+
+    //!projects the full-order model's state onto the basis
+    void project ();
+
+    //!reconstructs the full profile and copies it into the full-order model
+    void lift ();
+
+    //!computes the relative error indicator for the current state
+    double error ();
+
+    //!spins up in the reduced space, falling back if the error indicator exceeds tolerance
+    /*!
+    The reduced model starts from the projected state of the full-order model, which is updated with the reconstructed profile when the reduced spinup stops. The lifted profile carries the basis' projection error, and the reduced steps are only bounded by the stability of the DEIM edges, so it should be corrected with a few full-order periods, like `spinup(rtol, true, ROM_NCORRECT)`, which settle it to the full model's own tolerance at a small fraction of the cost of a full spinup.
+    \param[in] rtol spinup tolerance, as in Richards::spinup
+    \return whether the reduced spinup converged without exceeding the error tolerance
+    */
+    bool spinup (double rtol=1e-12);
+
+    //!ode function for the integrator
+    void ode_fun (double *solin, double *fout);
+
+    //!computes the next time step from the diffusivity at the evaluated edges
+    double dt_adapt ();
+
+private:
+
+    //!reconstructs the needed cells of the profile from modal coefficients
+    void reconstruct (const double *a);
+
+    //!full-length time derivative work array for the error indicator
+    double *f;
+};
+
+#endif
@@ -0,0 +1,274 @@
+//! \file server.cc
+
+#include <cmath>
+#include <cerrno>
+#include <cstring>
+#include <sstream>
+#include <exception>
+#include <unistd.h>
+
+#include "checkpoint.h"
+#include "server.h"
+
+Connection::~Connection () {
+    if ( owned )
+        close(fd);
+}
+
+void Connection::send (const std::string &line) {
+    std::string s = line + "\n";
+    std::lock_guard<std::mutex> lock(mtx);
+    unsigned long pos = 0;
+    while ( pos < s.size() ) {
+        ssize_t k = write(fd, s.data() + pos, s.size() - pos);
+        if ( k < 0 ) {
+            if ( errno == EINTR )
+                continue;
+            return;
+        }
+        pos += k;
+    }
+}
+
+//------------------------------------------------------------------------------
+
+Server::Server (const char *fnsettings, long nthread) {
+
+    sv = read_values(fnsettings);
+    Settings s = parse_settings(sv);
+    disable_output(s);
+    mhead = Richards::metrics_header(s);
+
+    npending = 0;
+    stopping = false;
+    for (long i=0; i<nthread; i++)
+        workers.push_back( std::thread(&Server::run, this) );
+}
+
+Server::~Server () {
+    {
+        std::lock_guard<std::mutex> lock(qmtx);
+        stopping = true;
+    }
+    qcv.notify_all();
+    for (unsigned long i=0; i<workers.size(); i++)
+        workers[i].join();
+}
+
+std::string Server::header () {
+    return("#id,source,ms," + mhead);
+}
+
+bool Server::serve (int fd, std::shared_ptr<Connection> con) {
+
+    std::string buf;
+    char chunk[4096];
+    unsigned long pos;
+    while ( true ) {
+        ssize_t k = read(fd, chunk, sizeof(chunk));
+        if ( (k < 0) && (errno == EINTR) )
+            continue;
+        if ( k <= 0 )
+            break;
+        buf.append(chunk, k);
+        //every complete line is a request
+        while ( (pos = buf.find('\n')) != std::string::npos ) {
+            std::string line = buf.substr(0, pos);
+            buf.erase(0, pos + 1);
+            if ( !handle(line, con) )
+                return(false);
+        }
+    }
+    //a last line without a newline
+    return( handle(buf, con) );
+}
+
+void Server::drain () {
+    std::unique_lock<std::mutex> lock(qmtx);
+    while ( npending > 0 )
+        dcv.wait(lock);
+}
+
+bool Server::handle (const std::string &line, std::shared_ptr<Connection> con) {
+
+    std::istringstream ss(line);
+    std::string id, tok;
+    if ( !(ss >> id) || (id[0] == '#') )
+        return(true);
+    if ( id == "shutdown" )
+        return(false);
+
+    //settings of the trial
+    std::vector< std::vector<std::string> > svr = sv;
+    while ( ss >> tok ) {
+        unsigned long k = tok.find('=');
+        if ( (k == std::string::npos) || (k == 0) ) {
+            con->send(id + ",error,expected key=value but got " + tok);
+            return(true);
+        }
+        std::string key = tok.substr(0, k);
+        //the columns of the metrics must match the header
+        if ( key == "probes" ) {
+            con->send(id + ",error,probes are fixed by the server's settings");
+            return(true);
+        }
+        //trials run in parallel and are spun up, which sweep_settings() enforces
+        if ( (key == "colthreads") || (key == "forcing") ) {
+            con->send(id + ",error," + key + " is fixed by the server, which spins up trials in parallel");
+            return(true);
+        }
+        if ( !override_value(svr, key, tok.substr(k + 1)) ) {
+            con->send(id + ",error,unknown setting " + key);
+            return(true);
+        }
+    }
+    Request r;
+    r.id = id;
+    std::string err;
+    if ( !parse_settings(svr, r.s, err) ) {
+        con->send(id + ",error," + err);
+        return(true);
+    }
+    disable_output(r.s);
+    sweep_settings(r.s);
+    r.con = con;
+    r.tin = wall_time();
+
+    {
+        std::lock_guard<std::mutex> lock(qmtx);
+        queue.push_back(r);
+        npending++;
+    }
+    qcv.notify_one();
+    return(true);
+}
+
+void Server::run () {
+
+    Request r;
+    while ( true ) {
+        {
+            std::unique_lock<std::mutex> lock(qmtx);
+            while ( queue.empty() && !stopping )
+                qcv.wait(lock);
+            if ( queue.empty() )
+                break;
+            r = queue.front();
+            queue.pop_front();
+        }
+        answer(r);
+        //release the connection before counting the request as answered
+        r.con.reset();
+        {
+            std::lock_guard<std::mutex> lock(qmtx);
+            npending--;
+        }
+        dcv.notify_all();
+    }
+}
+
+void Server::answer (Request &r) {
+
+    Settings &s = r.s;
+    uint64_t h = hash_settings(s);
+    std::string row, source;
+    char buf[64];
+
+    //an identical earlier trial
+    {
+        std::lock_guard<std::mutex> lock(cmtx);
+        std::map<uint64_t, std::string>::iterator it = results.find(h);
+        if ( it != results.end() ) {
+            row = it->second;
+            source = "cached";
+        }
+    }
+
+    if ( source.empty() ) {
+        try {
+            std::shared_ptr<Grid> grid = get_grid(s);
+            Richards rich(grid, s);
+            rich.set_quiet(true);
+            long n = rich.n;
+            //start from the nearest spun-up state on the same grid, if there is one
+            std::vector<double> gkey = {s.depth, s.delz0, s.delzfrac, s.delzmax};
+            std::vector<double> p = params(s);
+            source = "cold";
+            {
+                std::lock_guard<std::mutex> lock(cmtx);
+                std::deque<Spun> &d = spun[gkey];
+                const Spun *near = NULL;
+                double dmin = INFINITY, dist;
+                for (unsigned long k=0; k<d.size(); k++) {
+                    dist = 0.0;
+                    for (unsigned long j=0; j<p.size(); j++)
+                        dist += (p[j] - d[k].p[j])*(p[j] - d[k].p[j]);
+                    if ( dist < dmin ) {
+                        dmin = dist;
+                        near = &d[k];
+                    }
+                }
+                if ( near && (long(near->w.size()) == n) ) {
+                    for (long i=0; i<n; i++)
+                        rich.get_sol()[i] = near->w[i];
+                    source = "warm";
+                }
+            }
+            //a warm start only needs one pair of periods to agree
+            rich.spinup(SERVER_RTOL, true, (source == "warm") ? 1 : 6);
+            //keep the spun-up state for later trials
+            Spun sp;
+            sp.p = p;
+            sp.w.assign(rich.get_sol(), rich.get_sol() + n);
+            {
+                std::lock_guard<std::mutex> lock(cmtx);
+                std::deque<Spun> &d = spun[gkey];
+                d.push_back(sp);
+                if ( d.size() > SERVER_NCACHE )
+                    d.pop_front();
+            }
+            //reduce a single cycle in process
+            rich.solve(s.infper, s.infper/1e12);
+            row = rich.metrics_row();
+        } catch ( std::exception &e ) {
+            r.con->send(r.id + ",error," + e.what());
+            return;
+        }
+        //keep the metrics for repeated trials
+        std::lock_guard<std::mutex> lock(cmtx);
+        if ( results.insert(std::make_pair(h, row)).second ) {
+            resorder.push_back(h);
+            if ( resorder.size() > SERVER_NCACHE ) {
+                results.erase(resorder.front());
+                resorder.pop_front();
+            }
+        }
+    }
+
+    snprintf(buf, sizeof(buf), ",%s,%.3f,", source.c_str(), 1e3*(wall_time() - r.tin));
+    r.con->send(r.id + buf + row);
+}
+
+std::shared_ptr<Grid> Server::get_grid (const Settings &s) {
+    std::vector<double> gkey = {s.depth, s.delz0, s.delzfrac, s.delzmax};
+    std::lock_guard<std::mutex> lock(cmtx);
+    std::shared_ptr<Grid> &g = grids[gkey];
+    if ( !g )
+        g.reset(new Grid(s.depth, s.delz0, s.delzfrac, s.delzmax));
+    return(g);
+}
+
+std::vector<double> Server::params (const Settings &s) {
+    //logarithms of the parameters that span orders of magnitude
+    std::vector<double> p = {
+        s.poro/0.1,
+        log10(s.perm*s.rho*s.g/s.mu),
+        s.b,
+        s.wilt/0.1,
+        log10(s.tauevap),
+        log10(s.Levap),
+        log10(s.infper),
+        log10(s.infdur)
+    };
+    return(p);
+}
@@ -0,0 +1,154 @@
+#ifndef SERVER_H_
+#define SERVER_H_
+
+//! \file server.h
+
+#include <map>
+#include <deque>
+#include <mutex>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstdint>
+#include <condition_variable>
+
+#include "io.h"
+#include "grid.h"
+#include "settings.h"
+#include "richards.h"
+
+//!relative tolerance of served spinups, as in the batch program
+#define SERVER_RTOL 1e-6
+//!maximum number of results, and of spun-up states on each grid, kept by a server
+#define SERVER_NCACHE 4096
+
+//!client of a server, whose results are written back to it as they finish
+class Connection {
+
+public:
+
+    //!wraps an open descriptor
+    /*!
+    \param[in] fd descriptor that results are written to
+    \param[in] owned whether the descriptor is closed with the connection
+    */
+    Connection (int fd, bool owned) : fd (fd), owned (owned) {}
+    //!closes the descriptor, if owned, once every request has been answered
+    ~Connection ();
+
+    //!writes a line, ignoring a client that has gone away
+    void send (const std::string &line);
+
+private:
+
+    //!output descriptor
+    int fd;
+    //!whether the descriptor is closed with the connection
+    bool owned;
+    //!keeps lines from different threads whole
+    std::mutex mtx;
+};
+
+//!answers trial requests from warm worker threads, reusing grids, spun-up states, and results
+/*!
+Each request is a line holding an identifier and any number of `key=value` overrides of the server's settings, like `7 perm=1e-12 infdur=7200`. The trial is spun up and integrated over one infiltration period, as in the metrics-only batch mode, and answered with a line holding the identifier, where the answer came from, the wall clock time it took in milliseconds, and the row of metrics, in whatever order trials finish. A failed request is answered with its identifier, `error`, and a description.
+
+Three caches make repeated and nearby requests cheap. Grids are shared by all trials with the same grid settings. The metrics of every trial are kept by a hash of its settings, so a repeated request is answered without integrating (`cached`). The spun-up state of every trial is also kept, and a new trial on the same grid starts its spinup from the state of the nearest earlier trial in its physical parameters (`warm`) instead of from the initial condition (`cold`), which usually takes far fewer periods. Warm starts converge to the same periodic state within the spinup tolerance.
+*/
+class Server {
+
+public:
+
+    //!reads the base settings and starts the workers
+    /*!
+    \param[in] fnsettings path to the settings file
+    \param[in] nthread number of worker threads
+    */
+    Server (const char *fnsettings, long nthread);
+    //!finishes every request and stops the workers
+    ~Server ();
+
+    //!gets the header line describing answers
+    std::string header ();
+
+    //!reads requests from a descriptor until it ends, queueing each for the workers
+    /*!
+    \param[in] fd descriptor to read lines from
+    \param[in] con connection to answer on
+    \return false if a client asked the server to shut down
+    */
+    bool serve (int fd, std::shared_ptr<Connection> con);
+
+    //!waits for every queued request to be answered
+    void drain ();
+
+private:
+
+    //!queued request
+    struct Request {
+        //!client's identifier
+        std::string id;
+        //!settings of the trial
+        Settings s;
+        //!connection to answer on
+        std::shared_ptr<Connection> con;
+        //!wall clock time the request arrived
+        double tin;
+    };
+
+    //!spun-up state of a finished trial
+    struct Spun {
+        //!physical parameters, compared to find the nearest state
+        std::vector<double> p;
+        //!water fractions at the start of an infiltration period
+        std::vector<double> w;
+    };
+
+    //!handles a request line, returning false for a shutdown request
+    bool handle (const std::string &line, std::shared_ptr<Connection> con);
+
+    //!pops and answers requests until stopped
+    void run ();
+
+    //!integrates a trial and answers it
+    void answer (Request &r);
+
+    //!gets the shared grid of some settings
+    std::shared_ptr<Grid> get_grid (const Settings &s);
+
+    //!gets the physical parameters of some settings, scaled so differences are comparable
+    static std::vector<double> params (const Settings &s);
+
+    //!settings file, parsed for each request after overriding values
+    std::vector< std::vector<std::string> > sv;
+    //!metrics header of the base settings
+    std::string mhead;
+    //!worker threads
+    std::vector<std::thread> workers;
+    //!queued requests
+    std::deque<Request> queue;
+    //!number of requests queued or being integrated
+    unsigned long npending;
+    //!whether the workers should stop once the queue is empty
+    bool stopping;
+    //!protects the queue and the counters
+    std::mutex qmtx;
+    //!signals a queued request or a stop to the workers
+    std::condition_variable qcv;
+    //!signals an answered request to drain()
+    std::condition_variable dcv;
+
+    //!grids by grid settings
+    std::map<std::vector<double>, std::shared_ptr<Grid> > grids;
+    //!metrics rows by settings hash
+    std::map<uint64_t, std::string> results;
+    //!hashes of the results in the order they were added, for eviction
+    std::deque<uint64_t> resorder;
+    //!spun-up states by grid settings, oldest first
+    std::map<std::vector<double>, std::deque<Spun> > spun;
+    //!protects the caches
+    std::mutex cmtx;
+};
+
+#endif
@@ -1,5 +1,6 @@
 //! \file settings.cc
 
+#include "io.h"
 #include "settings.h"
 
 bool eval_txt_bool (const char *s) {
@@ -17,11 +18,139 @@ long to_long(const char *val) {
     return( long(std::atof(val)) );
 }
 
+std::vector<double> to_list (const char *val) {
+    std::vector<double> v;
+    std::string s(val), item;
+    std::istringstream ss(s);
+    while ( std::getline(ss, item, ',') ) {
+        strip_string(item);
+        if ( !item.empty() && (item != "none") )
+            v.push_back( std::atof(item.c_str()) );
+    }
+    return(v);
+}
+
+void disable_output (Settings &s) {
+    s.save_grid = false;
+    s.sens = false;
+    s.poroc = false;
+    s.poroe = false;
+    s.Ksat = false;
+    s.psisat = false;
+    s.dpsidw = false;
+    s.dwdz = false;
+    s.K = false;
+    s.D = false;
+    s.w = false;
+    s.we = false;
+    s.wall = false;
+    s.q = false;
+    s.qtop = false;
+    s.qmid = false;
+    s.qbot = false;
+    s.qall = false;
+    s.infil = false;
+    s.limit = false;
+    s.t = false;
+    s.tsnap = false;
+}
+
+void default_settings (Settings &s) {
+    //settings added since the original ones, defaulting to the original behavior so older settings files still work
+    s.dtout = 0;
+    s.nchunk = 0;
+    s.store = false;
+    s.compress = false;
+    s.ctol = 0;
+    s.nwriter = 0;
+    s.checkpoint = false;
+    s.ckptint = 600;
+    s.sens = false;
+    s.rom = false;
+    s.romtol = 1e-12;
+    s.romerr = 1e-2;
+    s.forcing = "none";
+    s.limit = false;
+    s.probes.clear();
+    s.metrics_only = false;
+    s.scaling = 0;
+    s.status = 0;
+    s.watchdog = false;
+    s.maxwall = 0;
+    s.maxstep = 0;
+    s.maxper = 0;
+    s.dtmin = 0;
+    s.colthreads = 1;
+    s.colmin = 2000;
+    s.tilek = 0;
+    s.tileb = 512;
+    s.tilefac = 0.8;
+}
+
+void sweep_settings (Settings &s) {
+    //trials already occupy every thread
+    s.colthreads = 1;
+    //spinups need the periodic forcing
+    s.forcing = "none";
+}
+
+uint64_t hash_settings (const Settings &s) {
+    std::ostringstream ss;
+    ss.precision(17);
+    ss << s.depth << ' ' << s.delz0 << ' ' << s.delzfrac << ' ' << s.delzmax << ' ' << s.save_grid << ' '
+       << s.tint << ' ' << s.tunit << ' ' << s.nsnap << ' ' << s.nmaxout << ' ' << s.dtout << ' '
+       << s.nchunk << ' ' << s.store << ' ' << s.compress << ' ' << s.ctol << ' ' << s.dtfac << ' '
+       << s.sens << ' ' << s.rom << ' ' << s.romtol << ' ' << s.romerr << ' '
+       << s.poro << ' ' << s.perm << ' ' << s.g << ' ' << s.mu << ' ' << s.rho << ' '
+       << s.b << ' ' << s.wilt << ' ' << s.tauevap << ' ' << s.Levap << ' ' << s.infper << ' ' << s.infdur << ' '
+       << s.poroc << s.poroe << s.Ksat << s.psisat << s.dpsidw << s.dwdz << s.K << s.D
+       << s.w << s.we << s.wall << s.q << s.qtop << s.qmid << s.qbot << s.qall << s.infil
+       << s.limit << s.t << s.tsnap << s.metrics_only;
+    for (unsigned long i=0; i<s.probes.size(); i++)
+        ss << ' ' << s.probes[i];
+    //only a series changes the hash, so runs with periodic forcing keep theirs
+    if ( s.forcing != "none" )
+        ss << ' ' << s.forcing;
+    //tiling changes spinup trajectories, if only by rounding for the block size, and likewise only changes the hash when it's on
+    if ( s.tilek > 0 )
+        ss << " tile " << s.tilek << ' ' << s.tileb << ' ' << s.tilefac;
+    //FNV-1a over the characters
+    std::string str = ss.str();
+    uint64_t h = 14695981039346656037ULL;
+    for (unsigned long i=0; i<str.size(); i++) {
+        h ^= (unsigned char)str[i];
+        h *= 1099511628211ULL;
+    }
+    return(h);
+}
+
+bool override_value (std::vector< std::vector< std::string > > &sv, const std::string &key, const std::string &value) {
+    for (unsigned long i=0; i<sv.size(); i++) {
+        if ( sv[i][0] == key ) {
+            sv[i][1] = value;
+            return(true);
+        }
+    }
+    return(false);
+}
+
 Settings parse_settings ( std::vector< std::vector< std::string > > sv ) {
 
     Settings s;
+    std::string err;
+    if ( !parse_settings(sv, s, err) ) {
+        std::cout << "FAILURE: " << err << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    return(s);
+}
+
+bool parse_settings (const std::vector< std::vector< std::string > > &sv, Settings &s, std::string &err) {
+
     const char *set, *val;
 
+    default_settings(s);
+
     for (int i=0; i < int(sv.size()); i++) {
 
         //get the setting and value pair
@@ -40,7 +169,19 @@ Settings parse_settings ( std::vector< std::vector< std::string > > sv ) {
         else if ( cmp(set, "tunit") ) s.tunit = std::atof(val);
         else if ( cmp(set, "nsnap") ) s.nsnap = to_long(val);
         else if ( cmp(set, "nmaxout") ) s.nmaxout = to_long(val);
+        else if ( cmp(set, "dtout") ) s.dtout = std::atof(val);
+        else if ( cmp(set, "nchunk") ) s.nchunk = to_long(val);
+        else if ( cmp(set, "store") ) s.store = eval_txt_bool(val);
+        else if ( cmp(set, "compress") ) s.compress = eval_txt_bool(val);
+        else if ( cmp(set, "ctol") ) s.ctol = std::atof(val);
+        else if ( cmp(set, "nwriter") ) s.nwriter = to_long(val);
+        else if ( cmp(set, "checkpoint") ) s.checkpoint = eval_txt_bool(val);
+        else if ( cmp(set, "ckptint") ) s.ckptint = std::atof(val);
         else if ( cmp(set, "dtfac") ) s.dtfac = std::atof(val);
+        else if ( cmp(set, "sens") ) s.sens = eval_txt_bool(val);
+        else if ( cmp(set, "rom") ) s.rom = eval_txt_bool(val);
+        else if ( cmp(set, "romtol") ) s.romtol = std::atof(val);
+        else if ( cmp(set, "romerr") ) s.romerr = std::atof(val);
 
         else if ( cmp(set, "poro") ) s.poro = std::atof(val);
         else if ( cmp(set, "perm") ) s.perm = std::atof(val);
@@ -54,6 +195,7 @@ Settings parse_settings ( std::vector< std::vector< std::string > > sv ) {
         else if ( cmp(set, "Levap") ) s.Levap = std::atof(val);
         else if ( cmp(set, "infper") ) s.infper = std::atof(val);
         else if ( cmp(set, "infdur") ) s.infdur = std::atof(val);
+        else if ( cmp(set, "forcing") ) s.forcing = sv[i][1];
 
         else if ( cmp(set, "poroc") ) s.poroc = eval_txt_bool(val);
         else if ( cmp(set, "poroe") ) s.poroe = eval_txt_bool(val);
@@ -72,19 +214,34 @@ Settings parse_settings ( std::vector< std::vector< std::string > > sv ) {
         else if ( cmp(set, "qbot") ) s.qbot = eval_txt_bool(val);
         else if ( cmp(set, "qall") ) s.qall = eval_txt_bool(val);
         else if ( cmp(set, "infil") ) s.infil = eval_txt_bool(val);
+        else if ( cmp(set, "limit") ) s.limit = eval_txt_bool(val);
         else if ( cmp(set, "t") ) s.t = eval_txt_bool(val);
         else if ( cmp(set, "tsnap") ) s.tsnap = eval_txt_bool(val);
+        else if ( cmp(set, "probes") ) s.probes = to_list(val);
+        else if ( cmp(set, "metrics_only") ) s.metrics_only = eval_txt_bool(val);
+        else if ( cmp(set, "scaling") ) s.scaling = to_long(val);
+        else if ( cmp(set, "status") ) s.status = std::atof(val);
+        else if ( cmp(set, "watchdog") ) s.watchdog = eval_txt_bool(val);
+        else if ( cmp(set, "maxwall") ) s.maxwall = std::atof(val);
+        else if ( cmp(set, "maxstep") ) s.maxstep = to_long(val);
+        else if ( cmp(set, "maxper") ) s.maxper = to_long(val);
+        else if ( cmp(set, "dtmin") ) s.dtmin = std::atof(val);
+        else if ( cmp(set, "colthreads") ) s.colthreads = to_long(val);
+        else if ( cmp(set, "colmin") ) s.colmin = to_long(val);
+        else if ( cmp(set, "tilek") ) s.tilek = to_long(val);
+        else if ( cmp(set, "tileb") ) s.tileb = to_long(val);
+        else if ( cmp(set, "tilefac") ) s.tilefac = std::atof(val);
 
         else {
-            std::cout << "FAILURE: unknown setting in settings file: " << set << std::endl;
-            exit(EXIT_FAILURE);
+            err = std::string("unknown setting in settings file: ") + set;
+            return(false);
         }
     }
 
-    return(s);
+    return(true);
 }
 
-Settings copy_settings (Settings &b) {
+Settings copy_settings (const Settings &b) {
     //blank struct
     Settings a;
     //grid
@@ -98,7 +255,19 @@ Settings copy_settings (Settings &b) {
     a.tunit = b.tunit;
     a.nsnap = b.nsnap;
     a.nmaxout = b.nmaxout;
+    a.dtout = b.dtout;
+    a.nchunk = b.nchunk;
+    a.store = b.store;
+    a.compress = b.compress;
+    a.ctol = b.ctol;
+    a.nwriter = b.nwriter;
+    a.checkpoint = b.checkpoint;
+    a.ckptint = b.ckptint;
     a.dtfac = b.dtfac;
+    a.sens = b.sens;
+    a.rom = b.rom;
+    a.romtol = b.romtol;
+    a.romerr = b.romerr;
     //physical
     a.poro = b.poro;
     a.perm = b.perm;
@@ -112,6 +281,7 @@ Settings copy_settings (Settings &b) {
     a.Levap = b.Levap;
     a.infper = b.infper;
     a.infdur = b.infdur;
+    a.forcing = b.forcing;
     //trackers and output
     a.poroc = b.poroc;
     a.poroe = b.poroe;
@@ -130,8 +300,23 @@ Settings copy_settings (Settings &b) {
     a.qbot = b.qbot;
     a.qall = b.qall;
     a.infil = b.infil;
+    a.limit = b.limit;
     a.t = b.t;
     a.tsnap = b.tsnap;
+    a.probes = b.probes;
+    a.metrics_only = b.metrics_only;
+    a.scaling = b.scaling;
+    a.status = b.status;
+    a.watchdog = b.watchdog;
+    a.maxwall = b.maxwall;
+    a.maxstep = b.maxstep;
+    a.maxper = b.maxper;
+    a.dtmin = b.dtmin;
+    a.colthreads = b.colthreads;
+    a.colmin = b.colmin;
+    a.tilek = b.tilek;
+    a.tileb = b.tileb;
+    a.tilefac = b.tilefac;
 
     return(a);
 }
@@ -7,6 +7,7 @@
 #include <vector>
 #include <string>
 #include <string.h>
+#include <cstdint>
 #include <cstdlib>
 
 //!container struct for all the settings variables needed for a BousThermModel run
@@ -37,8 +38,32 @@ struct Settings {
     long nsnap;
     //!maximum length of output vectors (subsampled to accomodate)
     long nmaxout;
+    //!time interval between tracker samples (s), interpolated between steps, or zero to track every step
+    double dtout;
+    //!number of tracker rows written to disk at a time during integration, or zero to write trackers at the end
+    long nchunk;
+    //!whether to write all output into a single indexed store file instead of separate files
+    bool store;
+    //!whether to compress tracker outputs
+    bool compress;
+    //!relative rounding tolerance of compressed tracker outputs, or zero for lossless compression
+    double ctol;
+    //!number of threads writing batch trial output, or zero to write from the compute threads
+    long nwriter;
+    //!whether to write checkpoints periodically and on SIGTERM, and restart from them
+    bool checkpoint;
+    //!wall clock time between periodic checkpoints (s), or zero to only checkpoint on SIGTERM
+    double ckptint;
     //!safety factor for stable time step
     double dtfac;
+    //!whether to integrate flux sensitivities to perm, b, wilt, and poro
+    bool sens;
+    //!whether batch trials are spun up with a reduced-order model
+    bool rom;
+    //!fraction of snapshot energy left out of the reduced-order bases
+    double romtol;
+    //!reduced-order error indicator tolerance, above which the full model takes over
+    double romerr;
 
     //-------------------------------------
     //physical parameters
@@ -69,6 +94,8 @@ struct Settings {
     double infper;
     //!infiltration duration (s)
     double infdur;
+    //!path to a series of observed surface forcing replacing the periodic infiltration, or "none"
+    std::string forcing;
 
     //-------------------------------------
     //trackers and output
@@ -107,10 +134,40 @@ struct Settings {
     bool qall;
     //!whether to track infiltration flag
     bool infil;
+    //!whether to track the constraint bounding each step
+    bool limit;
     //!whether to track step times
     bool t;
     //!whether to track snap times
     bool tsnap;
+    //!depths (m) of extra edges whose fluxes are integrated during solves
+    std::vector<double> probes;
+    //!whether batch trials only write integrated metrics into a single table
+    bool metrics_only;
+    //!number of batch trials sampled from the sweep to measure how throughput scales with threads, instead of running the sweep, or zero
+    long scaling;
+    //!wall clock time between writes of a batch sweep's status file (s), or zero to print a line per trial instead
+    double status;
+    //!whether integrations are abandoned when they run out of budget, their solution stops being finite, or their stable time step collapses
+    bool watchdog;
+    //!wall clock budget of each model (s), or zero for none
+    double maxwall;
+    //!step budget of each model, or zero for none
+    long maxstep;
+    //!budget of spinup periods, or zero for none
+    long maxper;
+    //!smallest stable time step before an integration counts as stalled (s)
+    double dtmin;
+    //!number of threads sharing the loops over a single column
+    long colthreads;
+    //!smallest number of cells for which a column's loops are shared between threads
+    long colmin;
+    //!most steps in a window of temporally tiled spinup integration, or zero to integrate spinups step by step
+    long tilek;
+    //!number of cells in a block of temporally tiled integration
+    long tileb;
+    //!factor shrinking the diffusion-limited step of a tiled window, keeping it stable through the window
+    double tilefac;
 
 };
 
@@ -123,16 +180,49 @@ bool cmp (const char *s1, const char *s2);
 //!converts a character to an integet
 long to_long(const char *val);
 
-//!parses a settings file and returns it in a Settings structure
+//!converts a comma separated list of numbers, or "none", into a vector
+std::vector<double> to_list (const char *val);
+
+//!turns off every tracker and output variable
+void disable_output (Settings &s);
+
+//!sets the settings added since the original ones to defaults reproducing the original behavior, so they may be left out of settings files
+void default_settings (Settings &s);
+
+//!adapts settings to programs integrating many spun up trials in parallel, with one thread per trial and the periodic forcing
+void sweep_settings (Settings &s);
+
+//!hashes the settings that determine a model's trajectory and output, to check that checkpoints match a run
+uint64_t hash_settings (const Settings &s);
+
+//!replaces the value of a setting read from a settings file
+/*!
+\param[in,out] sv vector of vectors of strings from read_values()
+\param[in] key name of the setting
+\param[in] value new value, as it would appear in the file
+\return false if the file has no such setting
+*/
+bool override_value (std::vector< std::vector< std::string > > &sv, const std::string &key, const std::string &value);
+
+//!parses a settings file and returns it in a Settings structure, quitting if it has an unknown setting, with defaults from default_settings() for settings it leaves out
 /*!
 \param[in] sv vector of vectors of strings from read_values_file()
 */
 Settings parse_settings ( std::vector< std::vector< std::string > > sv );
 
+//!parses a settings file into a Settings structure without quitting, for programs that embed the model
+/*!
+\param[in] sv vector of vectors of strings from read_values()
+\param[out] s parsed settings
+\param[out] err description of the failure, if any
+\return false if the file has an unknown setting
+*/
+bool parse_settings (const std::vector< std::vector< std::string > > &sv, Settings &s, std::string &err);
+
 //!constructs a copy of another Settings object
 /*!
 \param[in] b the Settings object to copy
 */
-Settings copy_settings (Settings &b);
+Settings copy_settings (const Settings &b);
 
 #endif
@@ -0,0 +1,265 @@
+//! \file store.cc
+
+#include <set>
+#include <cstring>
+#include <unistd.h>
+
+#include "store.h"
+
+Store::Store (const std::string &fn, bool reopen) :
+    fn (fn) {
+
+    mem = NULL;
+    memsize = 0;
+
+    static_assert(sizeof(StoreHeader) == STORE_ALIGN, "store header must be one alignment unit");
+    static_assert(sizeof(StoreRecord) % STORE_ALIGN == 0, "store records must be aligned");
+
+    if ( reopen && reopen_file() )
+        return;
+
+    ofile = fopen(fn.c_str(), "wb");
+    if ( ofile == NULL ) {
+        printf("FAILURE: cannot open store file %s\n", fn.c_str());
+        exit(EXIT_FAILURE);
+    }
+    //header without an index, until closed
+    StoreHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, "RICHSTOR", 8);
+    h.version = 1;
+    fwrite(&h, sizeof(h), 1, ofile);
+    pos = sizeof(h);
+}
+
+bool Store::reopen_file () {
+
+    ofile = fopen(fn.c_str(), "r+b");
+    if ( ofile == NULL )
+        return(false);
+    StoreHeader h;
+    if ( (fread(&h, sizeof(h), 1, ofile) != 1) || (memcmp(h.magic, "RICHSTOR", 8) != 0) ) {
+        printf("FAILURE: %s is not a store file\n", fn.c_str());
+        exit(EXIT_FAILURE);
+    }
+    fseek(ofile, 0, SEEK_END);
+    uint64_t len = ftell(ofile);
+    StoreRecord r;
+    if ( h.index > 0 ) {
+        //records from the index, which is overwritten by the next record
+        records.resize(h.nrec);
+        fseek(ofile, h.index, SEEK_SET);
+        if ( (h.nrec > 0) && (fread(records.data(), sizeof(r), h.nrec, ofile) != h.nrec) )
+            print_exit("store index is incomplete");
+        pos = h.index;
+    } else {
+        //walk the records, stopping at the first incomplete one
+        pos = sizeof(h);
+        while ( pos + sizeof(r) <= len ) {
+            fseek(ofile, pos, SEEK_SET);
+            if ( fread(&r, sizeof(r), 1, ofile) != 1 )
+                break;
+            if ( (r.offset != pos + sizeof(r)) || (r.offset + r.nbytes > len) )
+                break;
+            records.push_back(r);
+            pos = r.offset + r.nbytes;
+            if ( pos % STORE_ALIGN != 0 )
+                pos += STORE_ALIGN - pos % STORE_ALIGN;
+        }
+    }
+    //unclosed again, with nothing after the last record
+    h.index = 0;
+    h.nrec = 0;
+    fseek(ofile, 0, SEEK_SET);
+    fwrite(&h, sizeof(h), 1, ofile);
+    fflush(ofile);
+    if ( ftruncate(fileno(ofile), pos) != 0 )
+        print_exit("cannot truncate a reopened store file");
+    fseek(ofile, pos, SEEK_SET);
+    return(true);
+}
+
+Store::Store () {
+    mem = NULL;
+    memsize = 0;
+    ofile = open_memstream(&mem, &memsize);
+    if ( ofile == NULL )
+        print_exit("cannot open an in-memory store");
+    //no header in memory
+    pos = 0;
+}
+
+Store::~Store () {
+    close();
+    free(mem);
+}
+
+void Store::pad () {
+    static const char zeros[STORE_ALIGN] = {0};
+    uint64_t r = pos % STORE_ALIGN;
+    if ( r != 0 ) {
+        fwrite(zeros, 1, STORE_ALIGN - r, ofile);
+        pos += STORE_ALIGN - r;
+    }
+}
+
+FILE *Store::begin (const std::string &key, const char *dtype, long size, long nrow, long ncol) {
+
+    if ( key.size() >= STORE_KEY )
+        print_exit("store key is too long");
+
+    StoreRecord r;
+    memset(&r, 0, sizeof(r));
+    memcpy(r.key, key.c_str(), key.size());
+    strncpy(r.dtype, dtype, sizeof(r.dtype) - 1);
+    r.nrow = nrow;
+    r.ncol = ncol;
+    r.nbytes = uint64_t(nrow)*uint64_t(ncol)*uint64_t(size);
+
+    mtx.lock();
+    return( start(r) );
+}
+
+FILE *Store::start (StoreRecord &r) {
+    if ( ofile == NULL ) {
+        mtx.unlock();
+        print_exit("cannot append to a closed store");
+    }
+    r.offset = pos + sizeof(r);
+    fwrite(&r, sizeof(r), 1, ofile);
+    records.push_back(r);
+    pos = r.offset + r.nbytes;
+    return(ofile);
+}
+
+void Store::end () {
+    pad();
+    mtx.unlock();
+}
+
+void Store::append (Store &other) {
+
+    if ( !other.fn.empty() || (other.ofile != NULL) )
+        print_exit("only closed in-memory stores can be appended to another store");
+
+    std::lock_guard<std::mutex> lock(mtx);
+    for (unsigned long l=0; l<other.records.size(); l++) {
+        StoreRecord r = other.records[l];
+        uint64_t offset = r.offset;
+        start(r);
+        fwrite(other.mem + offset, 1, r.nbytes, ofile);
+        pad();
+    }
+}
+
+void Store::write_files (const std::string &dirout) {
+
+    if ( !fn.empty() || (ofile != NULL) )
+        print_exit("only closed in-memory stores can be written to files");
+
+    //repeated keys, from spilled trackers, are appended
+    std::set<std::string> keys;
+    for (unsigned long l=0; l<records.size(); l++) {
+        const StoreRecord &r = records[l];
+        std::string key = r.key;
+        std::string path = dirout + "/" + key;
+        if ( strcmp(r.dtype, "|cmp") == 0 )
+            path += ".cmp";
+        FILE *f;
+        if ( keys.insert(key).second ) {
+            check_file_write(path.c_str());
+            f = fopen(path.c_str(), "wb");
+        } else {
+            f = fopen(path.c_str(), "ab");
+        }
+        fwrite(mem + r.offset, 1, r.nbytes, f);
+        fclose(f);
+    }
+}
+
+void Store::close () {
+
+    std::lock_guard<std::mutex> lock(mtx);
+    if ( ofile == NULL )
+        return;
+    //in memory, the records stay readable until destruction
+    if ( fn.empty() ) {
+        fclose(ofile);
+        ofile = NULL;
+        return;
+    }
+    //index of all records
+    uint64_t index = pos;
+    if ( !records.empty() )
+        fwrite(records.data(), sizeof(StoreRecord), records.size(), ofile);
+    //point the header at the index
+    StoreHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, "RICHSTOR", 8);
+    h.version = 1;
+    h.index = index;
+    h.nrec = records.size();
+    fseek(ofile, 0, SEEK_SET);
+    fwrite(&h, sizeof(h), 1, ofile);
+    fclose(ofile);
+    ofile = NULL;
+}
+
+uint64_t Store::size () {
+    std::lock_guard<std::mutex> lock(mtx);
+    return(pos);
+}
+
+void Store::truncate (uint64_t size) {
+
+    std::lock_guard<std::mutex> lock(mtx);
+    if ( in_memory() || (ofile == NULL) )
+        print_exit("only open store files can be truncated");
+    if ( size >= pos )
+        return;
+    while ( !records.empty() && (records.back().offset - sizeof(StoreRecord) >= size) )
+        records.pop_back();
+    pos = size;
+    fflush(ofile);
+    if ( ftruncate(fileno(ofile), pos) != 0 )
+        print_exit("cannot truncate a store file");
+    fseek(ofile, pos, SEEK_SET);
+}
+
+void Store::save (FILE *f) {
+
+    std::lock_guard<std::mutex> lock(mtx);
+    if ( !in_memory() || (ofile == NULL) )
+        print_exit("only open in-memory stores can be saved");
+    //the buffer is only up to date after flushing
+    fflush(ofile);
+    uint64_t nrec = records.size();
+    fwrite(&nrec, sizeof(nrec), 1, f);
+    fwrite(records.data(), sizeof(StoreRecord), nrec, f);
+    fwrite(&pos, sizeof(pos), 1, f);
+    fwrite(mem, 1, pos, f);
+}
+
+void Store::load (FILE *f) {
+
+    std::lock_guard<std::mutex> lock(mtx);
+    if ( !in_memory() || (ofile == NULL) || (pos != 0) )
+        print_exit("only empty in-memory stores can be loaded");
+    uint64_t nrec, size;
+    std::vector<char> data;
+    bool ok = (fread(&nrec, sizeof(nrec), 1, f) == 1);
+    if ( ok ) {
+        records.resize(nrec);
+        ok = (fread(records.data(), sizeof(StoreRecord), nrec, f) == nrec);
+    }
+    if ( ok )
+        ok = (fread(&size, sizeof(size), 1, f) == 1);
+    if ( ok ) {
+        data.resize(size);
+        ok = (fread(data.data(), 1, size, f) == size);
+    }
+    if ( !ok )
+        print_exit("checkpoint file ended unexpectedly");
+    fwrite(data.data(), 1, size, ofile);
+    pos = size;
+}
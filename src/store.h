@@ -0,0 +1,169 @@
+#ifndef STORE_H_
+#define STORE_H_
+
+//! \file store.h
+
+#include <cstdio>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <mutex>
+
+#include "io.h"
+
+//!alignment of every record in a store, in bytes
+#define STORE_ALIGN 64
+//!maximum length of a record key, including the terminating null
+#define STORE_KEY 80
+
+//!header at the start of a store file
+struct StoreHeader {
+    //!identifies the format, "RICHSTOR"
+    char magic[8];
+    //!format version
+    uint64_t version;
+    //!offset of the index, or zero if the store wasn't closed
+    uint64_t index;
+    //!number of records in the index
+    uint64_t nrec;
+    //!unused
+    char pad[32];
+};
+
+//!description of a record, written before its data and again in the index
+struct StoreRecord {
+    //!null-padded key, like "12_qbot"
+    char key[STORE_KEY];
+    //!numpy type string, like "<f4"
+    char dtype[8];
+    //!number of rows
+    int64_t nrow;
+    //!number of columns
+    int64_t ncol;
+    //!offset of the data
+    uint64_t offset;
+    //!number of bytes of data
+    uint64_t nbytes;
+    //!unused
+    char pad[8];
+};
+
+//!numpy type string of a C++ type
+template <class T> const char *store_dtype ();
+template <> inline const char *store_dtype<float> () { return("<f4"); }
+template <> inline const char *store_dtype<double> () { return("<f8"); }
+template <> inline const char *store_dtype<long> () { return("<i8"); }
+
+//!single-file, indexed container for the output of a run or a whole sweep
+/*!
+Instead of a small file for every variable of every trial, outputs are appended to one file as records. Each record starts with a StoreRecord describing its key, type and shape, followed by its row-major data, and both are padded to STORE_ALIGN bytes so that the data can be mapped in place. When the store is closed, a copy of all the record descriptions is appended as an index and its offset is written into the header. If a run dies before closing the store, every completed record can still be found by walking the file from the header. The same key may be appended more than once, as when trackers are spilled in chunks, in which case the records are concatenated along their rows by readers. Appending is serialized, so any number of threads can share a store. `scripts/store.py` reads stores with `numpy.memmap`.
+
+A store can also be kept in memory, without a header or index, to capture the output of a single trial. Once closed, its records can be appended to another store or written to their own files.
+
+To continue a run from a checkpoint, a store file can be reopened. Its records are read from the index, or by walking the file if it wasn't closed, and any incomplete record at the end is dropped. An in-memory store can be saved whole into a checkpoint and loaded again.
+*/
+class Store {
+
+public:
+
+    //!creates a store file, overwriting any existing one unless reopening it
+    /*!
+    \param[in] fn path to the store file
+    \param[in] reopen whether to keep appending to an existing store file, if there is one
+    */
+    Store (const std::string &fn, bool reopen=false);
+    //!creates an empty store in memory
+    Store ();
+    //!closes the store
+    ~Store ();
+
+    //!appends an array as a record
+    /*!
+    \param[in] key record key
+    \param[in] a row-major array
+    \param[in] nrow number of rows
+    \param[in] ncol number of columns
+    */
+    template <class T>
+    void append (const std::string &key, const T *a, long nrow, long ncol=1) {
+        FILE *ofile = begin(key, store_dtype<T>(), sizeof(T), nrow, ncol);
+        fwrite(a, sizeof(T), nrow*ncol, ofile);
+        end();
+    }
+
+    //!appends a vector as a record
+    template <class T>
+    void append (const std::string &key, const std::vector<T> &a) {
+        append(key, a.data(), long(a.size()));
+    }
+
+    //!starts a record whose data will be written by the caller
+    /*!
+    Exactly nrow*ncol*size bytes must be written to the returned file before calling end(). The store is locked in between.
+    \param[in] key record key
+    \param[in] dtype numpy type string
+    \param[in] size number of bytes in each element
+    \param[in] nrow number of rows
+    \param[in] ncol number of columns
+    \return the file to write the data into
+    */
+    FILE *begin (const std::string &key, const char *dtype, long size, long nrow, long ncol);
+
+    //!finishes a record started with begin()
+    void end ();
+
+    //!writes the index and header and closes the file
+    void close ();
+
+    //!appends copies of all the records of a closed, in-memory store
+    void append (Store &other);
+
+    //!writes every record of a closed, in-memory store into its own file, as if no store were used
+    /*!
+    \param[in] dirout output directory
+    */
+    void write_files (const std::string &dirout);
+
+    //!checks whether the store is kept in memory
+    bool in_memory () { return( fn.empty() ); }
+
+    //!gets the number of bytes written, which marks the end of the latest record
+    uint64_t size ();
+
+    //!drops every record that starts at or beyond an earlier size of an open store file
+    void truncate (uint64_t size);
+
+    //!writes the records of an open, in-memory store into a checkpoint
+    void save (FILE *f);
+
+    //!appends records saved by save() to an empty, in-memory store
+    void load (FILE *f);
+
+private:
+
+    //!writes zeros up to the next aligned offset
+    void pad ();
+
+    //!writes a record's description, filling in its offset, with the store locked
+    FILE *start (StoreRecord &r);
+
+    //!reads the records of an existing store file and positions it to append more
+    bool reopen_file ();
+
+    //!path to the store file, empty if in memory
+    std::string fn;
+    //!open store file
+    FILE *ofile;
+    //!offset of the end of the file
+    uint64_t pos;
+    //!buffer of an in-memory store
+    char *mem;
+    //!size of the buffer of an in-memory store
+    size_t memsize;
+    //!descriptions of all records
+    std::vector<StoreRecord> records;
+    //!serializes appending
+    std::mutex mtx;
+};
+
+#endif
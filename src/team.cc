@@ -0,0 +1,86 @@
+//! \file team.cc
+
+#include "team.h"
+
+//!number of times a thread checks for work, or the caller for finished chunks, before yielding its core between checks
+#define TEAM_YIELD 1000
+//!number of times a thread checks for work before going to sleep
+#define TEAM_SPIN 100000
+
+Team::Team (int nthread) : nthread (nthread) {
+
+    epoch.store(0);
+    pending.store(0);
+    nsleep.store(0);
+    stop.store(false);
+    m = 0;
+    kernel = NULL;
+    func = NULL;
+    for (int tid=1; tid<nthread; tid++)
+        threads.push_back( std::thread(&Team::work, this, tid) );
+}
+
+Team::~Team () {
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        stop.store(true);
+        epoch.fetch_add(1);
+    }
+    cv.notify_all();
+    for (unsigned long i=0; i<threads.size(); i++)
+        threads[i].join();
+}
+
+void Team::chunk (int tid) {
+    long i0 = (m*tid)/nthread,
+         i1 = (m*(tid + 1))/nthread;
+    if ( i1 > i0 )
+        kernel(func, i0, i1, tid);
+}
+
+void Team::post (long m_, Kernel k, const void *f) {
+
+    m = m_;
+    kernel = k;
+    func = f;
+    pending.store(nthread - 1);
+    //publishes the loop, and wakes any threads that gave up spinning
+    epoch.fetch_add(1);
+    if ( nsleep.load() > 0 ) {
+        std::lock_guard<std::mutex> lock(mtx);
+        cv.notify_all();
+    }
+    chunk(0);
+    long spin = 0;
+    while ( pending.load(std::memory_order_acquire) > 0 )
+        if ( ++spin > TEAM_YIELD )
+            std::this_thread::yield();
+}
+
+void Team::work (int tid) {
+
+    unsigned long seen = 0, e;
+    while ( true ) {
+        //spin for a new loop, then sleep until one is posted
+        long spin = 0;
+        while ( (e = epoch.load(std::memory_order_acquire)) == seen ) {
+            if ( ++spin < TEAM_SPIN ) {
+                if ( spin > TEAM_YIELD )
+                    std::this_thread::yield();
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(mtx);
+            nsleep.fetch_add(1);
+            //checked again under the lock, which the poster takes before notifying
+            while ( epoch.load() == seen )
+                cv.wait(lock);
+            nsleep.fetch_sub(1);
+            spin = 0;
+        }
+        seen = e;
+        if ( stop.load() )
+            break;
+        chunk(tid);
+        pending.fetch_sub(1, std::memory_order_release);
+    }
+}
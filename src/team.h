@@ -0,0 +1,82 @@
+#ifndef TEAM_H_
+#define TEAM_H_
+
+//! \file team.h
+
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <condition_variable>
+
+//!persistent team of threads sharing the loops of a single integration
+/*!
+The threads are started once and kept for the life of the team, so a kernel handed to the team is only a matter of bumping a counter that the waiting threads spin on, with no threads created or joined per call. The calling thread works on the first chunk of every loop itself. Threads that have spun for a while without work go to sleep on a condition variable, so a team doesn't burn its cores through long serial stretches like output or checkpoints.
+
+Loops are split into one contiguous chunk per thread, so every index is handled by the same thread on every call, and results don't depend on the number of threads as long as the loop body only writes its own indices.
+*/
+class Team {
+
+public:
+
+    //!starts the team's threads
+    /*!
+    \param[in] nthread number of threads, including the calling thread
+    */
+    Team (int nthread);
+    //!stops the team's threads
+    ~Team ();
+
+    //!gets the number of threads, including the calling thread
+    int size () { return(nthread); }
+
+    //!runs a loop over [0,m) on the team, returning once every chunk is done
+    /*!
+    \param[in] m number of indices
+    \param[in] f function called as f(i0, i1, tid) for the indices [i0,i1) of thread tid, without throwing
+    */
+    template <class F>
+    void run (long m, const F &f) {
+        //the callable is passed through a plain function pointer, so handing it over allocates nothing
+        post(m, [] (const void *p, long i0, long i1, int tid) { (*(const F*)p)(i0, i1, tid); }, &f);
+    }
+
+private:
+
+    //!type of the function pointers running a chunk of a loop
+    typedef void (*Kernel)(const void *f, long i0, long i1, int tid);
+
+    //!hands a loop to the team, works on the first chunk, and waits for the rest
+    void post (long m, Kernel k, const void *f);
+
+    //!waits for loops and works on one chunk of each, until stopped
+    void work (int tid);
+
+    //!runs one thread's chunk of the current loop
+    void chunk (int tid);
+
+    //!number of threads, including the caller
+    int nthread;
+    //!threads other than the caller
+    std::vector<std::thread> threads;
+    //!number of loops handed to the team, which the threads watch for a change
+    std::atomic<unsigned long> epoch;
+    //!number of chunks still running in the current loop
+    std::atomic<int> pending;
+    //!number of threads asleep
+    std::atomic<int> nsleep;
+    //!whether the threads should stop
+    std::atomic<bool> stop;
+    //!length of the current loop
+    long m;
+    //!runs chunks of the current loop
+    Kernel kernel;
+    //!callable of the current loop
+    const void *func;
+    //!protects sleeping
+    std::mutex mtx;
+    //!wakes sleeping threads
+    std::condition_variable cv;
+};
+
+#endif
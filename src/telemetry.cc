@@ -0,0 +1,221 @@
+//! \file telemetry.cc
+
+#include <cmath>
+#include <chrono>
+#include <cstdio>
+#include <algorithm>
+
+#include "checkpoint.h"
+#include "telemetry.h"
+
+Telemetry::Telemetry (const std::string &fn, const std::vector<long> &cls, int nthread, double interval) :
+    fn (fn),
+    cls (cls),
+    ntrial (cls.size()),
+    nthread (nthread),
+    interval (interval) {
+
+    ncls = 0;
+    for (unsigned long i=0; i<ntrial; i++)
+        if ( cls[i] + 1 > ncls )
+            ncls = cls[i] + 1;
+    state.reset(new std::atomic<int>[ntrial]);
+    ttrial.reset(new std::atomic<double>[ntrial]);
+    for (unsigned long i=0; i<ntrial; i++) {
+        state[i].store(0);
+        ttrial[i].store(0.0);
+    }
+    threads.reset(new ThreadProgress[nthread]);
+    for (int j=0; j<nthread; j++) {
+        threads[j].nstep.store(0);
+        threads[j].nperiod.store(0);
+        threads[j].trial.store(-1);
+        threads[j].tstart.store(0.0);
+    }
+    nprev.assign(nthread, 0);
+    tstart = wall_time();
+    tprev = tstart;
+    stopping = false;
+    reporter = std::thread(&Telemetry::run, this);
+}
+
+Telemetry::~Telemetry () {
+    stop();
+}
+
+void Telemetry::stop () {
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        stopping = true;
+    }
+    cv.notify_all();
+    if ( reporter.joinable() )
+        reporter.join();
+}
+
+void Telemetry::skip (unsigned long trial) {
+    state[trial].store(3, std::memory_order_release);
+}
+
+ThreadProgress *Telemetry::start (unsigned long trial, int tid) {
+    ThreadProgress *p = &threads[tid];
+    p->tstart.store(wall_time(), std::memory_order_relaxed);
+    p->trial.store(long(trial), std::memory_order_relaxed);
+    state[trial].store(1, std::memory_order_release);
+    return(p);
+}
+
+void Telemetry::finish (unsigned long trial, int tid, bool done) {
+    ThreadProgress *p = &threads[tid];
+    if ( done )
+        ttrial[trial].store(wall_time() - p->tstart.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    p->trial.store(-1, std::memory_order_relaxed);
+    //the time is stored before the state that publishes it
+    state[trial].store(done ? 2 : 0, std::memory_order_release);
+}
+
+void Telemetry::run () {
+    std::unique_lock<std::mutex> lock(mtx);
+    while ( !stopping ) {
+        cv.wait_for(lock, std::chrono::duration<double>(interval));
+        if ( stopping )
+            break;
+        lock.unlock();
+        report();
+        lock.lock();
+    }
+}
+
+void Telemetry::report () {
+
+    double now = wall_time(), dt = now - tprev, elapsed = now - tstart;
+
+    //trials, and the mean time of finished trials in each class
+    unsigned long ndone = 0, nrun = 0, nskip = 0, ntodo = 0;
+    std::vector<double> csum(ncls, 0.0);
+    std::vector<unsigned long> ccount(ncls, 0);
+    double tsum = 0.0;
+    for (unsigned long i=0; i<ntrial; i++) {
+        int s = state[i].load(std::memory_order_acquire);
+        if ( s == 2 ) {
+            double t = ttrial[i].load(std::memory_order_relaxed);
+            ndone++;
+            tsum += t;
+            csum[cls[i]] += t;
+            ccount[cls[i]]++;
+        } else if ( s == 1 ) {
+            nrun++;
+        } else if ( s == 3 ) {
+            nskip++;
+        } else {
+            ntodo++;
+        }
+    }
+    double tmean = (ndone > 0) ? tsum/ndone : NAN;
+    //expected time of a trial in each class
+    std::vector<double> cmean(ncls);
+    for (long c=0; c<ncls; c++)
+        cmean[c] = (ccount[c] > 0) ? csum[c]/ccount[c] : tmean;
+    //remaining work, divided among the threads
+    double work = 0.0;
+    for (unsigned long i=0; i<ntrial; i++)
+        if ( state[i].load(std::memory_order_relaxed) == 0 )
+            work += cmean[cls[i]];
+
+    //threads, their step rates, and those that haven't taken a step since the last report
+    unsigned long nstep = 0, nperiod = 0;
+    long nstall = 0;
+    std::vector<long> trial(nthread);
+    std::vector<double> rate(nthread), trun(nthread);
+    for (int j=0; j<nthread; j++) {
+        unsigned long m = threads[j].nstep.load(std::memory_order_relaxed);
+        nstep += m;
+        nperiod += threads[j].nperiod.load(std::memory_order_relaxed);
+        trial[j] = threads[j].trial.load(std::memory_order_relaxed);
+        rate[j] = (dt > 0) ? (m - nprev[j])/dt : 0.0;
+        trun[j] = (trial[j] >= 0) ? now - threads[j].tstart.load(std::memory_order_relaxed) : 0.0;
+        if ( trial[j] >= 0 ) {
+            if ( (m == nprev[j]) && (trun[j] > dt) )
+                nstall++;
+            work += std::max(cmean[cls[trial[j]]] - trun[j], 0.0);
+        }
+        nprev[j] = m;
+    }
+    double eta = (ntodo + nrun == 0) ? 0.0 : work/nthread;
+    tprev = now;
+
+    //replace the status file atomically, so a reader never sees half of it
+    std::string tmp = fn + ".tmp";
+    FILE *ofile = fopen(tmp.c_str(), "w");
+    if ( ofile == NULL )
+        return;
+    fprintf(ofile, "{\n");
+    fprintf(ofile, "  \"elapsed\": %.3f,\n", elapsed);
+    fprintf(ofile, "  \"trials\": %lu,\n", ntrial);
+    fprintf(ofile, "  \"done\": %lu,\n", ndone);
+    fprintf(ofile, "  \"running\": %lu,\n", nrun);
+    fprintf(ofile, "  \"skipped\": %lu,\n", nskip);
+    fprintf(ofile, "  \"remaining\": %lu,\n", ntodo);
+    fprintf(ofile, "  \"trials_per_s\": %.6g,\n", (elapsed > 0) ? ndone/elapsed : 0.0);
+    fprintf(ofile, "  \"trial_mean_s\": %.6g,\n", (ndone > 0) ? tmean : 0.0);
+    fprintf(ofile, "  \"steps\": %lu,\n", nstep);
+    fprintf(ofile, "  \"steps_per_s\": %.6g,\n", (elapsed > 0) ? nstep/elapsed : 0.0);
+    fprintf(ofile, "  \"spinup_periods\": %lu,\n", nperiod);
+    fprintf(ofile, "  \"stalled\": %ld,\n", nstall);
+    if ( std::isnan(eta) ) {
+        fprintf(ofile, "  \"eta_s\": null,\n");
+    } else {
+        fprintf(ofile, "  \"eta_s\": %.3f,\n", eta);
+    }
+    fprintf(ofile, "  \"threads\": [\n");
+    for (int j=0; j<nthread; j++)
+        fprintf(ofile, "    {\"trial\": %ld, \"trial_s\": %.3f, \"steps_per_s\": %.6g}%s\n",
+            trial[j], trun[j], rate[j], (j < nthread - 1) ? "," : "");
+    fprintf(ofile, "  ]\n}\n");
+    fclose(ofile);
+    rename(tmp.c_str(), fn.c_str());
+
+    //one line for the job's log
+    printf("  [%9.0f s] %lu/%lu trials done, %lu running, %.3g steps/s, ",
+        elapsed, ndone + nskip, ntrial, nrun, (elapsed > 0) ? nstep/elapsed : 0.0);
+    if ( std::isnan(eta) ) {
+        printf("eta unknown");
+    } else {
+        printf("eta %.0f s", eta);
+    }
+    if ( nstall > 0 )
+        printf(", %ld threads stalled", nstall);
+    printf("\n");
+    fflush(stdout);
+}
+
+void Telemetry::summary () {
+
+    //the final status, written once the reporter can't write it too
+    stop();
+    report();
+
+    double elapsed = wall_time() - tstart, tsum = 0.0, tmax = 0.0;
+    unsigned long ndone = 0, nstep = 0, nperiod = 0;
+    for (unsigned long i=0; i<ntrial; i++) {
+        if ( state[i].load(std::memory_order_acquire) == 2 ) {
+            double t = ttrial[i].load(std::memory_order_relaxed);
+            ndone++;
+            tsum += t;
+            tmax = std::max(tmax, t);
+        }
+    }
+    for (int j=0; j<nthread; j++) {
+        nstep += threads[j].nstep.load(std::memory_order_relaxed);
+        nperiod += threads[j].nperiod.load(std::memory_order_relaxed);
+    }
+    printf("sweep summary:\n");
+    printf("  %lu trials integrated in %.1f s on %d threads, %.3g trials/s\n",
+        ndone, elapsed, nthread, (elapsed > 0) ? ndone/elapsed : 0.0);
+    if ( ndone > 0 ) {
+        printf("  trial time: mean %.3g s, max %.3g s, threads busy %.1f %% of the time\n",
+            tsum/ndone, tmax, 100*tsum/(nthread*elapsed));
+        printf("  %lu steps, %.3g steps/s, %.3g spinup periods per trial\n",
+            nstep, nstep/elapsed, double(nperiod)/ndone);
+    }
+}
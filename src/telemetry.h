@@ -0,0 +1,122 @@
+#ifndef TELEMETRY_H_
+#define TELEMETRY_H_
+
+//! \file telemetry.h
+
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <condition_variable>
+
+//!progress of the trial running on one thread, written only by that thread
+/*!
+Each counter has a single writer, so it's advanced with a relaxed load and store instead of a locked read-modify-write, and the reporter reads it without ever blocking the integration. Slots are aligned to cache lines so threads don't share them.
+*/
+struct alignas(64) ThreadProgress {
+    //!steps taken on this thread
+    std::atomic<unsigned long> nstep;
+    //!spinup periods integrated on this thread
+    std::atomic<unsigned long> nperiod;
+    //!running trial, or -1
+    std::atomic<long> trial;
+    //!wall clock time the running trial started
+    std::atomic<double> tstart;
+
+    //!counts a step
+    void step () { nstep.store(nstep.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed); }
+    //!counts a spinup period
+    void period () { nperiod.store(nperiod.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed); }
+};
+
+//!keeps lock-free counters of a batch sweep and periodically writes them into a small status file
+/*!
+The status file is JSON, replaced atomically so it can be polled at any time. It holds the numbers of trials done and running, step and trial rates, cumulative spinup periods, each thread's running trial and step rate, the number of threads that seem stalled, and an estimate of the time to completion. A one-line summary is also printed each time the file is written, instead of a line per trial.
+
+The estimate comes from a cost model of the trials: each trial belongs to a class, like its infiltration period, and a trial still to run is expected to take the mean time of the finished trials in its class, or of all finished trials if none of its class have finished. Running trials are expected to take the rest of their class mean. The total is divided among the threads.
+*/
+class Telemetry {
+
+public:
+
+    //!starts the reporter thread
+    /*!
+    \param[in] fn path to the status file
+    \param[in] cls cost class of each trial
+    \param[in] nthread number of integrating threads
+    \param[in] interval wall clock time between writes of the status file (s)
+    */
+    Telemetry (const std::string &fn, const std::vector<long> &cls, int nthread, double interval);
+    //!stops the reporter
+    ~Telemetry ();
+
+    //!marks a trial finished by an earlier run of the sweep, so it's neither run nor counted in rates
+    void skip (unsigned long trial);
+
+    //!marks a trial as running on a thread
+    /*!
+    \param[in] trial trial number
+    \param[in] tid number of the integrating thread
+    \return the thread's progress counters, for the trial's model to advance
+    */
+    ThreadProgress *start (unsigned long trial, int tid);
+
+    //!marks a trial as no longer running on a thread
+    /*!
+    \param[in] trial trial number
+    \param[in] tid number of the integrating thread
+    \param[in] done whether the trial finished, or else was interrupted and remains to be run
+    */
+    void finish (unsigned long trial, int tid, bool done=true);
+
+    //!stops the reporter, writes the status a final time, and prints a summary of the whole sweep
+    void summary ();
+
+private:
+
+    //!writes the status file and prints a line, every interval until stopped
+    void run ();
+
+    //!writes the status file and prints a line
+    void report ();
+
+    //!stops the reporter thread, if it's running
+    void stop ();
+
+    //!path to the status file
+    std::string fn;
+    //!cost class of each trial
+    std::vector<long> cls;
+    //!number of cost classes
+    long ncls;
+    //!state of each trial, 0 to run, 1 running, 2 done, 3 skipped
+    std::unique_ptr< std::atomic<int>[] > state;
+    //!wall clock time each finished trial took (s)
+    std::unique_ptr< std::atomic<double>[] > ttrial;
+    //!number of trials
+    unsigned long ntrial;
+    //!counters of each integrating thread
+    std::unique_ptr<ThreadProgress[]> threads;
+    //!number of integrating threads
+    int nthread;
+    //!wall clock time between reports (s)
+    double interval;
+    //!wall clock time the sweep started
+    double tstart;
+    //!time of the previous report
+    double tprev;
+    //!step counts of each thread at the previous report
+    std::vector<unsigned long> nprev;
+    //!reporter thread
+    std::thread reporter;
+    //!whether the reporter should stop
+    bool stopping;
+    //!protects stopping
+    std::mutex mtx;
+    //!wakes the reporter to stop
+    std::condition_variable cv;
+};
+
+#endif
@@ -0,0 +1,385 @@
+//! \file tracker.cc
+
+#include <unistd.h>
+
+#include "tracker.h"
+
+//!number of floats gathered at a time when writing columns
+#define TRACKER_CHUNK 4096
+
+Tracker::Tracker () {
+    busy = false;
+    stop = false;
+    store = NULL;
+    compress = false;
+    ctol = 0.0;
+    setup(0, 0, 0.0);
+}
+
+Tracker::~Tracker () {
+    close();
+}
+
+void Tracker::setup (long width_, unsigned long nmax_, double dtout_, unsigned long nchunk_) {
+    close();
+    outputs.clear();
+    width = width_;
+    nmax = nmax_;
+    nrow = 0;
+    nrecord = 0;
+    buf.clear();
+    nstep = 0;
+    stride = 1;
+    dtout = dtout_;
+    tnext = -INFINITY;
+    tlast = NAN;
+    nchunk = nchunk_;
+    pending.clear();
+    npending.clear();
+    spare.clear();
+    resume.clear();
+}
+
+void Tracker::add_output (const std::string &fn, long j, long ncol) {
+    TrackerOutput out;
+    out.fn = fn;
+    out.j = j;
+    out.ncol = ncol;
+    out.ofile = NULL;
+    if ( (nchunk > 0) && (store == NULL) ) {
+        std::string path = compress ? fn + ".cmp" : fn;
+        if ( outputs.size() < resume.size() ) {
+            //continue a file spilled to before a checkpoint
+            if ( truncate(path.c_str(), resume[outputs.size()]) != 0 ) {
+                printf("FAILURE: cannot continue spilled tracker file %s\n", path.c_str());
+                exit(EXIT_FAILURE);
+            }
+            out.ofile = fopen(path.c_str(), "ab");
+        } else {
+            check_file_write(path.c_str());
+            out.ofile = fopen(path.c_str(), "wb");
+        }
+    }
+    outputs.push_back(out);
+}
+
+void Tracker::decimate () {
+
+    //keep rows 0, 2, 4, ... packed at the front of the buffer
+    unsigned long i;
+    long j;
+    for (i=1; 2*i<nrow; i++)
+        for (j=0; j<width; j++)
+            buf[i*width+j] = buf[2*i*width+j];
+    nrow = (nrow + 1)/2;
+    //record half as often
+    stride *= 2;
+    dtout *= 2;
+}
+
+float *Tracker::record (double t, bool force) {
+
+    //nothing is tracked
+    if ( (width == 0) || ((nmax == 0) && (nchunk == 0)) )
+        return(NULL);
+
+    //maximum number of rows in memory
+    unsigned long cap = (nchunk > 0) ? nchunk : nmax;
+
+    if ( !force ) {
+        //step counter
+        unsigned long k = nstep++;
+        //check the sampling
+        if ( dtout > 0 ) {
+            if ( t < tnext )
+                return(NULL);
+        } else {
+            if ( k % stride != 0 )
+                return(NULL);
+        }
+        //make room, which may change the sampling
+        if ( nrow == cap ) {
+            if ( nchunk > 0 ) {
+                spill();
+            } else if ( cap < 2 ) {
+                //a single row can't be halved, so it's replaced
+                nrow--;
+                nrecord--;
+            } else {
+                decimate();
+                if ( (dtout == 0) && (k % stride != 0) )
+                    return(NULL);
+            }
+        }
+        //next sample time
+        if ( dtout > 0 ) {
+            if ( tnext == -INFINITY ) tnext = t;
+            while ( tnext <= t ) tnext += dtout;
+        }
+    } else if ( nrow == cap ) {
+        //make room or replace the last row
+        if ( nchunk > 0 ) {
+            spill();
+        } else {
+            nrow--;
+            nrecord--;
+        }
+    }
+
+    //never hand out a row past the cap
+    if ( nrow >= cap )
+        return(NULL);
+
+    //grow the buffer geometrically, without exceeding the cap
+    if ( buf.size() < (nrow + 1)*(unsigned long)width ) {
+        unsigned long m = 2*buf.size()/width;
+        if ( m < 64 ) m = 64;
+        if ( m > cap ) m = cap;
+        buf.resize(m*width);
+    }
+
+    tlast = t;
+    nrow++;
+    nrecord++;
+    return( get_row(nrow - 1) );
+}
+
+void Tracker::flush () {
+
+    unsigned long i;
+
+    if ( nchunk == 0 ) {
+        std::vector<unsigned char> cmp;
+        for (i=0; i<outputs.size(); i++) {
+            TrackerOutput &out = outputs[i];
+            if ( compress ) {
+                compress_rows(buf.data(), nrow, out, cmp);
+                if ( store ) {
+                    put_compressed(NULL, out, cmp);
+                } else {
+                    std::string path = out.fn + ".cmp";
+                    check_file_write(path.c_str());
+                    FILE *ofile = fopen(path.c_str(), "wb");
+                    put_compressed(ofile, out, cmp);
+                    fclose(ofile);
+                }
+            } else if ( store ) {
+                if ( out.ncol == 1 ) {
+                    put_columns(store->begin(out.fn, "<f4", sizeof(float), nrow, 1), buf.data(), nrow, out.j, 1);
+                } else {
+                    put_columns(store->begin(out.fn, "<f4", sizeof(float), out.ncol, nrow), buf.data(), nrow, out.j, out.ncol);
+                }
+                store->end();
+            } else {
+                write(out.fn, out.j, out.ncol);
+            }
+        }
+        return;
+    }
+
+    //hand over the partial chunk and wait for the writer to catch up
+    if ( nrow > 0 )
+        spill();
+    std::unique_lock<std::mutex> lock(mtx);
+    cv.wait(lock, [this]{ return( pending.empty() && !busy ); });
+}
+
+void Tracker::write (const std::string &fn, long j, long ncol) {
+    FILE *ofile;
+    check_file_write(fn.c_str());
+    ofile = fopen(fn.c_str(), "wb");
+    put_columns(ofile, buf.data(), nrow, j, ncol);
+    fclose(ofile);
+}
+
+void Tracker::put_columns (FILE *ofile, const float *rows, unsigned long m, long j, long ncol) {
+
+    float chunk[TRACKER_CHUNK];
+    unsigned long i, k;
+    long c;
+
+    for (c=j; c<j+ncol; c++) {
+        k = 0;
+        for (i=0; i<m; i++) {
+            chunk[k++] = rows[i*width+c];
+            if ( k == TRACKER_CHUNK ) {
+                fwrite(chunk, sizeof(float), k, ofile);
+                k = 0;
+            }
+        }
+        fwrite(chunk, sizeof(float), k, ofile);
+    }
+}
+
+void Tracker::put_rows (FILE *ofile, const float *rows, unsigned long m, long j, long ncol) {
+    for (unsigned long i=0; i<m; i++)
+        fwrite(rows + i*width + j, sizeof(float), ncol, ofile);
+}
+
+void Tracker::compress_rows (const float *rows, unsigned long m, const TrackerOutput &out, std::vector<unsigned char> &cmp) {
+    cmp.clear();
+    for (long c=0; c<out.ncol; c++)
+        compress_series(rows + out.j + c, m, width, out.ncol, c, ctol, cmp);
+}
+
+void Tracker::put_compressed (FILE *ofile, const TrackerOutput &out, const std::vector<unsigned char> &cmp) {
+    if ( store ) {
+        ofile = store->begin(out.fn, "|cmp", 1, long(cmp.size()), 1);
+        fwrite(cmp.data(), 1, cmp.size(), ofile);
+        store->end();
+    } else if ( ofile != NULL ) {
+        fwrite(cmp.data(), 1, cmp.size(), ofile);
+    }
+}
+
+void Tracker::save (FILE *f) {
+
+    unsigned long i;
+    //spilled chunks have to be on disk before their lengths are taken
+    if ( writer.joinable() ) {
+        std::unique_lock<std::mutex> lock(mtx);
+        cv.wait(lock, [this]{ return( pending.empty() && !busy ); });
+    }
+    std::vector<int64_t> len;
+    for (i=0; i<outputs.size(); i++) {
+        if ( outputs[i].ofile != NULL ) {
+            fflush(outputs[i].ofile);
+            len.push_back( ftell(outputs[i].ofile) );
+        } else {
+            len.push_back( -1 );
+        }
+    }
+    put_value(f, width);
+    put_value(f, nmax);
+    put_value(f, nrow);
+    put_value(f, nrecord);
+    put_value(f, nstep);
+    put_value(f, stride);
+    put_value(f, dtout);
+    put_value(f, tnext);
+    put_value(f, tlast);
+    put_value(f, nchunk);
+    fwrite(buf.data(), sizeof(float), nrow*width, f);
+    put_vector(f, len);
+}
+
+void Tracker::load (FILE *f) {
+
+    long width_;
+    unsigned long nmax_, nchunk_;
+    get_value(f, width_);
+    get_value(f, nmax_);
+    get_value(f, nrow);
+    get_value(f, nrecord);
+    get_value(f, nstep);
+    get_value(f, stride);
+    get_value(f, dtout);
+    get_value(f, tnext);
+    get_value(f, tlast);
+    get_value(f, nchunk_);
+    if ( (width_ != width) || (nmax_ != nmax) || (nchunk_ != nchunk) )
+        print_exit("checkpointed tracker has a different shape");
+    buf.resize(nrow*width);
+    if ( fread(buf.data(), sizeof(float), nrow*width, f) != nrow*width )
+        print_exit("checkpoint file ended unexpectedly");
+    get_vector(f, resume);
+}
+
+//------------------------------------------------------------------------------
+//spilling to disk
+
+void Tracker::spill () {
+
+    //start the writer the first time it's needed
+    if ( !writer.joinable() )
+        writer = std::thread(&Tracker::run, this);
+
+    std::unique_lock<std::mutex> lock(mtx);
+    //double buffering, so wait for the previous chunk to be written
+    cv.wait(lock, [this]{ return( pending.empty() && !busy ); });
+    pending.push_back( std::vector<float>() );
+    pending.back().swap(buf);
+    npending.push_back( nrow );
+    //continue in a written buffer, if there is one
+    if ( !spare.empty() ) {
+        buf.swap(spare.back());
+        spare.pop_back();
+    }
+    nrow = 0;
+    lock.unlock();
+    cv.notify_all();
+}
+
+void Tracker::append (const std::vector<float> &chunk, unsigned long m) {
+
+    std::vector<unsigned char> cmp;
+    for (unsigned long l=0; l<outputs.size(); l++) {
+        TrackerOutput &out = outputs[l];
+        if ( compress ) {
+            //each chunk is a group of blocks of its own
+            compress_rows(chunk.data(), m, out, cmp);
+            put_compressed(out.ofile, out, cmp);
+            if ( out.ofile != NULL )
+                fflush(out.ofile);
+        } else if ( store ) {
+            //each chunk is a record of its own
+            FILE *ofile = store->begin(out.fn, "<f4", sizeof(float), m, out.ncol);
+            put_rows(ofile, chunk.data(), m, out.j, out.ncol);
+            store->end();
+        } else if ( out.ofile != NULL ) {
+            //groups of columns are appended row by row
+            if ( out.ncol == 1 ) {
+                put_columns(out.ofile, chunk.data(), m, out.j, 1);
+            } else {
+                put_rows(out.ofile, chunk.data(), m, out.j, out.ncol);
+            }
+            //make every completed chunk usable
+            fflush(out.ofile);
+        }
+    }
+}
+
+void Tracker::run () {
+
+    std::vector<float> chunk;
+    unsigned long m;
+
+    std::unique_lock<std::mutex> lock(mtx);
+    while ( true ) {
+        cv.wait(lock, [this]{ return( stop || !pending.empty() ); });
+        if ( pending.empty() )
+            break;
+        chunk.swap(pending.front());
+        pending.pop_front();
+        m = npending.front();
+        npending.pop_front();
+        busy = true;
+        //write without holding the lock
+        lock.unlock();
+        append(chunk, m);
+        lock.lock();
+        busy = false;
+        spare.push_back( std::vector<float>() );
+        spare.back().swap(chunk);
+        cv.notify_all();
+    }
+}
+
+void Tracker::close () {
+
+    if ( writer.joinable() ) {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            stop = true;
+        }
+        cv.notify_all();
+        writer.join();
+        stop = false;
+    }
+    for (unsigned long i=0; i<outputs.size(); i++) {
+        if ( outputs[i].ofile != NULL ) {
+            fclose(outputs[i].ofile);
+            outputs[i].ofile = NULL;
+        }
+    }
+}
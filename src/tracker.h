@@ -0,0 +1,216 @@
+#ifndef TRACKER_H_
+#define TRACKER_H_
+
+//! \file tracker.h
+
+#include <cmath>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <condition_variable>
+
+#include "io.h"
+#include "store.h"
+#include "compress.h"
+#include "checkpoint.h"
+
+//!a group of tracker columns written to one file
+struct TrackerOutput {
+    //!file path, or record key if writing to a store
+    std::string fn;
+    //!first column
+    long j;
+    //!number of columns
+    long ncol;
+    //!open file, when spilling to disk without a store
+    FILE *ofile;
+};
+
+//!bounded, time-major storage for variables tracked during integration
+/*!
+Every recorded step occupies one contiguous row of `width` floats in a single buffer. The buffer never holds more than `nmax` rows. By default every step is recorded until the buffer fills, then every other row is discarded in place and only every other step is recorded from then on, doubling the stride each time the buffer fills again. Alternatively, rows are recorded at a fixed time interval, which is doubled in the same way if the buffer fills. The final step of a solve can always be forced into the buffer, so the output keeps its first and last values like the old subsampling did.
+
+If a chunk size is given, the tracker instead spills to disk. Whenever `nchunk` rows are recorded, the buffer is handed to a background writer thread, which appends it to the output files while integration continues into a second buffer. Nothing is decimated, at most two chunks are held in memory, and every completed chunk is on disk. Single columns are appended to files in the same format as before. Groups of columns are appended row by row, so those files are time-major instead of column-major.
+
+If a Store is set, outputs are appended to it as records instead of written to their own files. Without spilling, each output is one record, with shape (nrow, 1) for a single column and (ncol, nrow) for a group. When spilling, every chunk of every output is a record, with shape (m, 1) or (m, ncol).
+
+A tracker can be saved into a checkpoint, with its rows in memory and the lengths of any files it's spilling to. When loaded, those files are cut back to the saved lengths as outputs are added, so a restarted solve appends exactly where the checkpoint was taken.
+
+If compression is set, every column of an output is compressed (see compress_series) as a block of its own, in each chunk when spilling. Files get a ".cmp" extension and store records have the type "|cmp". Either way, decompressing the blocks of an output and putting each column's values one after another gives the layout of an uncompressed, unspilled file, so profiles are never time-major.
+*/
+class Tracker {
+
+public:
+
+    //!constructs an empty tracker with no columns
+    Tracker ();
+    //!finishes any writing and closes files
+    ~Tracker ();
+
+    //!sets the shape and sampling of the tracker, discarding any rows and outputs
+    /*!
+    \param[in] width number of floats in each row
+    \param[in] nmax maximum number of rows
+    \param[in] dtout time interval between rows, or zero to consider every step
+    \param[in] nchunk number of rows in each chunk spilled to disk, or zero to keep rows in memory
+    */
+    void setup (long width, unsigned long nmax, double dtout, unsigned long nchunk=0);
+
+    //!sets a store to write outputs into instead of files, before outputs are added
+    void set_store (Store *store_) { store = store_; }
+
+    //!sets compression of the outputs, before outputs are added
+    /*!
+    \param[in] compress_ whether to compress
+    \param[in] ctol_ relative rounding tolerance, or zero to compress losslessly
+    */
+    void set_compression (bool compress_, double ctol_) { compress = compress_; ctol = ctol_; }
+
+    //!adds a group of columns to be written to a file
+    /*!
+    When spilling without a store, the file is created immediately.
+    \param[in] fn target file path, or record key if writing to a store
+    \param[in] j first column
+    \param[in] ncol number of columns
+    */
+    void add_output (const std::string &fn, long j, long ncol=1);
+
+    //!checks whether any outputs have been added
+    bool has_outputs () { return( !outputs.empty() ); }
+
+    //!decides whether a step is recorded
+    /*!
+    \param[in] t time of the step
+    \param[in] force whether to record the step regardless of the sampling, replacing the last row if the buffer is full
+    \return pointer to the row that should be filled, or NULL if the step is skipped
+    */
+    float *record (double t, bool force=false);
+
+    //!checks whether a time is the one most recently recorded
+    bool is_last (double t) { return( (nrecord > 0) && (t == tlast) ); }
+
+    //!writes all recorded rows to the outputs
+    /*!
+    In memory, every output file is rewritten with the whole record. When spilling, the partial chunk is appended and the call waits until the writer has caught up and flushed the files.
+    */
+    void flush ();
+
+    //!writes columns into a binary file, one column after another
+    /*!
+    \param[in] fn target file path
+    \param[in] j first column
+    \param[in] ncol number of columns
+    */
+    void write (const std::string &fn, long j, long ncol=1);
+
+    //!gets the number of floats in each row
+    long get_width () { return(width); }
+    //!gets the number of rows in memory
+    unsigned long get_nrow () { return(nrow); }
+    //!gets the current step stride
+    unsigned long get_stride () { return(stride); }
+    //!gets the current time interval between rows
+    double get_dtout () { return(dtout); }
+    //!gets the next time to record, if sampling by time
+    double get_tnext () { return(tnext); }
+    //!sets the next time to record, if sampling by time
+    void set_tnext (double t) { tnext = t; }
+    //!gets a pointer to a row
+    float *get_row (unsigned long i) { return(buf.data() + i*width); }
+
+    //!writes the rows, sampling, and spilled file lengths into a checkpoint, waiting for any spilled chunks to be written
+    void save (FILE *f);
+
+    //!reads a tracker saved by save(), before outputs are added
+    void load (FILE *f);
+
+private:
+
+    //!discards every other row and doubles the sampling stride or interval
+    void decimate ();
+
+    //!hands the rows in memory to the writer thread and starts an empty buffer
+    void spill ();
+
+    //!appends a chunk of rows to the open output files or the store
+    void append (const std::vector<float> &chunk, unsigned long m);
+
+    //!writes columns of some rows into a file, one column after another
+    /*!
+    Columns are gathered in small chunks, so no copy of the rows is made.
+    */
+    void put_columns (FILE *ofile, const float *rows, unsigned long m, long j, long ncol);
+
+    //!writes columns of some rows into a file, row by row
+    void put_rows (FILE *ofile, const float *rows, unsigned long m, long j, long ncol);
+
+    //!compresses every column of an output in some rows, replacing the contents of cmp
+    void compress_rows (const float *rows, unsigned long m, const TrackerOutput &out, std::vector<unsigned char> &cmp);
+
+    //!writes the compressed bytes of an output into a file, or into a record of the store if there is one
+    void put_compressed (FILE *ofile, const TrackerOutput &out, const std::vector<unsigned char> &cmp);
+
+    //!waits for and writes chunks until stopped
+    void run ();
+
+    //!stops the writer thread and closes files
+    void close ();
+
+    //!number of floats in each row
+    long width;
+    //!maximum number of rows
+    unsigned long nmax;
+    //!number of rows in memory
+    unsigned long nrow;
+    //!number of rows ever recorded
+    unsigned long nrecord;
+    //!time-major buffer of rows
+    std::vector<float> buf;
+    //!number of steps considered so far
+    unsigned long nstep;
+    //!step stride between rows
+    unsigned long stride;
+    //!time interval between rows, if sampling by time
+    double dtout;
+    //!next time to record, if sampling by time
+    double tnext;
+    //!time of the most recent row
+    double tlast;
+    //!output files
+    std::vector<TrackerOutput> outputs;
+    //!store to write outputs into, if any
+    Store *store;
+    //!whether outputs are compressed
+    bool compress;
+    //!relative rounding tolerance of the compression
+    double ctol;
+    //!lengths to cut spilled files back to as outputs are added, from a checkpoint
+    std::vector<int64_t> resume;
+
+    //---------------------
+    //spilling to disk
+
+    //!number of rows in each chunk, zero if not spilling
+    unsigned long nchunk;
+    //!chunks waiting to be written and their numbers of rows
+    std::deque< std::vector<float> > pending;
+    //!numbers of rows in the pending chunks
+    std::deque<unsigned long> npending;
+    //!buffers available for reuse
+    std::vector< std::vector<float> > spare;
+    //!whether the writer is in the middle of a chunk
+    bool busy;
+    //!whether the writer should stop
+    bool stop;
+    //!writer thread
+    std::thread writer;
+    //!protects the chunk queue
+    std::mutex mtx;
+    //!signals changes to the chunk queue
+    std::condition_variable cv;
+};
+
+#endif
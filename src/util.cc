@@ -74,3 +74,96 @@ std::vector<double> logspace (double a, double b, long n) {
 
     return(v);
 }
+
+void eig_sym (std::vector<double> &A, long n, std::vector<double> &evals, std::vector<double> &evecs) {
+
+    long i, j, k, p, sweep;
+    double off, theta, t, c, s, akp, akq, vkp, vkq;
+
+    //start with identity eigenvectors
+    evecs.assign(n*n, 0.0);
+    for (i=0; i<n; i++) evecs[i*n+i] = 1.0;
+
+    for (sweep=0; sweep<100; sweep++) {
+        //sum of squared off-diagonal elements
+        off = 0.0;
+        for (i=0; i<n; i++)
+            for (j=i+1; j<n; j++)
+                off += A[i*n+j]*A[i*n+j];
+        if ( off < 1e-30 ) break;
+        //rotate away every off-diagonal element once
+        for (p=0; p<n; p++) {
+            for (j=p+1; j<n; j++) {
+                if ( A[p*n+j] == 0.0 ) continue;
+                theta = (A[j*n+j] - A[p*n+p])/(2*A[p*n+j]);
+                t = (theta >= 0 ? 1.0 : -1.0)/(fabs(theta) + sqrt(theta*theta + 1.0));
+                c = 1.0/sqrt(t*t + 1.0);
+                s = t*c;
+                for (k=0; k<n; k++) {
+                    akp = A[k*n+p];
+                    akq = A[k*n+j];
+                    A[k*n+p] = c*akp - s*akq;
+                    A[k*n+j] = s*akp + c*akq;
+                }
+                for (k=0; k<n; k++) {
+                    akp = A[p*n+k];
+                    akq = A[j*n+k];
+                    A[p*n+k] = c*akp - s*akq;
+                    A[j*n+k] = s*akp + c*akq;
+                }
+                for (k=0; k<n; k++) {
+                    vkp = evecs[k*n+p];
+                    vkq = evecs[k*n+j];
+                    evecs[k*n+p] = c*vkp - s*vkq;
+                    evecs[k*n+j] = s*vkp + c*vkq;
+                }
+            }
+        }
+    }
+
+    //sort into descending order
+    evals.resize(n);
+    for (i=0; i<n; i++) evals[i] = A[i*n+i];
+    for (i=0; i<n; i++) {
+        p = i;
+        for (j=i+1; j<n; j++)
+            if ( evals[j] > evals[p] )
+                p = j;
+        if ( p != i ) {
+            swap(&evals[i], &evals[p]);
+            for (k=0; k<n; k++)
+                swap(&evecs[k*n+i], &evecs[k*n+p]);
+        }
+    }
+}
+
+void lu_solve (std::vector<double> A, std::vector<double> &b, long n) {
+
+    long i, j, k, p;
+    double f;
+
+    //forward elimination with partial pivoting
+    for (k=0; k<n; k++) {
+        p = k;
+        for (i=k+1; i<n; i++)
+            if ( fabs(A[i*n+k]) > fabs(A[p*n+k]) )
+                p = i;
+        if ( p != k ) {
+            for (j=0; j<n; j++)
+                swap(&A[k*n+j], &A[p*n+j]);
+            swap(&b[k], &b[p]);
+        }
+        for (i=k+1; i<n; i++) {
+            f = A[i*n+k]/A[k*n+k];
+            for (j=k; j<n; j++)
+                A[i*n+j] -= f*A[k*n+j];
+            b[i] -= f*b[k];
+        }
+    }
+    //back substitution
+    for (i=n-1; i>=0; i--) {
+        for (j=i+1; j<n; j++)
+            b[i] -= A[i*n+j]*b[j];
+        b[i] /= A[i*n+i];
+    }
+}
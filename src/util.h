@@ -62,13 +62,30 @@ std::vector<double> linspace (double a, double b, long n);
 //!create an logarithmically spaced vector of values over a range
 std::vector<double> logspace (double a, double b, long n);
 
+//!computes eigenvalues and eigenvectors of a symmetric matrix with cyclic Jacobi rotations
+/*!
+\param[in,out] A row-major n x n symmetric matrix, destroyed
+\param[in] n size of the matrix
+\param[out] evals eigenvalues in descending order
+\param[out] evecs row-major n x n matrix with the corresponding eigenvectors in its columns
+*/
+void eig_sym (std::vector<double> &A, long n, std::vector<double> &evals, std::vector<double> &evecs);
+
+//!solves a small dense linear system in place with partially pivoted Gaussian elimination
+/*!
+\param[in] A row-major n x n matrix
+\param[in,out] b right hand side, replaced by the solution
+\param[in] n size of the system
+*/
+void lu_solve (std::vector<double> A, std::vector<double> &b, long n);
+
 //!subsample a vector, keeping first and last elements
 /*!
 \param[in] v vector to subsample
 \param[in] n approximate length target
 */
 template <class T>
-std::vector<T> subsample (std::vector<T> v, unsigned long n) {
+std::vector<T> subsample (const std::vector<T> &v, unsigned long n) {
 
     //calculate the approximate interval size
     unsigned long size = v.size();